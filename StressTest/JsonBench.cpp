@@ -0,0 +1,201 @@
+#include "RedisValue.h"
+#include "JsonScanner.h"
+#include "Dump.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+
+// 快照序列化/解析基准测试
+// 用法：./json_bench [快照文件]，快照文件的每一行为 key:value，不指定时生成模拟数据
+
+// 生成模拟快照中的值：短字符串、长文本、带转义的字符串、列表
+std::vector<std::string> prepareSnapshotValues(int count) {
+    std::default_random_engine generator;
+    std::uniform_int_distribution<int> kind(0, 3);
+    std::uniform_int_distribution<int> length(64, 512);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> values;
+    for (int i = 0; i < count; ++i) {
+        std::string text;
+        int len = length(generator);
+        for (int k = 0; k < len; ++k) {
+            text += static_cast<char>(letter(generator));
+        }
+        RedisValue value;
+        switch (kind(generator)) {
+            case 0: value = RedisValue(text.substr(0, 16)); break;
+            case 1: value = RedisValue(text); break;
+            case 2: value = RedisValue(text.substr(0, len / 2) + "\"\\\n\t" + text.substr(len / 2)); break;
+            default: value = RedisValue(std::vector<RedisValue>{text.substr(0, 32), text.substr(32, 64), text}); break;
+        }
+        values.push_back(value.dump());
+    }
+    return values;
+}
+
+// 读取快照文件中的值（跳过key和分隔符）
+std::vector<std::string> loadSnapshotValues(const std::string& path) {
+    std::vector<std::string> values;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t pos = line.find(':');
+        if (pos != std::string::npos) {
+            values.push_back(line.substr(pos + 1));
+        }
+    }
+    return values;
+}
+
+template<typename Func>
+double measureSeconds(Func func) {
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// 扫描内核：向量化版本与逐字节版本在同一段文本上查找特殊字符
+void scannerTest(const std::string& text, int rounds) {
+    size_t sink = 0;
+    double simd = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            for (size_t pos = 0; pos < text.size(); pos++) {
+                pos = JsonScanner::findStringSpecial(text.data(), pos, text.size());
+                sink += pos;
+            }
+        }
+    });
+    double scalar = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            for (size_t pos = 0; pos < text.size(); pos++) {
+                pos = JsonScanner::findStringSpecialScalar(text.data(), pos, text.size());
+                sink += pos;
+            }
+        }
+    });
+    double bytes = static_cast<double>(text.size()) * rounds;
+    std::cout << "Scan   simd:   " << bytes / simd / 1e9 << " GB/s" << std::endl;
+    std::cout << "Scan   scalar: " << bytes / scalar / 1e9 << " GB/s" << std::endl;
+    if (sink == 42) std::cout << std::endl; //防止循环被优化掉
+}
+
+// 完整解析：RedisValue::parse解析每一个值
+void parseTest(const std::vector<std::string>& values, int rounds) {
+    size_t bytes = 0;
+    for (const auto& value : values) {
+        bytes += value.size();
+    }
+    std::string err;
+    size_t failed = 0;
+    double seconds = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            for (const auto& value : values) {
+                RedisValue parsed = RedisValue::parse(value, err);
+                failed += err.empty() ? 0 : 1;
+            }
+        }
+    });
+    std::cout << "Parse  " << values.size() << " values, " << bytes << " bytes: "
+              << static_cast<double>(bytes) * rounds / seconds / 1e9 << " GB/s";
+    if (failed > 0) std::cout << " (" << failed << " failed)";
+    std::cout << std::endl;
+}
+
+// 逐字节转义的实现（向量化之前Dump.h中的版本），作为对比基准
+void dumpStringReference(const std::string& value, std::string& out) {
+    out += '"';
+    for (char ch : value) {
+        switch (ch) {
+            case '\\': out += "\\\\"; break;
+            case '"': out += "\\\""; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<uint8_t>(ch) <= 0x1f) {
+                    char buf[8];
+                    snprintf(buf, sizeof buf, "\\u%04x", ch);
+                    out += buf;
+                } else {
+                    out += ch;
+                }
+        }
+    }
+    out += '"';
+}
+
+// 字符串转义：name为输入类型，分别统计新旧实现每秒处理的输入字节数
+void dumpTest(const std::string& name, const std::vector<std::string>& strings, int rounds) {
+    size_t bytes = 0;
+    for (const auto& value : strings) {
+        bytes += value.size();
+    }
+    std::string out, expected;
+    bool same = true;
+    for (const auto& value : strings) {
+        out.clear();
+        expected.clear();
+        dump(value, out);
+        dumpStringReference(value, expected);
+        same = same && out == expected;
+    }
+    double simd = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            for (const auto& value : strings) {
+                std::string result;
+                dump(value, result);
+            }
+        }
+    });
+    double reference = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            for (const auto& value : strings) {
+                std::string result;
+                dumpStringReference(value, result);
+            }
+        }
+    });
+    double total = static_cast<double>(bytes) * rounds;
+    std::cout << "Dump   " << name << ": simd " << total / simd / 1e9 << " GB/s, reference "
+              << total / reference / 1e9 << " GB/s" << (same ? "" : " (OUTPUT MISMATCH)") << std::endl;
+}
+
+// 转义测试数据：typical为普通文本，偶尔有换行和引号；adversarial中一半字节需要转义，且包含控制字符
+void prepareDumpStrings(std::vector<std::string>& typical, std::vector<std::string>& adversarial) {
+    std::default_random_engine generator;
+    std::uniform_int_distribution<int> length(16, 1024);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::uniform_int_distribution<int> control(0, 0x1f);
+    for (int i = 0; i < 20000; ++i) {
+        int len = length(generator);
+        std::string text, hostile;
+        for (int k = 0; k < len; ++k) {
+            text += k % 97 == 96 ? '\n' : k % 131 == 130 ? '"' : static_cast<char>(letter(generator));
+            hostile += k % 2 ? static_cast<char>(letter(generator)) : k % 4 ? '"' : static_cast<char>(control(generator));
+        }
+        typical.push_back(text);
+        adversarial.push_back(hostile);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> values = argc > 1 ? loadSnapshotValues(argv[1]) : prepareSnapshotValues(100000);
+    std::string text;
+    for (const auto& value : values) {
+        text += value;
+    }
+    scannerTest(text, 10);
+    parseTest(values, 5);
+
+    std::vector<std::string> typical, adversarial;
+    prepareDumpStrings(typical, adversarial);
+    dumpTest("typical    ", typical, 10);
+    dumpTest("adversarial", adversarial, 10);
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "Snapshot.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <sys/stat.h>
+
+// 快照保存/加载基准测试：比较压缩与不压缩时的文件大小、保存时间和加载时间
+// 用法：./snapshot_bench [记录数]，快照写到当前目录下的snapshot_bench.dat，测试结束后删除
+
+template<typename Func>
+double measureSeconds(Func func) {
+    auto start = std::chrono::high_resolution_clock::now();
+    func();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// 模拟线上数据：带业务前缀的键，短字符串、计数器、哈希表、列表和少量大文本
+std::vector<std::pair<std::string, RedisValue>> prepareRecords(int count) {
+    std::default_random_engine generator;
+    std::uniform_int_distribution<int> kind(0, 9);
+    std::uniform_int_distribution<int> number(0, 1000000);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    const char* cities[] = {"beijing", "shanghai", "shenzhen", "hangzhou", "chengdu"};
+    //文章由随机单词组成，单词表足够大，避免重复过于规律
+    std::vector<std::string> words;
+    for (int i = 0; i < 5000; ++i) {
+        std::string word;
+        for (int k = 2 + i % 9; k > 0; --k) {
+            word += static_cast<char>(letter(generator));
+        }
+        words.push_back(word);
+    }
+    std::vector<std::pair<std::string, RedisValue>> records;
+    for (int i = 0; i < count; ++i) {
+        std::string id = std::to_string(i);
+        switch (kind(generator)) {
+            case 0: case 1: case 2:
+                records.emplace_back("session:" + id, RedisValue("token-" + std::to_string(number(generator))));
+                break;
+            case 3: case 4:
+                records.emplace_back("counter:page:" + id, RedisValue(std::to_string(number(generator))));
+                break;
+            case 5: case 6: case 7: {
+                RedisValue::object profile;
+                profile["name"] = RedisValue("user" + id);
+                profile["age"] = RedisValue(std::to_string(number(generator) % 80));
+                profile["city"] = RedisValue(cities[number(generator) % 5]);
+                profile["email"] = RedisValue("user" + id + "@example.com");
+                records.emplace_back("user:" + id + ":profile", RedisValue(profile));
+                break;
+            }
+            case 8: {
+                RedisValue::array events;
+                for (int k = 0; k < 8; ++k) {
+                    events.push_back(RedisValue("event:" + std::to_string(number(generator) % 100)));
+                }
+                records.emplace_back("timeline:" + id, RedisValue(events));
+                break;
+            }
+            default: {
+                std::string text;
+                while (text.size() < 2048) {
+                    text += words[number(generator) % words.size()];
+                    text += ' ';
+                }
+                records.emplace_back("article:" + id, RedisValue(text));
+                break;
+            }
+        }
+    }
+    return records;
+}
+
+void snapshotTest(const std::vector<std::pair<std::string, RedisValue>>& records, bool compress) {
+    const std::string path = "snapshot_bench.dat";
+    double save = measureSeconds([&] {
+        SnapshotWriter writer(path, compress);
+        std::string batch;
+        for (const auto& record : records) {
+            SnapshotFormat::appendRecord(batch, record.first, record.second);
+            if (batch.size() >= SNAPSHOT_BATCH_SIZE) {
+                writer.appendBlock(batch);
+                batch.clear();
+            }
+        }
+        writer.appendBlock(batch);
+        writer.close();
+    });
+    struct stat st;
+    stat(path.c_str(), &st);
+    size_t loaded = 0;
+    double load = measureSeconds([&] {
+        std::ifstream file(path, std::ios::binary);
+        std::string header;
+        std::getline(file, header);
+        SnapshotFormat::readRecords(file, [&](const std::string&, const RedisValue&) { loaded++; });
+    });
+    remove(path.c_str());
+    std::cout << (compress ? "compressed:   " : "uncompressed: ") << st.st_size / 1e6 << " MB, save "
+              << save << " s, load " << load << " s" << (loaded == records.size() ? "" : " (RECORD COUNT MISMATCH)")
+              << std::endl;
+}
+
+// 只测编解码本身，使用一个典型的数据块
+void codecTest(const std::vector<std::pair<std::string, RedisValue>>& records, int rounds) {
+    std::string block;
+    for (const auto& record : records) {
+        SnapshotFormat::appendRecord(block, record.first, record.second);
+        if (block.size() >= SNAPSHOT_BATCH_SIZE) {
+            break;
+        }
+    }
+    std::string compressed, restored(block.size(), '\0');
+    double compressSeconds = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            compressed.clear();
+            LZCodec::compress(block.data(), block.size(), compressed);
+        }
+    });
+    bool same = true;
+    double decompressSeconds = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            same = LZCodec::decompress(compressed.data(), compressed.size(), &restored[0], restored.size()) && same;
+        }
+    });
+    same = same && restored == block;
+    double bytes = static_cast<double>(block.size()) * rounds;
+    std::cout << "Codec  ratio " << static_cast<double>(compressed.size()) / block.size()
+              << ", compress " << bytes / compressSeconds / 1e9 << " GB/s, decompress "
+              << bytes / decompressSeconds / 1e9 << " GB/s" << (same ? "" : " (ROUND TRIP MISMATCH)") << std::endl;
+}
+
+// 数据块校验：SSE4.2的crc32指令与查表实现
+void checksumTest(int rounds) {
+    std::string block(SNAPSHOT_BATCH_SIZE, 'x');
+    uint32_t sink = 0;
+    double hardware = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            sink ^= Crc32c::value(block.data(), block.size());
+        }
+    });
+    double software = measureSeconds([&] {
+        for (int r = 0; r < rounds; ++r) {
+            sink ^= Crc32c::extendSoftware(0, block.data(), block.size());
+        }
+    });
+    double bytes = static_cast<double>(block.size()) * rounds;
+    std::cout << "CRC32C " << bytes / hardware / 1e9 << " GB/s, table " << bytes / software / 1e9 << " GB/s"
+              << (sink == 42 ? " " : "") << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? std::stoi(argv[1]) : 1000000;
+    auto records = prepareRecords(count);
+    codecTest(records, 2000);
+    checksumTest(2000);
+    snapshotTest(records, false);
+    snapshotTest(records, true);
+    return 0;
+}
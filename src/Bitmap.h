@@ -0,0 +1,153 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "global.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+    位图运算内核
+    位图直接保存在字符串值的原始字节中，位序与Redis一致：第0位是第0个字节的最高位。
+    BITCOUNT和BITOP以64字节为一个块处理，支持AVX2时使用向量指令，否则按8个64位字展开。
+*/
+class Bitmap {
+    static const size_t BLOCK_SIZE = 64; //一次处理的字节数
+
+    static inline uint64_t loadWord(const uint8_t* p) {
+        uint64_t word;
+        memcpy(&word, p, sizeof word); //避免非对齐访问
+        return word;
+    }
+    static inline void storeWord(uint8_t* p, uint64_t word) {
+        memcpy(p, &word, sizeof word);
+    }
+#ifdef __AVX2__
+    // 使用查表法统计32字节中1的个数（每个字节按高低4位查表）
+    static inline __m256i popcount256(__m256i v) {
+        const __m256i lookup = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i lowMask = _mm256_set1_epi8(0x0f);
+        __m256i lo = _mm256_and_si256(v, lowMask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+        return _mm256_sad_epu8(cnt, _mm256_setzero_si256()); //按64位横向求和
+    }
+#endif
+public:
+    // 统计[data,data+len)中1的个数
+    static uint64_t popcount(const uint8_t* data, size_t len) {
+        uint64_t count = 0;
+        size_t i = 0;
+#ifdef __AVX2__
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + BLOCK_SIZE <= len; i += BLOCK_SIZE) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+            acc = _mm256_add_epi64(acc, popcount256(a));
+            acc = _mm256_add_epi64(acc, popcount256(b));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        count += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+        for (; i + BLOCK_SIZE <= len; i += BLOCK_SIZE) {
+            const uint8_t* p = data + i;
+            count += __builtin_popcountll(loadWord(p)) + __builtin_popcountll(loadWord(p + 8))
+                   + __builtin_popcountll(loadWord(p + 16)) + __builtin_popcountll(loadWord(p + 24))
+                   + __builtin_popcountll(loadWord(p + 32)) + __builtin_popcountll(loadWord(p + 40))
+                   + __builtin_popcountll(loadWord(p + 48)) + __builtin_popcountll(loadWord(p + 56));
+        }
+#endif
+        for (; i + 8 <= len; i += 8) {
+            count += __builtin_popcountll(loadWord(data + i));
+        }
+        for (; i < len; i++) {
+            count += __builtin_popcount(data[i]);
+        }
+        return count;
+    }
+
+    // 查找[start,end]字节范围内第一个值为bit的位，返回位偏移，找不到返回-1
+    static int64_t findFirstBit(const uint8_t* data, size_t start, size_t end, int bit) {
+        const uint64_t skipWord = bit ? 0 : ~0ULL; //整个字中不可能包含目标位时的取值
+        const uint8_t skipByte = bit ? 0 : 0xff;
+        size_t i = start;
+        while (i + 8 <= end + 1 && loadWord(data + i) == skipWord) {
+            i += 8;
+        }
+        for (; i <= end; i++) {
+            if (data[i] == skipByte) {
+                continue;
+            }
+            uint8_t byte = bit ? data[i] : static_cast<uint8_t>(~data[i]);
+            return static_cast<int64_t>(i) * 8 + (__builtin_clz(static_cast<unsigned>(byte)) - 24);
+        }
+        return -1;
+    }
+
+    // 对多个源位图做位运算，结果长度为最长源的长度，较短的源按0补齐
+    static std::string bitop(BITOP_TYPE op, const std::vector<const std::string*>& sources) {
+        size_t maxLen = 0;
+        for (auto src : sources) {
+            maxLen = std::max(maxLen, src->size());
+        }
+        std::string result(maxLen, '\0');
+        if (maxLen == 0) {
+            return result;
+        }
+        uint8_t* dst = reinterpret_cast<uint8_t*>(&result[0]);
+        if (op == BITOP_NOT) {
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(sources[0]->data());
+            size_t i = 0;
+            for (; i + 8 <= maxLen; i += 8) {
+                storeWord(dst + i, ~loadWord(src + i));
+            }
+            for (; i < maxLen; i++) {
+                dst[i] = ~src[i];
+            }
+            return result;
+        }
+        memcpy(dst, sources[0]->data(), sources[0]->size());
+        for (size_t k = 1; k < sources.size(); k++) {
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(sources[k]->data());
+            size_t len = sources[k]->size();
+            combine(op, dst, src, len);
+            if (op == BITOP_AND && len < maxLen) {
+                memset(dst + len, 0, maxLen - len); //与0做AND结果为0
+            }
+        }
+        return result;
+    }
+
+private:
+    // dst[0,len) = dst op src
+    static void combine(BITOP_TYPE op, uint8_t* dst, const uint8_t* src, size_t len) {
+        size_t i = 0;
+#ifdef __AVX2__
+        for (; i + BLOCK_SIZE <= len; i += BLOCK_SIZE) {
+            for (size_t j = 0; j < BLOCK_SIZE; j += 32) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i + j));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + j));
+                __m256i r = op == BITOP_AND ? _mm256_and_si256(a, b)
+                          : op == BITOP_OR ? _mm256_or_si256(a, b) : _mm256_xor_si256(a, b);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + j), r);
+            }
+        }
+#endif
+        for (; i + 8 <= len; i += 8) {
+            uint64_t a = loadWord(dst + i), b = loadWord(src + i);
+            storeWord(dst + i, op == BITOP_AND ? (a & b) : op == BITOP_OR ? (a | b) : (a ^ b));
+        }
+        for (; i < len; i++) {
+            dst[i] = op == BITOP_AND ? (dst[i] & src[i]) : op == BITOP_OR ? (dst[i] | src[i]) : (dst[i] ^ src[i]);
+        }
+    }
+};
+
+#endif
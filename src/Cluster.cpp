@@ -0,0 +1,298 @@
+#include "Cluster.h"
+#include "Crc16.h"
+#include "RedisHelper.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <strings.h>
+
+static bool equalsIgnoreCase(std::string_view token, std::string_view word) {
+    return token.size() == word.size() && strncasecmp(token.data(), word.data(), word.size()) == 0;
+}
+
+Cluster::Cluster() {
+    for (int slot = 0; slot < CLUSTER_SLOTS; slot++) {
+        owners[slot] = -1;
+        migrating[slot] = -1;
+        importing[slot] = -1;
+    }
+}
+
+Cluster* Cluster::getInstance() {
+    static Cluster cluster;
+    return &cluster;
+}
+
+uint16_t Cluster::keySlot(std::string_view key) {
+    size_t open = key.find('{');
+    if (open != std::string_view::npos) {
+        size_t close = key.find('}', open + 1);
+        if (close != std::string_view::npos && close > open + 1) {
+            key = key.substr(open + 1, close - open - 1);
+        }
+    }
+    return Crc16::value(key.data(), key.size()) & (CLUSTER_SLOTS - 1);
+}
+
+void Cluster::enable(const std::string& host, int port, const std::string& dataFolder) {
+    nodes[0].host = host;
+    nodes[0].port = port;
+    nodeCount = 1;
+    configPath = dataFolder + "/" + CLUSTER_CONFIG_FILE;
+    loadConfig();
+    enabled = true;
+}
+
+int Cluster::findOrAddNode(std::string_view host, int port) {
+    int count = nodeCount.load();
+    for (int node = 0; node < count; node++) {
+        if (nodes[node].host == host && nodes[node].port == port) {
+            return node;
+        }
+    }
+    if (count == CLUSTER_MAX_NODES) {
+        return -1;
+    }
+    //先写好地址再增加节点数，并发读取槽位表时不会看到写了一半的地址
+    nodes[count].host = std::string(host);
+    nodes[count].port = port;
+    nodeCount = count + 1;
+    return count;
+}
+
+std::string Cluster::nodeAddress(int node) const {
+    return nodes[node].host + ":" + std::to_string(nodes[node].port);
+}
+
+/*
+    nodes.conf每行一条记录：
+        myself <host> <port>                  保存时本节点的地址，地址改变后原来属于本节点的槽位仍然归本节点
+        slots <起始槽位> <结束槽位> <host> <port>
+        migrating <槽位> <host> <port>
+        importing <槽位> <host> <port>
+    先写临时文件再改名，保存到一半时崩溃不会留下不完整的槽位表
+*/
+void Cluster::saveConfig() {
+    std::string tmpPath = configPath + ".tmp";
+    std::ofstream file(tmpPath, std::ios::trunc);
+    file << "myself " << nodes[0].host << " " << nodes[0].port << "\n";
+    for (int slot = 0; slot < CLUSTER_SLOTS;) {
+        int owner = owners[slot];
+        int end = slot;
+        while (end + 1 < CLUSTER_SLOTS && owners[end + 1] == owner) {
+            end++;
+        }
+        if (owner >= 0) {
+            file << "slots " << slot << " " << end << " " << nodes[owner].host << " " << nodes[owner].port << "\n";
+        }
+        slot = end + 1;
+    }
+    for (int slot = 0; slot < CLUSTER_SLOTS; slot++) {
+        if (migrating[slot] >= 0) {
+            file << "migrating " << slot << " " << nodes[migrating[slot]].host << " " << nodes[migrating[slot]].port << "\n";
+        }
+        if (importing[slot] >= 0) {
+            file << "importing " << slot << " " << nodes[importing[slot]].host << " " << nodes[importing[slot]].port << "\n";
+        }
+    }
+    file.close();
+    if (!file || std::rename(tmpPath.c_str(), configPath.c_str()) != 0) {
+        std::cout << "集群配置：" << configPath << "保存失败" << std::endl;
+    }
+}
+
+void Cluster::loadConfig() {
+    std::ifstream file(configPath);
+    std::string line, type, host, savedHost;
+    int savedPort = -1;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        int first = 0, last = 0, port = 0;
+        fields >> type;
+        if (type == "myself") {
+            fields >> savedHost >> savedPort;
+            continue;
+        }
+        if (type == "slots") {
+            fields >> first >> last;
+        } else {
+            fields >> first;
+            last = first;
+        }
+        if (!(fields >> host >> port) || first < 0 || last >= CLUSTER_SLOTS || first > last) {
+            continue;
+        }
+        int node = host == savedHost && port == savedPort ? 0 : findOrAddNode(host, port);
+        if (node < 0) {
+            continue;
+        }
+        for (int slot = first; slot <= last; slot++) {
+            if (type == "slots") {
+                owners[slot] = node;
+            } else if (type == "migrating") {
+                migrating[slot] = node;
+            } else if (type == "importing") {
+                importing[slot] = node;
+            }
+        }
+    }
+}
+
+bool Cluster::route(const CommandDescriptor& descriptor, ArgSpan tokens, RedisHelper& helper, bool asking, ReplyBuilder& reply) {
+    if (!isEnabled()) {
+        return true;
+    }
+    if (descriptor.command == SELECT && tokens[1] != "0") {
+        reply.error("SELECT is not allowed in cluster mode");
+        return false;
+    }
+    static thread_local std::vector<size_t> positions;
+    CommandTable::getKeyPositions(descriptor, tokens, positions);
+    if (positions.empty()) {
+        return true; //没有键的命令（KEYS、SCAN、DBSIZE等）只作用于本节点
+    }
+    int slot = keySlot(tokens[positions[0]]);
+    for (size_t i = 1; i < positions.size(); i++) {
+        if (keySlot(tokens[positions[i]]) != slot) {
+            reply.error("CROSSSLOT", "Keys in request don't hash to the same slot");
+            return false;
+        }
+    }
+    int owner = owners[slot];
+    if (owner != 0) {
+        //ASKING之后的一条命令可以访问正在迁入的槽位
+        if (asking && importing[slot] >= 0) {
+            return true;
+        }
+        if (owner < 0) {
+            reply.error("CLUSTERDOWN", "Hash slot not served");
+        } else {
+            reply.error("MOVED", std::to_string(slot) + " " + nodeAddress(owner));
+        }
+        return false;
+    }
+    int target = migrating[slot];
+    if (target < 0) {
+        return true;
+    }
+    //槽位正在迁出：键都还在本节点时直接执行，都已迁走（或是新键）时让客户端去目标节点，部分迁走时稍后重试
+    size_t present = 0;
+    for (size_t position : positions) {
+        present += helper.hasKey(tokens[position]) ? 1 : 0;
+    }
+    if (present == positions.size()) {
+        return true;
+    }
+    if (present == 0) {
+        reply.error("ASK", std::to_string(slot) + " " + nodeAddress(target));
+    } else {
+        reply.error("TRYAGAIN", "Multiple keys request during rehashing of slot");
+    }
+    return false;
+}
+
+void Cluster::slots(ReplyBuilder& reply) {
+    size_t array = reply.beginArray();
+    size_t count = 0;
+    for (int slot = 0; slot < CLUSTER_SLOTS;) {
+        int owner = owners[slot];
+        int end = slot;
+        while (end + 1 < CLUSTER_SLOTS && owners[end + 1] == owner) {
+            end++;
+        }
+        if (owner >= 0) {
+            reply.arrayHeader(3);
+            reply.integer(slot);
+            reply.integer(end);
+            reply.arrayHeader(2);
+            reply.bulk(nodes[owner].host);
+            reply.integer(nodes[owner].port);
+            count++;
+        }
+        slot = end + 1;
+    }
+    reply.endArray(array, count);
+}
+
+void Cluster::info(ReplyBuilder& reply) {
+    int assigned = 0, mine = 0;
+    for (int slot = 0; slot < CLUSTER_SLOTS; slot++) {
+        assigned += owners[slot] >= 0 ? 1 : 0;
+        mine += owners[slot] == 0 ? 1 : 0;
+    }
+    std::string text;
+    text += "cluster_enabled:" + std::to_string(isEnabled() ? 1 : 0) + "\r\n";
+    text += std::string("cluster_state:") + (assigned == CLUSTER_SLOTS ? "ok" : "fail") + "\r\n";
+    text += "cluster_slots_assigned:" + std::to_string(assigned) + "\r\n";
+    text += "cluster_my_slots:" + std::to_string(mine) + "\r\n";
+    text += "cluster_known_nodes:" + std::to_string(nodeCount.load()) + "\r\n";
+    reply.bulk(text);
+}
+
+void Cluster::addSlots(ReplyBuilder& reply, const std::vector<int>& slotList) {
+    for (int slot : slotList) {
+        if (owners[slot] >= 0) {
+            return reply.error("Slot " + std::to_string(slot) + " is already busy");
+        }
+    }
+    for (int slot : slotList) {
+        owners[slot] = 0;
+    }
+    saveConfig();
+    reply.status("OK");
+}
+
+void Cluster::delSlots(ReplyBuilder& reply, const std::vector<int>& slotList) {
+    for (int slot : slotList) {
+        if (owners[slot] < 0) {
+            return reply.error("Slot " + std::to_string(slot) + " is already unassigned");
+        }
+    }
+    for (int slot : slotList) {
+        owners[slot] = -1;
+        migrating[slot] = -1;
+        importing[slot] = -1;
+    }
+    saveConfig();
+    reply.status("OK");
+}
+
+void Cluster::setSlot(ReplyBuilder& reply, int slot, std::string_view state, std::string_view host, int port) {
+    if (equalsIgnoreCase(state, "stable")) {
+        migrating[slot] = -1;
+        importing[slot] = -1;
+        saveConfig();
+        return reply.status("OK");
+    }
+    int node = findOrAddNode(host, port);
+    if (node < 0) {
+        return reply.error("Too many nodes in the slot table");
+    }
+    if (equalsIgnoreCase(state, "node")) {
+        //迁移结束时在源节点和目标节点上都执行，槽位归属改变，迁移状态清除
+        owners[slot] = node;
+        migrating[slot] = -1;
+        importing[slot] = -1;
+    } else if (equalsIgnoreCase(state, "migrating")) {
+        if (owners[slot] != 0) {
+            return reply.error("I'm not the owner of hash slot " + std::to_string(slot));
+        }
+        if (node == 0) {
+            return reply.error("Can't migrate a slot to myself");
+        }
+        migrating[slot] = node;
+    } else if (equalsIgnoreCase(state, "importing")) {
+        if (owners[slot] == 0) {
+            return reply.error("I'm already the owner of hash slot " + std::to_string(slot));
+        }
+        if (node == 0) {
+            return reply.error("Can't import a slot from myself");
+        }
+        importing[slot] = node;
+    } else {
+        return reply.error("Invalid CLUSTER SETSLOT action or number of arguments");
+    }
+    saveConfig();
+    reply.status("OK");
+}
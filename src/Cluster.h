@@ -0,0 +1,77 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CommandArgs.h"
+#include "CommandTable.h"
+#include "ReplyBuilder.h"
+
+class RedisHelper;
+
+#define CLUSTER_SLOTS 16384          //槽位总数
+#define CLUSTER_MAX_NODES 1024       //槽位表中最多记录的节点数
+#define CLUSTER_CONFIG_FILE "nodes.conf" //槽位表保存在数据目录下的这个文件中
+
+/*
+    Cluster 集群模式
+    键空间分成CLUSTER_SLOTS个槽位，键的槽位是CRC16(键) % 16384；键中含有{...}且括号内非空时只对括号内的部分
+    （hashtag）计算，这样user:{42}:name和user:{42}:age一定在同一个槽位，可以在一条命令里一起操作。
+    每个节点记录所有槽位的归属，命令的键不属于本节点时返回：
+        -MOVED <槽位> <host>:<port>     槽位已经属于其它节点，客户端应更新槽位表并重发
+        -ASK <槽位> <host>:<port>       槽位正在迁出且键已经不在本节点，客户端先向目标节点发ASKING再重发这一条命令
+        -CROSSSLOT ...                  一条命令的多个键不在同一个槽位
+        -CLUSTERDOWN ...                槽位没有分配给任何节点
+    节点之间没有gossip协议，槽位表由管理员（或脚本）用CLUSTER ADDSLOTS/SETSLOT在每个节点上设置，
+    节点用host port标识（而不是Redis的节点ID），每次修改后保存到数据目录下的nodes.conf，重启后恢复。
+    集群模式下只有0号数据库。
+    槽位表在命令锁内修改，读取不加锁（副本的只读命令不进入命令锁，见RedisServer::serveRead），
+    因此每个槽位的归属是一个原子变量，节点地址只追加、写入后不再修改。
+*/
+class Cluster {
+private:
+    struct NodeAddress {
+        std::string host;
+        int port = 0;
+    };
+
+    std::atomic<bool> enabled{false};
+    std::string configPath;
+    NodeAddress nodes[CLUSTER_MAX_NODES]; //0号是本节点
+    std::atomic<int> nodeCount{0};
+    std::atomic<int16_t> owners[CLUSTER_SLOTS];    //槽位所属节点的下标，-1表示未分配
+    std::atomic<int16_t> migrating[CLUSTER_SLOTS]; //本节点的槽位正在迁往的节点，-1表示没有迁移
+    std::atomic<int16_t> importing[CLUSTER_SLOTS]; //正在从哪个节点迁入这个槽位，-1表示没有迁移
+
+    Cluster();
+    // 查找节点，不存在时追加，节点数已满时返回-1
+    int findOrAddNode(std::string_view host, int port);
+    std::string nodeAddress(int node) const;
+    void saveConfig();
+    void loadConfig();
+
+public:
+    static Cluster* getInstance();
+    // 键所属的槽位，处理{hashtag}
+    static uint16_t keySlot(std::string_view key);
+
+    // 以集群模式运行，host和port是其它节点和客户端访问本节点的地址
+    void enable(const std::string& host, int port, const std::string& dataFolder);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // 检查命令能否在本节点执行，helper用于确认迁移中的槽位里键是否还在本节点
+    // 不能执行时把重定向或错误写入reply并返回false；asking表示上一条命令是ASKING
+    bool route(const CommandDescriptor& descriptor, ArgSpan tokens, RedisHelper& helper, bool asking, ReplyBuilder& reply);
+
+    // CLUSTER子命令，由ClusterParser检查参数后调用
+    void slots(ReplyBuilder& reply);
+    void info(ReplyBuilder& reply);
+    void addSlots(ReplyBuilder& reply, const std::vector<int>& slotList);
+    void delSlots(ReplyBuilder& reply, const std::vector<int>& slotList);
+    // state为NODE、MIGRATING、IMPORTING或STABLE（STABLE时忽略host和port）
+    void setSlot(ReplyBuilder& reply, int slot, std::string_view state, std::string_view host, int port);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef COMMANDARGS_H
+#define COMMANDARGS_H
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    ArgSpan 是一条命令的参数视图
+    参数是指向连接输入缓冲区的string_view，解析器和RedisHelper只读取它们，
+    请求路径上不再为每个参数分配std::string，只有真正写入数据库的键和值才会拷贝。
+    输入缓冲区必须在命令执行结束前保持有效。
+*/
+class ArgSpan {
+private:
+    const std::string_view* first = nullptr;
+    size_t count = 0;
+
+public:
+    ArgSpan() = default;
+    ArgSpan(const std::string_view* first, size_t count) : first(first), count(count) {}
+    ArgSpan(const std::vector<std::string_view>& args) : first(args.data()), count(args.size()) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const std::string_view& operator[](size_t index) const { return first[index]; }
+    const std::string_view& front() const { return first[0]; }
+    const std::string_view& back() const { return first[count - 1]; }
+    const std::string_view* begin() const { return first; }
+    const std::string_view* end() const { return first + count; }
+
+    // 从offset开始的子视图，offset超过长度时返回空视图
+    ArgSpan subspan(size_t offset, size_t length = static_cast<size_t>(-1)) const {
+        if (offset >= count) {
+            return ArgSpan(first + count, 0);
+        }
+        return ArgSpan(first + offset, length < count - offset ? length : count - offset);
+    }
+};
+
+// 整个参数都是合法的整数时返回true，不接受前后空白和多余字符
+template <typename Integer>
+inline bool parseInteger(std::string_view text, Integer& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+inline bool parseDouble(std::string_view text, double& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+// 把一个参数追加到按空白分隔的命令文本中（复制流、迁移），服务器分词时能还原出同一个参数：
+// 空串、含空白或以引号开头的参数用双引号括起来，其中的"和\前加\转义，任意字节都能原样还原
+inline void appendArgument(std::string& command, std::string_view arg) {
+    auto isSpace = [](char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); };
+    if (!command.empty()) {
+        command += ' ';
+    }
+    bool plain = !arg.empty() && arg[0] != '"' && arg[0] != '\'';
+    for (size_t i = 0; plain && i < arg.size(); i++) {
+        plain = !isSpace(arg[i]);
+    }
+    if (plain) {
+        command.append(arg.data(), arg.size());
+        return;
+    }
+    command += '"';
+    for (char ch : arg) {
+        if (ch == '"' || ch == '\\') {
+            command += '\\';
+        }
+        command += ch;
+    }
+    command += '"';
+}
+
+#endif
@@ -1,270 +1,938 @@
 
 #include "CommandParser.h"
+#include "CommandTable.h"
+#include "Replication.h"
+#include "Cluster.h"
+#include "Migration.h"
+#include "Scripting.h"
+#include "PubSub.h"
+#include <cmath>
+#include <strings.h>
 
-// 静态成员变量的初始化
-std::shared_ptr<RedisHelper> CommandParser::redisHelper = std::make_shared<RedisHelper>();
+// 静态成员变量的初始化，启动时由server.cpp按命令行参数中的数据目录创建
+std::shared_ptr<RedisHelper> CommandParser::redisHelper;
+thread_local RedisHelper* CommandParser::boundHelper = nullptr;
+
+// 不区分大小写地比较参数和关键字，不需要先拷贝出一个小写副本
+static bool equalsIgnoreCase(std::string_view token, std::string_view word) {
+    return token.size() == word.size() && strncasecmp(token.data(), word.data(), word.size()) == 0;
+}
 
 // SelectParser 
 //select命令来选择数据库
-std::string SelectParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for SELECT.";
-    }
+void SelectParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
     int index = 0;
-    try {
-        index = std::stoi(tokens[1]); //将字符串转换为整数
-    } catch (std::invalid_argument const& e) { //如果转换失败
-        return tokens[1] + " is not a numeric type"; //返回错误信息
+    if (!parseInteger(tokens[1], index)) { //将字符串转换为整数，失败时返回错误信息
+        return reply.error(std::string(tokens[1]) + " is not a numeric type");
     }
-    return redisHelper->select(index); //调用RedisHelper的select方法
+    return helper()->select(reply, index); //调用RedisHelper的select方法
 }
 
 // SetParser 
-std::string SetParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for SET.";
-    }
+void SetParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    RedisValue value = std::string(tokens[2]); //值会保存到数据库中，这里是唯一需要拷贝的地方
     if (tokens.size() == 4) {
         if (tokens.back() == "NX") {
-            return redisHelper->set(tokens[1], tokens[2], NX);
+            return helper()->set(reply, tokens[1], value, NX);
         } else if (tokens.back() == "XX") {
-            return redisHelper->set(tokens[1], tokens[2], XX);
+            return helper()->set(reply, tokens[1], value, XX);
         }
     }
-    return redisHelper->set(tokens[1], tokens[2]);
+    return helper()->set(reply, tokens[1], value);
 }
 
 // SetnxParser 
-std::string SetnxParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for SETNX.";
-    }
-    return redisHelper->setnx(tokens[1], tokens[2]);
+void SetnxParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->setnx(reply, tokens[1], RedisValue(std::string(tokens[2])));
 }
 
 // SetexParser 
-std::string SetexParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for SETEX.";
-    }
-    return redisHelper->setex(tokens[1], tokens[2]);
+void SetexParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->setex(reply, tokens[1], RedisValue(std::string(tokens[2])));
 }
 
 // GetParser 
-std::string GetParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for GET.";
-    }
-    return redisHelper->get(tokens[1]);
+void GetParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->get(reply, tokens[1]);
 }
 
 // KeysParser 
-std::string KeysParser::parse(std::vector<std::string>& tokens) {
-    return redisHelper->keys();
+void KeysParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (tokens.size() > 2) {
+        return reply.error("wrong number of arguments for KEYS.");
+    }
+    return helper()->keys(reply, tokens.size() == 2 ? tokens[1] : "*");
 }
 
 // DBSizeParser 
-std::string DBSizeParser::parse(std::vector<std::string>& tokens) {
-    return redisHelper->dbsize();
+void DBSizeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->dbsize(reply);
 }
 
 // ExistsParser 
-std::string ExistsParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for EXISTS.";
-    }
-    tokens.erase(tokens.begin()); // 移除命令本身
-    return redisHelper->exists(tokens);
+void ExistsParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->exists(reply, tokens.subspan(1)); // 跳过命令本身
 }
 
 // DelParser 
-std::string DelParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for DEL.";
-    }
-    tokens.erase(tokens.begin()); // 移除命令本身
-    return redisHelper->del(tokens);
+void DelParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->del(reply, tokens.subspan(1)); // 跳过命令本身
 }
 
 // RenameParser 
-std::string RenameParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for RENAME.";
-    }
-    return redisHelper->rename(tokens[1], tokens[2]);
+void RenameParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->rename(reply, tokens[1], tokens[2]);
 }
 
 // IncrParser 
-std::string IncrParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for INCR.";
-    }
-    return redisHelper->incr(tokens[1]);
+void IncrParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->incr(reply, tokens[1]);
 }
 
 // IncrbyParser 
-std::string IncrbyParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for INCRBY.";
-    }
+void IncrbyParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
     int increment = 0;
-    try {
-        increment = std::stoi(tokens[2]);
-    } catch (std::invalid_argument const& e) {
-        return tokens[2] + " is not a numeric type";
+    if (!parseInteger(tokens[2], increment)) {
+        return reply.error(std::string(tokens[2]) + " is not a numeric type");
     }
-    return redisHelper->incrby(tokens[1], increment);
+    return helper()->incrby(reply, tokens[1], increment);
 }
 
 // IncrbyfloatParser 
-std::string IncrbyfloatParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for INCRBYFLOAT.";
-    }
+void IncrbyfloatParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
     double increment = 0.0;
-    try {
-        increment = std::stod(tokens[2]);
-    } catch (std::invalid_argument const& e) {
-        return tokens[2] + " is not a numeric type";
+    if (!parseDouble(tokens[2], increment)) {
+        return reply.error(std::string(tokens[2]) + " is not a numeric type");
     }
-    return redisHelper->incrbyfloat(tokens[1], increment);
+    return helper()->incrbyfloat(reply, tokens[1], increment);
 }
 
 // DecrParser 
-std::string DecrParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for DECR.";
-    }
-    return redisHelper->decr(tokens[1]);
+void DecrParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->decr(reply, tokens[1]);
 }
 
 // DecrbyParser 
-std::string DecrbyParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for DECRBY.";
-    }
+void DecrbyParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
     int decrement = 0;
-    try {
-        decrement = std::stoi(tokens[2]);
-    } catch (std::invalid_argument const& e) {
-        return tokens[2] + " is not a numeric type";
+    if (!parseInteger(tokens[2], decrement)) {
+        return reply.error(std::string(tokens[2]) + " is not a numeric type");
     }
-    return redisHelper->decrby(tokens[1], decrement);
+    return helper()->decrby(reply, tokens[1], decrement);
 }
 
 // MSetParser 
-std::string MSetParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3 || tokens.size() % 2 == 0) { // 需要成对的键值
-        return "wrong number of arguments for MSET.";
+void MSetParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (tokens.size() % 2 == 0) { // 需要成对的键值
+        return reply.error("wrong number of arguments for MSET.");
     }
-    tokens.erase(tokens.begin()); // 移除命令本身
-    return redisHelper->mset(tokens);
+    return helper()->mset(reply, tokens.subspan(1)); // 跳过命令本身
 }
 
 // MGetParser 
-std::string MGetParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for MGET.";
-    }
-    tokens.erase(tokens.begin()); // 移除命令本身
-    return redisHelper->mget(tokens);
+void MGetParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->mget(reply, tokens.subspan(1)); // 跳过命令本身
 }
 
 // StrlenParser 
-std::string StrlenParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for STRLEN.";
-    }
-    return redisHelper->strlen(tokens[1]);
+void StrlenParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->strlen(reply, tokens[1]);
 }
 
 // AppendParser 
-std::string AppendParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for APPEND.";
-    }
-    return redisHelper->append(tokens[1], tokens[2]);
+void AppendParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->append(reply, tokens[1], tokens[2]);
 }
 
 
-std::string LPushParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for LPUSH.";
-    }
-    return redisHelper->lpush(tokens[1],tokens[2]);
+void LPushParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->lpush(reply, tokens[1],tokens[2]);
 }
-std::string RPushParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for RPUSH.";
-    }
-    return redisHelper->rpush(tokens[1],tokens[2]);
+void RPushParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->rpush(reply, tokens[1],tokens[2]);
+}
+void LPopParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->lpop(reply, tokens[1]);
+}
+void RPopParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->rpop(reply, tokens[1]);
 }
-std::string LPopParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for LPOP.";
+
+// 阻塞命令最后一个参数是以秒为单位的超时时间，可以是小数，0表示一直等待
+static bool parseBlockingTimeout(std::string_view token, ReplyBuilder& reply) {
+    double timeout = 0;
+    if (!parseDouble(token, timeout) || !std::isfinite(timeout)) {
+        reply.error("timeout is not a float or out of range");
+        return false;
+    }
+    if (timeout < 0) {
+        reply.error("timeout is negative");
+        return false;
+    }
+    return true;
+}
+
+// 解析器本身不阻塞：有元素时立即弹出，没有时返回空，由RedisServer决定是否让客户端等待（见RedisServer::blockClient）
+// BLPOP key [key ...] timeout
+void BLPopParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (!parseBlockingTimeout(tokens.back(), reply)) {
+        return;
+    }
+    if (!helper()->popFirst(reply, tokens.subspan(1, tokens.size() - 2), true)) {
+        reply.nilArray();
     }
-    return redisHelper->lpop(tokens[1]);
 }
-std::string RPopParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 2) {
-        return "wrong number of arguments for LPOP.";
+// BRPOP key [key ...] timeout
+void BRPopParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (!parseBlockingTimeout(tokens.back(), reply)) {
+        return;
+    }
+    if (!helper()->popFirst(reply, tokens.subspan(1, tokens.size() - 2), false)) {
+        reply.nilArray();
     }
-    return redisHelper->rpop(tokens[1]);
 }
-std::string LRangeParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 4) {
-        return "wrong number of arguments for LPOP.";
+// BLMOVE source destination LEFT|RIGHT LEFT|RIGHT timeout
+void BLMoveParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    bool ends[2];
+    for (int i = 0; i < 2; i++) {
+        if (!equalsIgnoreCase(tokens[3 + i], "left") && !equalsIgnoreCase(tokens[3 + i], "right")) {
+            return reply.error("syntax error");
+        }
+        ends[i] = equalsIgnoreCase(tokens[3 + i], "left");
     }
+    if (!parseBlockingTimeout(tokens[5], reply)) {
+        return;
+    }
+    if (!helper()->move(reply, tokens[1], tokens[2], ends[0], ends[1])) {
+        reply.nil();
+    }
+}
+void LRangeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
     int start = 0;
     int end = 0;
-    try {
-        start = std::stoi(tokens[2]);
-        end = std::stoi(tokens[3]);
-    } catch (std::invalid_argument const& e) {
-        return tokens[2]+" or "+tokens[3] + " is not a integer type";
+    if (!parseInteger(tokens[2], start) || !parseInteger(tokens[3], end)) {
+        return reply.error(std::string(tokens[2]) + " or " + std::string(tokens[3]) + " is not a integer type");
     }
-    return redisHelper->lrange(tokens[1],tokens[2],tokens[3]);
+    return helper()->lrange(reply, tokens[1], start, end);
 }
 
 
 // HSetParser
-std::string HSetParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 4||tokens.size()%2!=0) {
-        return "wrong number of arguments for HSET.";
+void HSetParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (tokens.size() % 2 != 0) { // 需要成对的字段和值
+        return reply.error("wrong number of arguments for HSET.");
     }
-    std::vector<std::string> fields(tokens.begin() + 2, tokens.end());
-    return redisHelper->hset(tokens[1], fields);
+    return helper()->hset(reply, tokens[1], tokens.subspan(2));
 }
 
 // HGetParser
-std::string HGetParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() != 3) {
-        return "wrong number of arguments for HGET.";
-    }
-    return redisHelper->hget(tokens[1], tokens[2]);
+void HGetParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->hget(reply, tokens[1], tokens[2]);
 }
 
 // HDelParser
-std::string HDelParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() < 3) {
-        return "wrong number of arguments for HDEL.";
-    }
-    std::vector<std::string> fields(tokens.begin() + 2, tokens.end());
-    return redisHelper->hdel(tokens[1], fields);
+void HDelParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->hdel(reply, tokens[1], tokens.subspan(2));
 }
 
 // HKeysParser
-std::string HKeysParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() != 2) {
-        return "wrong number of arguments for HKEYS.";
-    }
-    return redisHelper->hkeys(tokens[1]);
+void HKeysParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->hkeys(reply, tokens[1]);
 }
 
 // HValsParser
-std::string HValsParser::parse(std::vector<std::string>& tokens) {
-    if (tokens.size() != 2) {
-        return "wrong number of arguments for HVALS.";
+void HValsParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->hvals(reply, tokens[1]);
+}
+
+
+// 位偏移的合法范围与Redis一致：[0, 2^32-1]
+static bool parseBitOffset(std::string_view token, long long& offset) {
+    return parseInteger(token, offset) && offset >= 0 && offset <= 4294967295LL;
+}
+
+// SetBitParser
+void SetBitParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    long long offset = 0;
+    if (!parseBitOffset(tokens[2], offset)) {
+        return reply.error("bit offset is not an integer or out of range");
     }
-    return redisHelper->hvals(tokens[1]);
+    if (tokens[3] != "0" && tokens[3] != "1") {
+        return reply.error("bit is not an integer or out of range");
+    }
+    return helper()->setbit(reply, tokens[1], offset, tokens[3] == "1");
+}
+
+// GetBitParser
+void GetBitParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    long long offset = 0;
+    if (!parseBitOffset(tokens[2], offset)) {
+        return reply.error("bit offset is not an integer or out of range");
+    }
+    return helper()->getbit(reply, tokens[1], offset);
+}
+
+// BitCountParser
+void BitCountParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (tokens.size() != 2 && tokens.size() != 4) {
+        return reply.error("wrong number of arguments for BITCOUNT.");
+    }
+    if (tokens.size() == 2) {
+        return helper()->bitcount(reply, tokens[1]);
+    }
+    long long start = 0;
+    long long end = 0;
+    if (!parseInteger(tokens[2], start) || !parseInteger(tokens[3], end)) {
+        return reply.error(std::string(tokens[2]) + " or " + std::string(tokens[3]) + " is not a integer type");
+    }
+    return helper()->bitcount(reply, tokens[1], start, end);
+}
+
+// BitPosParser
+void BitPosParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (tokens.size() > 5) {
+        return reply.error("wrong number of arguments for BITPOS.");
+    }
+    if (tokens[2] != "0" && tokens[2] != "1") {
+        return reply.error("The bit argument must be 1 or 0.");
+    }
+    long long start = 0;
+    long long end = -1;
+    if ((tokens.size() >= 4 && !parseInteger(tokens[3], start))
+        || (tokens.size() == 5 && !parseInteger(tokens[4], end))) {
+        return reply.error("start or end is not a integer type");
+    }
+    return helper()->bitpos(reply, tokens[1], tokens[2] == "1", start, end, tokens.size() == 5);
+}
+
+// BitOpParser
+void BitOpParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    BITOP_TYPE op;
+    if (equalsIgnoreCase(tokens[1], "and")) {
+        op = BITOP_AND;
+    } else if (equalsIgnoreCase(tokens[1], "or")) {
+        op = BITOP_OR;
+    } else if (equalsIgnoreCase(tokens[1], "xor")) {
+        op = BITOP_XOR;
+    } else if (equalsIgnoreCase(tokens[1], "not")) {
+        op = BITOP_NOT;
+    } else {
+        return reply.error("syntax error: unknown BITOP operation " + std::string(tokens[1]));
+    }
+    ArgSpan keys = tokens.subspan(3);
+    if (op == BITOP_NOT && keys.size() != 1) {
+        return reply.error("BITOP NOT must be called with a single source key.");
+    }
+    return helper()->bitop(reply, op, tokens[2], keys);
+}
+
+// PFAddParser
+void PFAddParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->pfadd(reply, tokens[1], tokens.subspan(2));
+}
+
+// PFCountParser
+void PFCountParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->pfcount(reply, tokens.subspan(1)); // 跳过命令本身
+}
+
+// PFMergeParser
+void PFMergeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->pfmerge(reply, tokens[1], tokens.subspan(2));
+}
+
+// 解析 MAXLEN|MINID [=|~] threshold，成功时pos指向threshold之后
+static bool parseTrimOption(ArgSpan tokens, size_t& pos, STREAM_TRIM_MODEL& trimModel,
+                            bool& approx, std::string_view& threshold) {
+    if (equalsIgnoreCase(tokens[pos], "maxlen")) {
+        trimModel = TRIM_MAXLEN;
+    } else if (equalsIgnoreCase(tokens[pos], "minid")) {
+        trimModel = TRIM_MINID;
+    } else {
+        return false;
+    }
+    pos++;
+    if (pos < tokens.size() && (tokens[pos] == "=" || tokens[pos] == "~")) {
+        approx = tokens[pos] == "~";
+        pos++;
+    }
+    if (pos >= tokens.size()) {
+        return false;
+    }
+    threshold = tokens[pos++];
+    return true;
+}
+
+// XAddParser
+void XAddParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    size_t pos = 2;
+    bool noMkStream = false;
+    STREAM_TRIM_MODEL trimModel = TRIM_NONE;
+    bool approx = false;
+    std::string_view threshold;
+    while (pos < tokens.size()) {
+        if (equalsIgnoreCase(tokens[pos], "nomkstream")) {
+            noMkStream = true;
+            pos++;
+        } else if (equalsIgnoreCase(tokens[pos], "maxlen") || equalsIgnoreCase(tokens[pos], "minid")) {
+            if (!parseTrimOption(tokens, pos, trimModel, approx, threshold)) {
+                return reply.error("syntax error");
+            }
+        } else {
+            break;
+        }
+    }
+    if (pos >= tokens.size() || (tokens.size() - pos - 1) % 2 != 0 || tokens.size() - pos - 1 == 0) {
+        return reply.error("wrong number of arguments for XADD.");
+    }
+    return helper()->xadd(reply, tokens[1], tokens[pos], tokens.subspan(pos + 1), noMkStream, trimModel, approx, threshold);
+}
+
+// XRangeParser
+void XRangeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (tokens.size() != 4 && tokens.size() != 6) {
+        return reply.error("wrong number of arguments for XRANGE.");
+    }
+    long long count = 0;
+    if (tokens.size() == 6) {
+        if (!equalsIgnoreCase(tokens[4], "count")) {
+            return reply.error("syntax error");
+        }
+        if (!parseInteger(tokens[5], count)) {
+            return reply.error(std::string(tokens[5]) + " is not a integer type");
+        }
+        if (count <= 0) {
+            return reply.arrayHeader(0);
+        }
+    }
+    return helper()->xrange(reply, tokens[1], tokens[2], tokens[3], count);
+}
+
+// XReadParser
+void XReadParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    size_t pos = 1;
+    long long count = 0;
+    if (pos < tokens.size() && equalsIgnoreCase(tokens[pos], "count")) {
+        if (pos + 1 >= tokens.size()) {
+            return reply.error("syntax error");
+        }
+        if (!parseInteger(tokens[pos + 1], count)) {
+            return reply.error(std::string(tokens[pos + 1]) + " is not a integer type");
+        }
+        pos += 2;
+    }
+    if (pos >= tokens.size() || !equalsIgnoreCase(tokens[pos], "streams")) {
+        return reply.error("syntax error");
+    }
+    pos++;
+    size_t remaining = tokens.size() - pos;
+    if (remaining == 0 || remaining % 2 != 0) {
+        return reply.error("Unbalanced XREAD list of streams: for each stream key an ID or '$' must be specified.");
+    }
+    return helper()->xread(reply, tokens.subspan(pos, remaining / 2), tokens.subspan(pos + remaining / 2), count > 0 ? count : 0);
+}
+
+// XLenParser
+void XLenParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->xlen(reply, tokens[1]);
+}
+
+// XTrimParser
+void XTrimParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    size_t pos = 2;
+    STREAM_TRIM_MODEL trimModel = TRIM_NONE;
+    bool approx = false;
+    std::string_view threshold;
+    if (!parseTrimOption(tokens, pos, trimModel, approx, threshold) || pos != tokens.size()) {
+        return reply.error("syntax error");
+    }
+    return helper()->xtrim(reply, tokens[1], trimModel, approx, threshold);
+}
+
+// 解析 [MATCH pattern] [COUNT count] [TYPE type]，allowType为false时不接受TYPE
+static std::string parseScanOptions(ArgSpan tokens, size_t pos, bool allowType,
+                                    std::string_view& pattern, size_t& count, std::string& type) {
+    while (pos < tokens.size()) {
+        if (pos + 1 >= tokens.size()) {
+            return "syntax error";
+        }
+        if (equalsIgnoreCase(tokens[pos], "match")) {
+            pattern = tokens[pos + 1];
+        } else if (equalsIgnoreCase(tokens[pos], "count")) {
+            long long value = 0;
+            if (!parseInteger(tokens[pos + 1], value)) {
+                return std::string(tokens[pos + 1]) + " is not a integer type";
+            }
+            if (value < 1) {
+                return "syntax error";
+            }
+            count = value;
+        } else if (equalsIgnoreCase(tokens[pos], "type") && allowType) {
+            type.assign(tokens[pos + 1]);
+            for (auto& ch : type) {
+                ch = tolower(ch);
+            }
+        } else {
+            return "syntax error";
+        }
+        pos += 2;
+    }
+    return "";
+}
+
+// ScanParser
+void ScanParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    std::string_view pattern = "*";
+    size_t count = 10;
+    std::string type;
+    std::string err = parseScanOptions(tokens, 2, true, pattern, count, type);
+    if (!err.empty()) {
+        return reply.error(err);
+    }
+    return helper()->scan(reply, tokens[1], pattern, count, type);
+}
+
+// HScanParser
+void HScanParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    std::string_view pattern = "*";
+    size_t count = 10;
+    std::string type;
+    std::string err = parseScanOptions(tokens, 3, false, pattern, count, type);
+    if (!err.empty()) {
+        return reply.error(err);
+    }
+    return helper()->hscan(reply, tokens[1], tokens[2], pattern, count);
+}
+
+// 解析 [WITHVALUES] [LIMIT count]
+static std::string parseKeyRangeOptions(ArgSpan tokens, bool& withValues, size_t& limit) {
+    for (size_t pos = 3; pos < tokens.size(); pos++) {
+        if (equalsIgnoreCase(tokens[pos], "withvalues")) {
+            withValues = true;
+        } else if (equalsIgnoreCase(tokens[pos], "limit") && pos + 1 < tokens.size()) {
+            long long value = 0;
+            if (!parseInteger(tokens[++pos], value)) {
+                return std::string(tokens[pos]) + " is not a integer type";
+            }
+            limit = value > 0 ? value : 0;
+        } else {
+            return "syntax error";
+        }
+    }
+    return "";
+}
+
+// KRangeParser
+void KRangeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    bool withValues = false;
+    size_t limit = 0;
+    std::string err = parseKeyRangeOptions(tokens, withValues, limit);
+    if (!err.empty()) {
+        return reply.error(err);
+    }
+    return helper()->krange(reply, tokens[1], tokens[2], withValues, limit);
+}
+
+// KRevRangeParser
+void KRevRangeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    bool withValues = false;
+    size_t limit = 0;
+    std::string err = parseKeyRangeOptions(tokens, withValues, limit);
+    if (!err.empty()) {
+        return reply.error(err);
+    }
+    return helper()->krange(reply, tokens[2], tokens[1], withValues, limit, true);
+}
+
+// KCountParser
+void KCountParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->kcount(reply, tokens[1], tokens[2]);
+}
+
+// DumpParser
+void DumpParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return helper()->dump(reply, tokens[1]);
+}
+
+// RestoreParser
+void RestoreParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    long long ttl = 0;
+    if (!parseInteger(tokens[2], ttl) || ttl < 0) {
+        return reply.error("Invalid TTL value, must be >= 0");
+    }
+    bool replace = false;
+    for (size_t pos = 4; pos < tokens.size(); pos++) {
+        if (!equalsIgnoreCase(tokens[pos], "replace")) {
+            return reply.error("syntax error");
+        }
+        replace = true;
+    }
+    return helper()->restore(reply, tokens[1], ttl, tokens[3], replace);
+}
+
+// 按命令表输出一条命令的元数据：[名字, arity, [标志 ...], 第一个键, 最后一个键, 步长]
+static void replyCommandInfo(ReplyBuilder& reply, const CommandDescriptor& command) {
+    static const std::pair<int, std::string_view> flagNames[] = {
+        {CMD_WRITE, "write"}, {CMD_READONLY, "readonly"}, {CMD_MOVABLE_KEYS, "movablekeys"}, {CMD_NO_QUEUE, "no_multi"},
+        {CMD_NO_SCRIPT, "noscript"}, {CMD_BLOCKING, "blocking"}, {CMD_PUBSUB, "pubsub"},
+        {CMD_SELF_REPLICATED, "self_replicated"}, {CMD_MAY_REPLICATE, "may_replicate"}
+    };
+    reply.arrayHeader(6);
+    reply.bulk(command.name);
+    reply.integer(command.arity);
+    size_t flags = 0;
+    for (auto& flag : flagNames) {
+        flags += (command.flags & flag.first) ? 1 : 0;
+    }
+    reply.arrayHeader(flags);
+    for (auto& flag : flagNames) {
+        if (command.flags & flag.first) {
+            reply.status(flag.second);
+        }
+    }
+    reply.integer(command.firstKey);
+    reply.integer(command.lastKey);
+    reply.integer(command.keyStep);
+}
+
+// CommandInfoParser
+void CommandInfoParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    if (tokens.size() >= 2 && equalsIgnoreCase(tokens[1], "count")) {
+        return reply.integer(CommandTable::size());
+    }
+    if (tokens.size() >= 3 && equalsIgnoreCase(tokens[1], "getkeys")) {
+        ArgSpan args = tokens.subspan(2);
+        const CommandDescriptor* command = CommandTable::lookup(args[0]);
+        if (command == nullptr) {
+            return reply.error("Invalid command specified");
+        }
+        if (!CommandTable::checkArity(*command, args.size())) {
+            return reply.error("Invalid number of arguments specified for command");
+        }
+        std::vector<size_t> positions;
+        CommandTable::getKeyPositions(*command, args, positions);
+        if (positions.empty()) {
+            return reply.error("The command has no key arguments");
+        }
+        reply.arrayHeader(positions.size());
+        for (size_t position : positions) {
+            reply.bulk(args[position]);
+        }
+        return;
+    }
+    if (tokens.size() == 1) {
+        reply.arrayHeader(CommandTable::size());
+        for (auto it = CommandTable::begin(); it != CommandTable::end(); ++it) {
+            replyCommandInfo(reply, *it);
+        }
+    } else if (equalsIgnoreCase(tokens[1], "info")) {
+        ArgSpan names = tokens.subspan(2);
+        reply.arrayHeader(names.size());
+        for (auto& name : names) {
+            const CommandDescriptor* command = CommandTable::lookup(name);
+            if (command == nullptr) {
+                reply.nil();
+            } else {
+                replyCommandInfo(reply, *command);
+            }
+        }
+    } else {
+        reply.error("syntax error");
+    }
+}
+
+// ReplicaOfParser
+void ReplicaOfParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return Replication::getInstance()->replicaOf(reply, tokens[1], tokens[2]);
+}
+
+// RoleParser
+void RoleParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return Replication::getInstance()->role(reply);
+}
+
+// 解析槽位编号，超出范围时返回false
+static bool parseSlot(std::string_view token, int& slot) {
+    return parseInteger(token, slot) && slot >= 0 && slot < CLUSTER_SLOTS;
+}
+
+// ClusterParser
+// CLUSTER KEYSLOT key | SLOTS | INFO | ADDSLOTS slot [slot ...] | ADDSLOTSRANGE start end [start end ...]
+// CLUSTER DELSLOTS slot [slot ...] | SETSLOT slot NODE|MIGRATING|IMPORTING host port | SETSLOT slot STABLE
+// CLUSTER COUNTKEYSINSLOT slot | GETKEYSINSLOT slot count
+void ClusterParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    Cluster* cluster = Cluster::getInstance();
+    std::string_view subcommand = tokens[1];
+    if (equalsIgnoreCase(subcommand, "keyslot") && tokens.size() == 3) {
+        return reply.integer(Cluster::keySlot(tokens[2]));
+    }
+    if (!cluster->isEnabled()) {
+        return reply.error("This instance has cluster support disabled");
+    }
+    if (equalsIgnoreCase(subcommand, "slots") && tokens.size() == 2) {
+        return cluster->slots(reply);
+    }
+    if (equalsIgnoreCase(subcommand, "info") && tokens.size() == 2) {
+        return cluster->info(reply);
+    }
+    std::vector<int> slotList;
+    if ((equalsIgnoreCase(subcommand, "addslots") || equalsIgnoreCase(subcommand, "delslots")) && tokens.size() > 2) {
+        for (size_t i = 2; i < tokens.size(); i++) {
+            int slot;
+            if (!parseSlot(tokens[i], slot)) {
+                return reply.error("Invalid or out of range slot");
+            }
+            slotList.push_back(slot);
+        }
+        return equalsIgnoreCase(subcommand, "addslots") ? cluster->addSlots(reply, slotList) : cluster->delSlots(reply, slotList);
+    }
+    if (equalsIgnoreCase(subcommand, "addslotsrange") && tokens.size() > 2 && tokens.size() % 2 == 0) {
+        for (size_t i = 2; i < tokens.size(); i += 2) {
+            int start, end;
+            if (!parseSlot(tokens[i], start) || !parseSlot(tokens[i + 1], end) || start > end) {
+                return reply.error("Invalid or out of range slot");
+            }
+            for (int slot = start; slot <= end; slot++) {
+                slotList.push_back(slot);
+            }
+        }
+        return cluster->addSlots(reply, slotList);
+    }
+    if ((equalsIgnoreCase(subcommand, "countkeysinslot") && tokens.size() == 3) ||
+        (equalsIgnoreCase(subcommand, "getkeysinslot") && tokens.size() == 4)) {
+        int slot;
+        long long count = 0;
+        if (!parseSlot(tokens[2], slot)) {
+            return reply.error("Invalid or out of range slot");
+        }
+        if (tokens.size() == 4 && (!parseInteger(tokens[3], count) || count < 0)) {
+            return reply.error("Invalid number of keys");
+        }
+        //没有按槽位的索引，遍历整个键空间
+        std::vector<std::string> keys;
+        helper()->scanKeys("0", static_cast<size_t>(-1), [slot](const std::string& key) {
+            return Cluster::keySlot(key) == slot;
+        }, keys);
+        if (tokens.size() == 3) {
+            return reply.integer(keys.size());
+        }
+        keys.resize(std::min<size_t>(keys.size(), count));
+        reply.arrayHeader(keys.size());
+        for (auto& key : keys) {
+            reply.bulk(key);
+        }
+        return;
+    }
+    if (equalsIgnoreCase(subcommand, "setslot") && (tokens.size() == 4 || tokens.size() == 6)) {
+        int slot, port = 0;
+        if (!parseSlot(tokens[2], slot)) {
+            return reply.error("Invalid or out of range slot");
+        }
+        if (tokens.size() == 6 && (!parseInteger(tokens[5], port) || port <= 0 || port > 65535)) {
+            return reply.error("Invalid node port");
+        }
+        if ((tokens.size() == 4) != equalsIgnoreCase(tokens[3], "stable")) {
+            return reply.error("Invalid CLUSTER SETSLOT action or number of arguments");
+        }
+        return cluster->setSlot(reply, slot, tokens[3], tokens.size() == 6 ? tokens[4] : "", port);
+    }
+    return reply.error("Unknown subcommand or wrong number of arguments for '" + std::string(subcommand) + "'");
+}
+
+// 迁移命令修改数据（删除迁走的键），副本上不能执行；解析目标节点的地址
+static bool parseMigrateTarget(ArgSpan tokens, int& port, ReplyBuilder& reply) {
+    if (Replication::getInstance()->isReplica()) {
+        reply.error("READONLY", "You can't write against a read only replica.");
+        return false;
+    }
+    if (!parseInteger(tokens[2], port) || port <= 0 || port > 65535) {
+        reply.error("Invalid target port");
+        return false;
+    }
+    return true;
+}
+
+// 解析MIGRATERANGE/MIGRATESLOT的 [COUNT count] [REPLACE]
+static std::string parseMigrateOptions(ArgSpan tokens, size_t pos, size_t& count, bool& replace) {
+    for (; pos < tokens.size(); pos++) {
+        if (equalsIgnoreCase(tokens[pos], "replace")) {
+            replace = true;
+        } else if (equalsIgnoreCase(tokens[pos], "count") && pos + 1 < tokens.size()) {
+            long long value = 0;
+            if (!parseInteger(tokens[++pos], value)) {
+                return std::string(tokens[pos]) + " is not a integer type";
+            }
+            if (value < 1) {
+                return "syntax error";
+            }
+            count = value;
+        } else {
+            return "syntax error";
+        }
+    }
+    return "";
+}
+
+// MigrateParser
+// MIGRATE host port key|"" destination-db timeout [COPY] [REPLACE] [KEYS key [key ...]]
+void MigrateParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    int port = 0, db = 0, timeout = 0;
+    if (!parseMigrateTarget(tokens, port, reply)) {
+        return;
+    }
+    if (!parseInteger(tokens[4], db) || db < 0 || db >= DATABASE_FILE_NUMBER) {
+        return reply.error("database index out of range.");
+    }
+    if (!parseInteger(tokens[5], timeout) || timeout <= 0) {
+        return reply.error("Invalid timeout value");
+    }
+    bool copy = false, replace = false;
+    std::vector<std::string> keys;
+    for (size_t pos = 6; pos < tokens.size(); pos++) {
+        if (equalsIgnoreCase(tokens[pos], "copy")) {
+            copy = true;
+        } else if (equalsIgnoreCase(tokens[pos], "replace")) {
+            replace = true;
+        } else if (equalsIgnoreCase(tokens[pos], "keys") && pos + 1 < tokens.size()) {
+            //KEYS之后全部是键，此时key参数必须是空串
+            if (!tokens[3].empty()) {
+                return reply.error("When using MIGRATE KEYS option, the key argument must be set to the empty string");
+            }
+            keys.assign(tokens.begin() + pos + 1, tokens.end());
+            break;
+        } else {
+            return reply.error("syntax error");
+        }
+    }
+    if (keys.empty()) {
+        keys.emplace_back(tokens[3]);
+    }
+    return Migration::getInstance()->migrate(*helper(), reply, std::string(tokens[1]), port, tokens[4], timeout,
+                                             std::move(keys), copy, replace);
+}
+
+// MigrateRangeParser
+// MIGRATERANGE host port start end [COUNT count] [REPLACE]
+void MigrateRangeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    int port = 0;
+    size_t count = MIGRATE_DEFAULT_BATCH;
+    bool replace = false;
+    if (!parseMigrateTarget(tokens, port, reply)) {
+        return;
+    }
+    std::string err = parseMigrateOptions(tokens, 5, count, replace);
+    if (!err.empty()) {
+        return reply.error(err);
+    }
+    return Migration::getInstance()->migrateRange(*helper(), reply, std::string(tokens[1]), port, tokens[3], tokens[4],
+                                                  count, replace);
+}
+
+// MigrateSlotParser
+// MIGRATESLOT host port slot cursor [COUNT count] [REPLACE]
+void MigrateSlotParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    int port = 0, slot = 0;
+    size_t count = MIGRATE_DEFAULT_BATCH;
+    bool replace = false;
+    if (!parseMigrateTarget(tokens, port, reply)) {
+        return;
+    }
+    if (!parseSlot(tokens[3], slot)) {
+        return reply.error("Invalid or out of range slot");
+    }
+    std::string err = parseMigrateOptions(tokens, 5, count, replace);
+    if (!err.empty()) {
+        return reply.error(err);
+    }
+    return Migration::getInstance()->migrateSlot(*helper(), reply, std::string(tokens[1]), port, slot, tokens[4],
+                                                 count, replace);
+}
+
+// EVAL/EVALSHA的numkeys，不合法时写入错误并返回false
+static bool parseScriptKeys(ArgSpan tokens, size_t& keyCount, ReplyBuilder& reply) {
+    long long count = 0;
+    if (!parseInteger(tokens[2], count)) {
+        reply.error("value is not an integer or out of range");
+        return false;
+    }
+    if (count < 0) {
+        reply.error("Number of keys can't be negative");
+        return false;
+    }
+    if (static_cast<size_t>(count) > tokens.size() - 3) {
+        reply.error("Number of keys can't be greater than number of args");
+        return false;
+    }
+    keyCount = static_cast<size_t>(count);
+    return true;
+}
+
+// EvalParser
+// EVAL script numkeys [key ...] [arg ...]
+void EvalParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    size_t keyCount = 0;
+    if (!parseScriptKeys(tokens, keyCount, reply)) {
+        return;
+    }
+    return Scripting::getInstance()->eval(reply, tokens[1], tokens.subspan(3, keyCount), tokens.subspan(3 + keyCount));
+}
+
+// EvalShaParser
+// EVALSHA sha1 numkeys [key ...] [arg ...]
+void EvalShaParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    size_t keyCount = 0;
+    if (!parseScriptKeys(tokens, keyCount, reply)) {
+        return;
+    }
+    return Scripting::getInstance()->evalSha(reply, tokens[1], tokens.subspan(3, keyCount), tokens.subspan(3 + keyCount));
+}
+
+// ScriptParser
+// SCRIPT LOAD script | EXISTS sha1 [sha1 ...] | FLUSH [ASYNC|SYNC] | KILL
+void ScriptParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    Scripting* scripting = Scripting::getInstance();
+    std::string_view subcommand = tokens[1];
+    if (equalsIgnoreCase(subcommand, "load") && tokens.size() == 3) {
+        return scripting->scriptLoad(reply, tokens[2]);
+    }
+    if (equalsIgnoreCase(subcommand, "exists") && tokens.size() > 2) {
+        return scripting->scriptExists(reply, tokens.subspan(2));
+    }
+    if (equalsIgnoreCase(subcommand, "flush") &&
+        (tokens.size() == 2 || (tokens.size() == 3 && (equalsIgnoreCase(tokens[2], "async") || equalsIgnoreCase(tokens[2], "sync"))))) {
+        return scripting->scriptFlush(reply);
+    }
+    if (equalsIgnoreCase(subcommand, "kill") && tokens.size() == 2) {
+        //脚本在命令锁内执行，这条命令能执行时一定没有正在运行的脚本；死循环的脚本由指令数上限中止
+        return reply.error("NOTBUSY", "No scripts in execution right now.");
+    }
+    return reply.error("Unknown subcommand or wrong number of arguments for '" + std::string(subcommand) + "'");
+}
+
+// PublishParser
+// PUBLISH channel message
+void PublishParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return PubSub::getInstance()->publish(reply, tokens[1], tokens[2]);
+}
+
+// 订阅相关的命令由RedisServer::servePubSub在命令锁外调用，只访问PubSub自己加锁的状态
+// SUBSCRIBE channel [channel ...]
+void SubscribeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return PubSub::getInstance()->subscribeChannels(reply, tokens.subspan(1));
+}
+// PSUBSCRIBE pattern [pattern ...]
+void PSubscribeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return PubSub::getInstance()->subscribePatterns(reply, tokens.subspan(1));
+}
+// UNSUBSCRIBE id [channel ...]
+void UnsubscribeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return PubSub::getInstance()->unsubscribeChannels(reply, tokens[1], tokens.subspan(2));
+}
+// PUNSUBSCRIBE id [pattern ...]
+void PUnsubscribeParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return PubSub::getInstance()->unsubscribePatterns(reply, tokens[1], tokens.subspan(2));
+}
+// LISTEN id
+void ListenParser::parse(ArgSpan tokens, ReplyBuilder& reply) {
+    return PubSub::getInstance()->listen(reply, tokens[1]);
 }
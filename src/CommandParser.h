@@ -9,190 +9,429 @@
 
 /*
     CommandParser 是解析器的基类，它定义了解析器的接口
+    tokens[0]是命令名，其余是参数，全部指向连接的输入缓冲区，解析器不应保存它们
+    参数个数在分发前已经按命令表（CommandTable）的arity检查过，解析器只需检查arity表达不了的规则
 */
 class CommandParser {
 protected:
     static std::shared_ptr<RedisHelper> redisHelper; //静态成员变量，所有解析器共享一个RedisHelper 
+    static thread_local RedisHelper* boundHelper; //当前线程绑定的RedisHelper，为空时使用redisHelper
+    static RedisHelper* helper() { return boundHelper != nullptr ? boundHelper : redisHelper.get(); }
 public:
     static void setRedisHelper(std::shared_ptr<RedisHelper> helper) { redisHelper = helper; }
     static std::shared_ptr<RedisHelper> getRedisHelper() { return redisHelper; }  //饿汉模式
-    virtual std::string parse(std::vector<std::string>& tokens) = 0; //纯虚函数，解析命令
+    // 让当前线程的解析器在helper上执行命令（副本读视图的某一份数据），传nullptr恢复为共享的redisHelper
+    static void bindHelper(RedisHelper* helper) { boundHelper = helper; }
+    virtual void parse(ArgSpan tokens, ReplyBuilder& reply) = 0; //纯虚函数，解析命令并把回复写入reply
 };
 
 // SelectParser 
 class SelectParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // SetParser 
 class SetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // SetnxParser 
 class SetnxParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // SetexParser 
 class SetexParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // GetParser 
 class GetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // KeysParser 
 class KeysParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // DBSizeParser 
 class DBSizeParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // ExistsParser 
 class ExistsParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // DelParser 
 class DelParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // RenameParser 
 class RenameParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // IncrParser 
 class IncrParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // IncrbyParser 
 class IncrbyParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // IncrbyfloatParser 
 class IncrbyfloatParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // DecrParser 
 class DecrParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // DecrbyParser 
 class DecrbyParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // MSetParser 
 class MSetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // MGetParser 
 class MGetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // StrlenParser 
 class StrlenParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // AppendParser 
 class AppendParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // LPushParser
 class LPushParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // RPushParser
 class RPushParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // LPopParser
 class LPopParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // RPopParser
 class RPopParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// BLPopParser
+class BLPopParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// BRPopParser
+class BRPopParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// BLMoveParser
+class BLMoveParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 //LRangeParser
 class LRangeParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // HSetParser
 class HSetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // HGetParser
 class HGetParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // HDelParser
 class HDelParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // HKeysParser
 class HKeysParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
 // HValsParser
 class HValsParser : public CommandParser {
 public:
-    std::string parse(std::vector<std::string>& tokens) override;
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// SetBitParser
+class SetBitParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// GetBitParser
+class GetBitParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// BitCountParser
+class BitCountParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// BitPosParser
+class BitPosParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// BitOpParser
+class BitOpParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// PFAddParser
+class PFAddParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// PFCountParser
+class PFCountParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// PFMergeParser
+class PFMergeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// XAddParser
+class XAddParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// XRangeParser
+class XRangeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// XReadParser
+class XReadParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// XLenParser
+class XLenParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// XTrimParser
+class XTrimParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// ScanParser
+class ScanParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// HScanParser
+class HScanParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// KRangeParser
+class KRangeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// KRevRangeParser
+class KRevRangeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// KCountParser
+class KCountParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// DumpParser
+class DumpParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// RestoreParser
+class RestoreParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// CommandInfoParser：COMMAND [COUNT | INFO name ... | GETKEYS command arg ...]
+class CommandInfoParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// ReplicaOfParser
+class ReplicaOfParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// RoleParser
+class RoleParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// ClusterParser
+class ClusterParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// MigrateParser
+class MigrateParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// MigrateRangeParser
+class MigrateRangeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
 };
 
+// MigrateSlotParser
+class MigrateSlotParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// EvalParser
+class EvalParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// EvalShaParser
+class EvalShaParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// ScriptParser
+class ScriptParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// PublishParser
+class PublishParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// SubscribeParser
+class SubscribeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// PSubscribeParser
+class PSubscribeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// UnsubscribeParser
+class UnsubscribeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// PUnsubscribeParser
+class PUnsubscribeParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
+
+// ListenParser
+class ListenParser : public CommandParser {
+public:
+    void parse(ArgSpan tokens, ReplyBuilder& reply) override;
+};
 
 
 
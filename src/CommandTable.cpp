@@ -0,0 +1,223 @@
+#include "CommandTable.h"
+#include "CommandParser.h"
+#include <cctype>
+#include <cstdint>
+#include <strings.h>
+
+// 每种解析器只有一个实例，所有连接共享（解析器本身没有状态）
+template <typename Parser>
+Parser flyweight;
+
+template <typename Parser>
+constexpr CommandParser* parserOf() {
+    return &flyweight<Parser>;
+}
+
+// 命令名必须是小写且互不相同
+static constexpr CommandDescriptor commandTable[] = {
+    //name           command      parser                        arity  flags                              first last step
+    {"set",          SET,         parserOf<SetParser>(),         -3,   CMD_WRITE,                          1,   1,   1},
+    {"setnx",        SETNX,       parserOf<SetnxParser>(),        3,   CMD_WRITE,                          1,   1,   1},
+    {"setex",        SETEX,       parserOf<SetexParser>(),        3,   CMD_WRITE,                          1,   1,   1},
+    {"get",          GET,         parserOf<GetParser>(),          2,   CMD_READONLY,                       1,   1,   1},
+    {"select",       SELECT,      parserOf<SelectParser>(),       2,   CMD_NO_SCRIPT,                      0,   0,   0},
+    {"dbsize",       DBSIZE,      parserOf<DBSizeParser>(),       1,   CMD_READONLY,                       0,   0,   0},
+    {"exists",       EXISTS,      parserOf<ExistsParser>(),      -2,   CMD_READONLY,                       1,  -1,   1},
+    {"del",          DEL,         parserOf<DelParser>(),         -2,   CMD_WRITE,                          1,  -1,   1},
+    {"rename",       RENAME,      parserOf<RenameParser>(),       3,   CMD_WRITE,                          1,   2,   1},
+    {"incr",         INCR,        parserOf<IncrParser>(),         2,   CMD_WRITE,                          1,   1,   1},
+    {"incrby",       INCRBY,      parserOf<IncrbyParser>(),       3,   CMD_WRITE,                          1,   1,   1},
+    {"incrbyfloat",  INCRBYFLOAT, parserOf<IncrbyfloatParser>(),  3,   CMD_WRITE,                          1,   1,   1},
+    {"decr",         DECR,        parserOf<DecrParser>(),         2,   CMD_WRITE,                          1,   1,   1},
+    {"decrby",       DECRBY,      parserOf<DecrbyParser>(),       3,   CMD_WRITE,                          1,   1,   1},
+    {"mset",         MSET,        parserOf<MSetParser>(),        -3,   CMD_WRITE,                          1,  -1,   2},
+    {"mget",         MGET,        parserOf<MGetParser>(),        -2,   CMD_READONLY,                       1,  -1,   1},
+    {"strlen",       STRLEN,      parserOf<StrlenParser>(),       2,   CMD_READONLY,                       1,   1,   1},
+    {"append",       APPEND,      parserOf<AppendParser>(),       3,   CMD_WRITE,                          1,   1,   1},
+    {"keys",         KEYS,        parserOf<KeysParser>(),        -1,   CMD_READONLY,                       0,   0,   0},
+    {"lpush",        LPUSH,       parserOf<LPushParser>(),        3,   CMD_WRITE,                          1,   1,   1},
+    {"rpush",        RPUSH,       parserOf<RPushParser>(),        3,   CMD_WRITE,                          1,   1,   1},
+    {"lpop",         LPOP,        parserOf<LPopParser>(),         2,   CMD_WRITE,                          1,   1,   1},
+    {"rpop",         RPOP,        parserOf<RPopParser>(),         2,   CMD_WRITE,                          1,   1,   1},
+    {"lrange",       LRANGE,      parserOf<LRangeParser>(),       4,   CMD_READONLY,                       1,   1,   1},
+    {"blpop",        BLPOP,       parserOf<BLPopParser>(),       -3,   CMD_WRITE | CMD_BLOCKING,           1,  -2,   1},
+    {"brpop",        BRPOP,       parserOf<BRPopParser>(),       -3,   CMD_WRITE | CMD_BLOCKING,           1,  -2,   1},
+    {"blmove",       BLMOVE,      parserOf<BLMoveParser>(),       6,   CMD_WRITE | CMD_BLOCKING,           1,   2,   1},
+    {"bpoll",        BPOLL,       nullptr,                        2,   CMD_NO_QUEUE | CMD_NO_SCRIPT,       0,   0,   0},
+    {"hset",         HSET,        parserOf<HSetParser>(),        -4,   CMD_WRITE,                          1,   1,   1},
+    {"hget",         HGET,        parserOf<HGetParser>(),         3,   CMD_READONLY,                       1,   1,   1},
+    {"hdel",         HDEL,        parserOf<HDelParser>(),        -3,   CMD_WRITE,                          1,   1,   1},
+    {"hkeys",        HKEYS,       parserOf<HKeysParser>(),        2,   CMD_READONLY,                       1,   1,   1},
+    {"hvals",        HVALS,       parserOf<HValsParser>(),        2,   CMD_READONLY,                       1,   1,   1},
+    {"setbit",       SETBIT,      parserOf<SetBitParser>(),       4,   CMD_WRITE,                          1,   1,   1},
+    {"getbit",       GETBIT,      parserOf<GetBitParser>(),       3,   CMD_READONLY,                       1,   1,   1},
+    {"bitcount",     BITCOUNT,    parserOf<BitCountParser>(),    -2,   CMD_READONLY,                       1,   1,   1},
+    {"bitpos",       BITPOS,      parserOf<BitPosParser>(),      -3,   CMD_READONLY,                       1,   1,   1},
+    {"bitop",        BITOP,       parserOf<BitOpParser>(),       -4,   CMD_WRITE,                          2,  -1,   1},
+    {"pfadd",        PFADD,       parserOf<PFAddParser>(),       -2,   CMD_WRITE,                          1,   1,   1},
+    {"pfcount",      PFCOUNT,     parserOf<PFCountParser>(),     -2,   CMD_READONLY,                       1,  -1,   1},
+    {"pfmerge",      PFMERGE,     parserOf<PFMergeParser>(),     -3,   CMD_WRITE,                          1,  -1,   1},
+    {"xadd",         XADD,        parserOf<XAddParser>(),        -5,   CMD_WRITE,                          1,   1,   1},
+    {"xrange",       XRANGE,      parserOf<XRangeParser>(),      -4,   CMD_READONLY,                       1,   1,   1},
+    {"xread",        XREAD,       parserOf<XReadParser>(),       -4,   CMD_READONLY | CMD_MOVABLE_KEYS,    0,   0,   0},
+    {"xlen",         XLEN,        parserOf<XLenParser>(),         2,   CMD_READONLY,                       1,   1,   1},
+    {"xtrim",        XTRIM,       parserOf<XTrimParser>(),       -4,   CMD_WRITE,                          1,   1,   1},
+    {"scan",         SCAN,        parserOf<ScanParser>(),        -2,   CMD_READONLY,                       0,   0,   0},
+    {"hscan",        HSCAN,       parserOf<HScanParser>(),       -3,   CMD_READONLY,                       1,   1,   1},
+    {"krange",       KRANGE,      parserOf<KRangeParser>(),      -3,   CMD_READONLY,                       0,   0,   0},
+    {"krevrange",    KREVRANGE,   parserOf<KRevRangeParser>(),   -3,   CMD_READONLY,                       0,   0,   0},
+    {"kcount",       KCOUNT,      parserOf<KCountParser>(),       3,   CMD_READONLY,                       0,   0,   0},
+    {"dump",         DUMP,        parserOf<DumpParser>(),         2,   CMD_READONLY,                       1,   1,   1},
+    {"restore",      RESTORE,     parserOf<RestoreParser>(),     -4,   CMD_WRITE,                          1,   1,   1},
+    {"command",      COMMAND,     parserOf<CommandInfoParser>(), -1,   0,                                  0,   0,   0},
+    {"replicaof",    REPLICAOF,   parserOf<ReplicaOfParser>(),    3,   CMD_NO_SCRIPT,                      0,   0,   0},
+    {"role",         ROLE,        parserOf<RoleParser>(),         1,   0,                                  0,   0,   0},
+    {"cluster",      CLUSTER,     parserOf<ClusterParser>(),     -2,   CMD_NO_SCRIPT,                      0,   0,   0},
+    {"asking",       ASKING,      nullptr,                        1,   CMD_NO_QUEUE,                       0,   0,   0},
+    {"migrate",      MIGRATE,     parserOf<MigrateParser>(),     -6,   CMD_WRITE | CMD_SELF_REPLICATED | CMD_NO_SCRIPT, 0, 0, 0},
+    {"migraterange", MIGRATERANGE, parserOf<MigrateRangeParser>(), -5, CMD_WRITE | CMD_SELF_REPLICATED | CMD_NO_SCRIPT, 0, 0, 0},
+    {"migrateslot",  MIGRATESLOT, parserOf<MigrateSlotParser>(), -5,   CMD_WRITE | CMD_SELF_REPLICATED | CMD_NO_SCRIPT, 0, 0, 0},
+    {"eval",         EVAL,        parserOf<EvalParser>(),        -3,   CMD_MOVABLE_KEYS | CMD_NO_SCRIPT,   0,   0,   0},
+    {"evalsha",      EVALSHA,     parserOf<EvalShaParser>(),     -3,   CMD_MOVABLE_KEYS | CMD_NO_SCRIPT,   0,   0,   0},
+    {"script",       SCRIPT,      parserOf<ScriptParser>(),      -2,   CMD_NO_SCRIPT,                      0,   0,   0},
+    {"publish",      PUBLISH,     parserOf<PublishParser>(),      3,   CMD_MAY_REPLICATE,                  0,   0,   0},
+    {"subscribe",    SUBSCRIBE,   parserOf<SubscribeParser>(),   -2,   CMD_PUBSUB | CMD_NO_SCRIPT,         0,   0,   0},
+    {"psubscribe",   PSUBSCRIBE,  parserOf<PSubscribeParser>(),  -2,   CMD_PUBSUB | CMD_NO_SCRIPT,         0,   0,   0},
+    {"unsubscribe",  UNSUBSCRIBE, parserOf<UnsubscribeParser>(), -2,   CMD_PUBSUB | CMD_NO_SCRIPT,         0,   0,   0},
+    {"punsubscribe", PUNSUBSCRIBE, parserOf<PUnsubscribeParser>(), -2, CMD_PUBSUB | CMD_NO_SCRIPT,         0,   0,   0},
+    {"listen",       LISTEN,      parserOf<ListenParser>(),       2,   CMD_PUBSUB | CMD_NO_SCRIPT,         0,   0,   0},
+    {"watch",        WATCH,       nullptr,                       -2,   CMD_NO_QUEUE,                       1,  -1,   1},
+    {"unwatch",      UNWATCH,     nullptr,                       -1,   CMD_NO_QUEUE,                       0,   0,   0},
+    {"multi",        MULTI,       nullptr,                        1,   CMD_NO_QUEUE,                       0,   0,   0},
+    {"exec",         EXEC,        nullptr,                       -1,   CMD_NO_QUEUE,                       0,   0,   0},
+    {"discard",      DISCARD,     nullptr,                       -1,   CMD_NO_QUEUE,                       0,   0,   0},
+    {"quit",         QUIT,        nullptr,                       -1,   CMD_NO_QUEUE,                       0,   0,   0},
+    {"exit",         QUIT,        nullptr,                       -1,   CMD_NO_QUEUE,                       0,   0,   0},
+};
+
+static constexpr size_t COMMAND_COUNT = sizeof(commandTable) / sizeof(commandTable[0]);
+
+#define COMMAND_HASH_BITS 10
+#define COMMAND_HASH_SLOTS (1 << COMMAND_HASH_BITS)
+#define COMMAND_EMPTY_SLOT 0xff
+static_assert(COMMAND_COUNT < COMMAND_EMPTY_SLOT, "command index must fit in a slot byte");
+
+constexpr char lowerChar(char ch) {
+    return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+// 对小写化后的名字做FNV-1a哈希，seed参与初始值
+constexpr uint32_t hashName(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (char ch : name) {
+        hash ^= static_cast<uint8_t>(lowerChar(ch));
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+struct PerfectHash{
+    uint32_t seed;
+    uint8_t slots[COMMAND_HASH_SLOTS];
+};
+
+// 从1开始逐个尝试种子，直到所有命令名落在不同的槽位；槽位数远大于命令数，通常几十次以内就能找到
+constexpr PerfectHash buildPerfectHash() {
+    PerfectHash table{};
+    for (uint32_t seed = 1;; seed++) {
+        for (auto& slot : table.slots) {
+            slot = COMMAND_EMPTY_SLOT;
+        }
+        bool collision = false;
+        for (size_t i = 0; i < COMMAND_COUNT && !collision; i++) {
+            uint8_t& slot = table.slots[hashName(commandTable[i].name, seed) & (COMMAND_HASH_SLOTS - 1)];
+            collision = slot != COMMAND_EMPTY_SLOT;
+            slot = static_cast<uint8_t>(i);
+        }
+        if (!collision) {
+            table.seed = seed;
+            return table;
+        }
+    }
+}
+
+static constexpr PerfectHash perfectHash = buildPerfectHash();
+
+const CommandDescriptor* CommandTable::lookup(std::string_view name) {
+    uint8_t index = perfectHash.slots[hashName(name, perfectHash.seed) & (COMMAND_HASH_SLOTS - 1)];
+    if (index == COMMAND_EMPTY_SLOT) {
+        return nullptr;
+    }
+    const CommandDescriptor& command = commandTable[index];
+    if (command.name.size() != name.size() || strncasecmp(command.name.data(), name.data(), name.size()) != 0) {
+        return nullptr;
+    }
+    return &command;
+}
+
+const CommandDescriptor* CommandTable::begin() {
+    return commandTable;
+}
+
+const CommandDescriptor* CommandTable::end() {
+    return commandTable + COMMAND_COUNT;
+}
+
+size_t CommandTable::size() {
+    return COMMAND_COUNT;
+}
+
+bool CommandTable::checkArity(const CommandDescriptor& command, size_t argc) {
+    if (command.arity >= 0) {
+        return argc == static_cast<size_t>(command.arity);
+    }
+    return argc >= static_cast<size_t>(-command.arity);
+}
+
+std::string CommandTable::arityError(const CommandDescriptor& command) {
+    std::string name(command.name);
+    for (auto& ch : name) {
+        ch = toupper(ch);
+    }
+    return "wrong number of arguments for " + name + ".";
+}
+
+void CommandTable::getKeyPositions(const CommandDescriptor& command, ArgSpan args, std::vector<size_t>& positions) {
+    positions.clear();
+    if (command.flags & CMD_MOVABLE_KEYS) {
+        switch (command.command) {
+            case XREAD: { // XREAD [COUNT n] STREAMS key [key ...] id [id ...]
+                for (size_t i = 1; i < args.size(); i++) {
+                    if (args[i].size() == 7 && strncasecmp(args[i].data(), "streams", 7) == 0) {
+                        size_t keyCount = (args.size() - i - 1) / 2;
+                        for (size_t k = 0; k < keyCount; k++) {
+                            positions.push_back(i + 1 + k);
+                        }
+                        break;
+                    }
+                }
+                break;
+            }
+            case EVAL:
+            case EVALSHA: { // EVAL script numkeys [key ...] [arg ...]
+                size_t keyCount = 0;
+                if (args.size() >= 3 && parseInteger(args[2], keyCount) && keyCount <= args.size() - 3) {
+                    for (size_t k = 0; k < keyCount; k++) {
+                        positions.push_back(3 + k);
+                    }
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        return;
+    }
+    if (command.firstKey == 0) {
+        return;
+    }
+    long long last = command.lastKey < 0 ? static_cast<long long>(args.size()) + command.lastKey : command.lastKey;
+    for (long long i = command.firstKey; i <= last && i < static_cast<long long>(args.size()); i += command.keyStep) {
+        positions.push_back(i);
+    }
+}
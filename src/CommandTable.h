@@ -0,0 +1,64 @@
+#ifndef COMMANDTABLE_H
+#define COMMANDTABLE_H
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "global.h"
+#include "CommandArgs.h"
+
+class CommandParser;
+
+//命令标志
+enum COMMAND_FLAG{
+    CMD_WRITE = 1 << 0,         //会修改数据
+    CMD_READONLY = 1 << 1,      //只读取数据
+    CMD_MOVABLE_KEYS = 1 << 2,  //键的位置取决于参数（如XREAD），不能只靠firstKey/lastKey/keyStep确定
+    CMD_NO_QUEUE = 1 << 3,      //由服务器直接处理，不进入事务队列（MULTI/EXEC/DISCARD/QUIT）
+    CMD_NO_SCRIPT = 1 << 4,     //不能在脚本中通过redis.call调用（SELECT、EVAL、集群和迁移等）
+    CMD_BLOCKING = 1 << 5,      //没有数据时客户端阻塞等待（BLPOP等），在事务和脚本中不阻塞，直接返回空
+    CMD_PUBSUB = 1 << 6,        //订阅相关命令，只访问订阅状态，不进入命令锁也不能在事务中执行（见PubSub.h）
+    CMD_SELF_REPLICATED = 1 << 7, //写命令自己把实际的修改写入复制流（迁移后删除键），服务器不复制命令原文
+    CMD_MAY_REPLICATE = 1 << 8    //不修改数据，但执行成功后写入复制流（PUBLISH，副本上的订阅者也要收到），副本上也可以执行
+};
+
+/*
+    命令描述符
+    name为小写命令名；parser是该命令共享的解析器（享元），由服务器自己处理的命令为nullptr。
+    arity包含命令名本身：正数表示参数个数必须相等，负数表示至少-arity个。
+    firstKey/lastKey/keyStep是键在参数中的位置，lastKey为负数时从末尾倒数，没有键时都为0。
+*/
+struct CommandDescriptor{
+    std::string_view name;
+    Command command;
+    CommandParser* parser;
+    int arity;
+    int flags;
+    int firstKey;
+    int lastKey;
+    int keyStep;
+};
+
+/*
+    CommandTable 静态命令表
+    命令名到描述符的映射是编译期生成的完美哈希：对小写命令名做FNV-1a哈希，
+    编译期搜索一个让所有命令落在不同槽位的种子，查找时只需计算一次哈希、
+    读一次槽位并比较一次名字，不区分大小写，也不需要构造std::string。
+*/
+class CommandTable{
+public:
+    // 查找命令，不存在时返回nullptr
+    static const CommandDescriptor* lookup(std::string_view name);
+    static const CommandDescriptor* begin();
+    static const CommandDescriptor* end();
+    static size_t size();
+
+    // 检查参数个数（包含命令名）是否符合arity
+    static bool checkArity(const CommandDescriptor& command, size_t argc);
+    // 参数个数不符合时返回给客户端的错误信息
+    static std::string arityError(const CommandDescriptor& command);
+    // 计算args中键所在的下标，分片、复制等模块据此找到命令涉及的键，不需要了解每条命令的语法
+    static void getKeyPositions(const CommandDescriptor& command, ArgSpan args, std::vector<size_t>& positions);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef CRC16_H
+#define CRC16_H
+#include <cstddef>
+#include <cstdint>
+
+/*
+    CRC16（XMODEM，多项式0x1021，初值0），用于计算键所属的集群槽位
+    与Redis集群使用的算法相同，同一个键在两边落在同一个槽位。
+*/
+struct Crc16Table {
+    uint16_t entry[256];
+};
+constexpr Crc16Table buildCrc16Table() {
+    Crc16Table table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint16_t crc = static_cast<uint16_t>(i << 8);
+        for (int k = 0; k < 8; k++) {
+            crc = static_cast<uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+        }
+        table.entry[i] = crc;
+    }
+    return table;
+}
+static constexpr Crc16Table crc16Table = buildCrc16Table();
+
+class Crc16 {
+public:
+    static uint16_t value(const char* data, size_t size) {
+        uint16_t crc = 0;
+        for (size_t pos = 0; pos < size; pos++) {
+            crc = static_cast<uint16_t>((crc << 8) ^ crc16Table.entry[((crc >> 8) ^ static_cast<uint8_t>(data[pos])) & 0xff]);
+        }
+        return crc;
+    }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+/*
+    CRC32C（Castagnoli多项式），用于校验快照的数据块
+    支持SSE4.2时用crc32指令每次处理8字节，否则退回查表的逐字节实现。
+    两种实现结果相同，保存和加载的机器指令集不同也能互相校验。
+*/
+struct Crc32cTable {
+    uint32_t entry[256];
+};
+constexpr Crc32cTable buildCrc32cTable() {
+    Crc32cTable table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (crc & 1 ? 0x82F63B78u : 0); //反射形式的多项式0x1EDC6F41
+        }
+        table.entry[i] = crc;
+    }
+    return table;
+}
+static constexpr Crc32cTable crc32cTable = buildCrc32cTable();
+
+class Crc32c {
+public:
+    // 在crc的基础上继续计算data，初始crc为0；分段计算的结果与一次计算整段相同
+    static uint32_t extend(uint32_t crc, const char* data, size_t size) {
+#ifdef __SSE4_2__
+        uint64_t value = ~crc;
+        size_t pos = 0;
+        for (; pos + 8 <= size; pos += 8) {
+            uint64_t chunk;
+            memcpy(&chunk, data + pos, sizeof(chunk));
+            value = _mm_crc32_u64(value, chunk);
+        }
+        uint32_t state = static_cast<uint32_t>(value);
+        for (; pos < size; pos++) {
+            state = _mm_crc32_u8(state, static_cast<uint8_t>(data[pos]));
+        }
+        return ~state;
+#else
+        return extendSoftware(crc, data, size);
+#endif
+    }
+
+    // 查表实现，没有SSE4.2时使用，也用于基准测试对比
+    static uint32_t extendSoftware(uint32_t crc, const char* data, size_t size) {
+        uint32_t state = ~crc;
+        for (size_t pos = 0; pos < size; pos++) {
+            state = crc32cTable.entry[(state ^ static_cast<uint8_t>(data[pos])) & 0xff] ^ (state >> 8);
+        }
+        return ~state;
+    }
+
+    static uint32_t value(const char* data, size_t size) {
+        return extend(0, data, size);
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef GLOBPATTERN_H
+#define GLOBPATTERN_H
+#include <bitset>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    编译后的glob模式，语法与Redis的KEYS/SCAN MATCH一致：
+    * 匹配任意长度的字符，? 匹配单个字符，[abc] [^a] [a-z] 匹配字符集合，\ 转义下一个字符
+    模式在每次命令中只编译一次，匹配时用"回退到上一个*"的方式线性推进，不会出现指数级回溯。
+    literalPrefix()是模式开头不含通配符的部分，有序键空间可以直接定位到该前缀的范围。
+*/
+class GlobPattern {
+private:
+    enum OpType{
+        LITERAL, ANY, STAR, SET
+    };
+    struct Op{
+        OpType type;
+        char ch;       //LITERAL时的字符
+        size_t set;    //SET时在charSets中的下标
+    };
+    std::vector<Op> ops;
+    std::vector<std::bitset<256>> charSets;
+    std::string prefix;        //开头的字面量前缀
+    bool matchAll = false;     //模式只包含*
+    bool literal = true;       //模式不含任何通配符
+
+    bool opMatches(const Op& op, char ch) const {
+        switch (op.type) {
+            case LITERAL: return op.ch == ch;
+            case ANY: return true;
+            case SET: return charSets[op.set].test(static_cast<unsigned char>(ch));
+            default: return false;
+        }
+    }
+
+    void compile(std::string_view pattern) {
+        size_t i = 0;
+        while (i < pattern.size()) {
+            char ch = pattern[i];
+            if (ch == '*') {
+                if (ops.empty() || ops.back().type != STAR) { //连续的*等价于一个
+                    ops.push_back({STAR, 0, 0});
+                }
+                i++;
+            } else if (ch == '?') {
+                ops.push_back({ANY, 0, 0});
+                i++;
+            } else if (ch == '[') {
+                i++;
+                bool negate = i < pattern.size() && pattern[i] == '^';
+                if (negate) {
+                    i++;
+                }
+                std::bitset<256> set;
+                while (i < pattern.size() && pattern[i] != ']') {
+                    if (pattern[i] == '\\' && i + 1 < pattern.size()) {
+                        set.set(static_cast<unsigned char>(pattern[i + 1]));
+                        i += 2;
+                    } else if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+                        unsigned char lo = pattern[i], hi = pattern[i + 2];
+                        if (lo > hi) {
+                            std::swap(lo, hi);
+                        }
+                        for (unsigned c = lo; c <= hi; c++) {
+                            set.set(c);
+                        }
+                        i += 3;
+                    } else {
+                        set.set(static_cast<unsigned char>(pattern[i]));
+                        i++;
+                    }
+                }
+                i++; //跳过']'，缺少']'时集合到模式末尾结束
+                if (negate) {
+                    set.flip();
+                }
+                charSets.push_back(set);
+                ops.push_back({SET, 0, charSets.size() - 1});
+            } else {
+                if (ch == '\\' && i + 1 < pattern.size()) {
+                    i++;
+                }
+                ops.push_back({LITERAL, pattern[i], 0});
+                i++;
+            }
+        }
+        size_t k = 0;
+        for (; k < ops.size() && ops[k].type == LITERAL; k++) {
+            prefix += ops[k].ch;
+        }
+        literal = k == ops.size();
+        matchAll = ops.size() == 1 && ops[0].type == STAR;
+    }
+
+public:
+    explicit GlobPattern(std::string_view pattern) {
+        compile(pattern);
+    }
+
+    const std::string& literalPrefix() const { return prefix; }
+    bool matchesEverything() const { return matchAll; }
+
+    bool match(std::string_view text) const {
+        if (matchAll) {
+            return true;
+        }
+        if (literal) {
+            return text == prefix;
+        }
+        if (text.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        size_t p = prefix.size(), i = prefix.size();
+        size_t starOp = std::string::npos, starText = 0;
+        while (i < text.size()) {
+            if (p < ops.size() && ops[p].type == STAR) {
+                starOp = p++;
+                starText = i;
+            } else if (p < ops.size() && opMatches(ops[p], text[i])) {
+                p++;
+                i++;
+            } else if (starOp != std::string::npos) { //让上一个*多吞一个字符后重试
+                p = starOp + 1;
+                i = ++starText;
+            } else {
+                return false;
+            }
+        }
+        while (p < ops.size() && ops[p].type == STAR) {
+            p++;
+        }
+        return p == ops.size();
+    }
+
+    // 判断key是否已经越过了前缀范围（有序遍历时可以就此停止）
+    bool pastPrefix(std::string_view key) const {
+        return key.compare(0, prefix.size(), prefix) > 0;
+    }
+};
+
+#endif
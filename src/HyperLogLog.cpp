@@ -0,0 +1,472 @@
+#include "HyperLogLog.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define HLL_Q (64 - HLL_P)                  //哈希值中用于统计前导位的位数
+#define HLL_HASH_SEED 0xadc83b19ULL
+
+// 稀疏编码的操作码
+// ZERO  : 00xxxxxx           连续xxxxxx+1个寄存器为0（1~64）
+// XZERO : 01xxxxxx yyyyyyyy  连续xxxxxxyyyyyyyy+1个寄存器为0（1~16384）
+// VAL   : 1vvvvvxx           连续xx+1个寄存器的值为vvvvv+1（值1~32，长度1~4）
+#define HLL_SPARSE_IS_ZERO(p) (((*(p)) & 0xc0) == 0)
+#define HLL_SPARSE_IS_XZERO(p) (((*(p)) & 0xc0) == 0x40)
+#define HLL_SPARSE_ZERO_LEN(p) (((*(p)) & 0x3f) + 1)
+#define HLL_SPARSE_XZERO_LEN(p) (((((*(p)) & 0x3f) << 8) | (*((p) + 1))) + 1)
+#define HLL_SPARSE_VAL_VALUE(p) ((((*(p)) >> 2) & 0x1f) + 1)
+#define HLL_SPARSE_VAL_LEN(p) (((*(p)) & 0x3) + 1)
+#define HLL_SPARSE_VAL_MAX_VALUE 32
+#define HLL_SPARSE_VAL_MAX_LEN 4
+#define HLL_SPARSE_ZERO_MAX_LEN 64
+#define HLL_SPARSE_XZERO_MAX_LEN 16384
+
+static inline const uint8_t* bytesOf(const std::string& s) {
+    return reinterpret_cast<const uint8_t*>(s.data());
+}
+static inline uint8_t* bytesOf(std::string& s) {
+    return reinterpret_cast<uint8_t*>(&s[0]);
+}
+
+// 稠密编码中每4个寄存器占3个字节，低位在前
+static inline uint8_t getDenseRegister(const uint8_t* dense, long index) {
+    const uint8_t* p = dense + (index >> 2) * 3;
+    switch (index & 3) {
+        case 0: return p[0] & 0x3f;
+        case 1: return ((p[0] >> 6) | (p[1] << 2)) & 0x3f;
+        case 2: return ((p[1] >> 4) | (p[2] << 4)) & 0x3f;
+        default: return p[2] >> 2;
+    }
+}
+static inline void setDenseRegister(uint8_t* dense, long index, uint8_t value) {
+    uint8_t* p = dense + (index >> 2) * 3;
+    switch (index & 3) {
+        case 0: p[0] = (p[0] & 0xc0) | value; break;
+        case 1: p[0] = (p[0] & 0x3f) | (value << 6); p[1] = (p[1] & 0xf0) | (value >> 2); break;
+        case 2: p[1] = (p[1] & 0x0f) | (value << 4); p[2] = (p[2] & 0xfc) | (value >> 4); break;
+        default: p[2] = (p[2] & 0x03) | (value << 2); break;
+    }
+}
+
+std::string HyperLogLog::create() {
+    std::string hll(HLL_HDR_SIZE, '\0');
+    memcpy(&hll[0], "HYLL", 4);
+    hll[4] = SPARSE;
+    // 整个寄存器区间都为0，用XZERO操作码表示
+    int len = HLL_REGISTERS - 1;
+    hll.push_back(static_cast<char>(0x40 | (len >> 8)));
+    hll.push_back(static_cast<char>(len & 0xff));
+    return hll;
+}
+
+bool HyperLogLog::isValid(const std::string& hll) {
+    if (hll.size() < HLL_HDR_SIZE || memcmp(hll.data(), "HYLL", 4) != 0) {
+        return false;
+    }
+    if (hll[4] == DENSE) {
+        return hll.size() == HLL_DENSE_SIZE;
+    }
+    if (hll[4] != SPARSE) {
+        return false;
+    }
+    const uint8_t* p = bytesOf(hll) + HLL_HDR_SIZE;
+    const uint8_t* end = bytesOf(hll) + hll.size();
+    long index = 0;
+    while (p < end) {
+        if (HLL_SPARSE_IS_ZERO(p)) {
+            index += HLL_SPARSE_ZERO_LEN(p);
+            p++;
+        } else if (HLL_SPARSE_IS_XZERO(p)) {
+            if (p + 1 >= end) {
+                return false;
+            }
+            index += HLL_SPARSE_XZERO_LEN(p);
+            p += 2;
+        } else {
+            index += HLL_SPARSE_VAL_LEN(p);
+            p++;
+        }
+        if (index > HLL_REGISTERS) {
+            return false;
+        }
+    }
+    return index == HLL_REGISTERS;
+}
+
+// MurmurHash2的64位版本，与Redis使用的哈希函数一致
+uint64_t HyperLogLog::murmurHash64A(const void* key, size_t len, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (len * m);
+    const uint8_t* data = static_cast<const uint8_t*>(key);
+    const uint8_t* end = data + (len - (len & 7));
+
+    while (data != end) {
+        uint64_t k;
+        memcpy(&k, data, sizeof k);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+        data += 8;
+    }
+    switch (len & 7) {
+        case 7: h ^= static_cast<uint64_t>(data[6]) << 48; /* fall through */
+        case 6: h ^= static_cast<uint64_t>(data[5]) << 40; /* fall through */
+        case 5: h ^= static_cast<uint64_t>(data[4]) << 32; /* fall through */
+        case 4: h ^= static_cast<uint64_t>(data[3]) << 24; /* fall through */
+        case 3: h ^= static_cast<uint64_t>(data[2]) << 16; /* fall through */
+        case 2: h ^= static_cast<uint64_t>(data[1]) << 8;  /* fall through */
+        case 1: h ^= static_cast<uint64_t>(data[0]);
+                h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+// 计算元素对应的寄存器下标，以及哈希值剩余部分中"第一个1出现的位置"
+int HyperLogLog::patternLength(const char* element, size_t len, long& index) {
+    uint64_t hash = murmurHash64A(element, len, HLL_HASH_SEED);
+    index = hash & (HLL_REGISTERS - 1);
+    hash >>= HLL_P;
+    hash |= 1ULL << HLL_Q; //保证循环一定终止
+    return __builtin_ctzll(hash) + 1;
+}
+
+void HyperLogLog::unpackDense(const uint8_t* dense, uint8_t* registers) {
+    for (long i = 0; i < HLL_REGISTERS; i += 4, dense += 3) {
+        registers[i] = dense[0] & 0x3f;
+        registers[i + 1] = ((dense[0] >> 6) | (dense[1] << 2)) & 0x3f;
+        registers[i + 2] = ((dense[1] >> 4) | (dense[2] << 4)) & 0x3f;
+        registers[i + 3] = dense[2] >> 2;
+    }
+}
+
+void HyperLogLog::packDense(const uint8_t* registers, uint8_t* dense) {
+    for (long i = 0; i < HLL_REGISTERS; i += 4, dense += 3) {
+        dense[0] = registers[i] | (registers[i + 1] << 6);
+        dense[1] = (registers[i + 1] >> 2) | (registers[i + 2] << 4);
+        dense[2] = (registers[i + 2] >> 4) | (registers[i + 3] << 2);
+    }
+}
+
+bool HyperLogLog::decodeSparse(const std::string& hll, uint8_t* registers) {
+    const uint8_t* p = bytesOf(hll) + HLL_HDR_SIZE;
+    const uint8_t* end = bytesOf(hll) + hll.size();
+    long index = 0;
+    while (p < end) {
+        long runLen;
+        uint8_t value = 0;
+        if (HLL_SPARSE_IS_ZERO(p)) {
+            runLen = HLL_SPARSE_ZERO_LEN(p);
+            p++;
+        } else if (HLL_SPARSE_IS_XZERO(p)) {
+            runLen = HLL_SPARSE_XZERO_LEN(p);
+            p += 2;
+        } else {
+            runLen = HLL_SPARSE_VAL_LEN(p);
+            value = HLL_SPARSE_VAL_VALUE(p);
+            p++;
+        }
+        if (index + runLen > HLL_REGISTERS) {
+            return false;
+        }
+        memset(registers + index, value, runLen);
+        index += runLen;
+    }
+    return index == HLL_REGISTERS;
+}
+
+bool HyperLogLog::encodeSparse(const uint8_t* registers, std::string& out) {
+    out.assign(HLL_HDR_SIZE, '\0');
+    memcpy(&out[0], "HYLL", 4);
+    out[4] = SPARSE;
+    long i = 0;
+    while (i < HLL_REGISTERS) {
+        uint8_t value = registers[i];
+        long runLen = 1;
+        while (i + runLen < HLL_REGISTERS && registers[i + runLen] == value) {
+            runLen++;
+        }
+        i += runLen;
+        if (value == 0) {
+            while (runLen > 0) {
+                long len = std::min<long>(runLen, HLL_SPARSE_XZERO_MAX_LEN);
+                if (len > HLL_SPARSE_ZERO_MAX_LEN) {
+                    out.push_back(static_cast<char>(0x40 | ((len - 1) >> 8)));
+                    out.push_back(static_cast<char>((len - 1) & 0xff));
+                } else {
+                    out.push_back(static_cast<char>(len - 1));
+                }
+                runLen -= len;
+            }
+        } else {
+            if (value > HLL_SPARSE_VAL_MAX_VALUE) {
+                return false;
+            }
+            while (runLen > 0) {
+                long len = std::min<long>(runLen, HLL_SPARSE_VAL_MAX_LEN);
+                out.push_back(static_cast<char>(0x80 | ((value - 1) << 2) | (len - 1)));
+                runLen -= len;
+            }
+        }
+        if (out.size() > HLL_HDR_SIZE + HLL_SPARSE_MAX_BYTES) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string HyperLogLog::fromRegisters(const uint8_t* registers) {
+    std::string hll;
+    if (encodeSparse(registers, hll)) {
+        invalidateCache(hll);
+        return hll;
+    }
+    hll.assign(HLL_DENSE_SIZE, '\0');
+    memcpy(&hll[0], "HYLL", 4);
+    hll[4] = DENSE;
+    packDense(registers, bytesOf(hll) + HLL_HDR_SIZE);
+    invalidateCache(hll);
+    return hll;
+}
+
+void HyperLogLog::invalidateCache(std::string& hll) {
+    hll[15] |= static_cast<char>(0x80);
+}
+
+bool HyperLogLog::add(std::string& hll, const char* element, size_t len) {
+    long index;
+    uint8_t count = patternLength(element, len, index);
+    if (hll[4] == DENSE) {
+        uint8_t* dense = bytesOf(hll) + HLL_HDR_SIZE;
+        if (getDenseRegister(dense, index) >= count) {
+            return false;
+        }
+        setDenseRegister(dense, index, count);
+        invalidateCache(hll);
+        return true;
+    }
+
+    // 稀疏编码：先沿操作码找到该寄存器所在的操作码，值没有变大时直接返回
+    const uint8_t* p = bytesOf(hll) + HLL_HDR_SIZE;
+    const uint8_t* end = bytesOf(hll) + hll.size();
+    const uint8_t* prev = nullptr; //前一个操作码，修改后从它开始合并相邻的VAL
+    long first = 0;
+    long runLen = 0;
+    uint8_t oldValue = 0;
+    size_t opLen = 1;
+    while (p < end) {
+        opLen = HLL_SPARSE_IS_XZERO(p) ? 2 : 1;
+        oldValue = 0;
+        if (HLL_SPARSE_IS_ZERO(p)) {
+            runLen = HLL_SPARSE_ZERO_LEN(p);
+        } else if (HLL_SPARSE_IS_XZERO(p)) {
+            runLen = HLL_SPARSE_XZERO_LEN(p);
+        } else {
+            runLen = HLL_SPARSE_VAL_LEN(p);
+            oldValue = HLL_SPARSE_VAL_VALUE(p);
+        }
+        if (index < first + runLen) {
+            break;
+        }
+        first += runLen;
+        prev = p;
+        p += opLen;
+    }
+    if (p >= end) {
+        return false; //isValid保证不会发生
+    }
+    if (oldValue >= count) {
+        return false;
+    }
+    if (count > HLL_SPARSE_VAL_MAX_VALUE) {
+        promoteToDense(hll, index, count);
+        return true;
+    }
+
+    // 把该寄存器所在的操作码拆成"前半段 + VAL(count,1) + 后半段"，最多5个字节，原地替换这一个操作码，
+    // 不需要解码全部寄存器（与Redis的hllSparseSet相同）
+    char seq[5];
+    size_t seqLen = 0;
+    auto appendRun = [&](uint8_t value, long len) {
+        if (len == 0) {
+            return;
+        }
+        if (value != 0) {
+            seq[seqLen++] = static_cast<char>(0x80 | ((value - 1) << 2) | (len - 1));
+        } else if (len > HLL_SPARSE_ZERO_MAX_LEN) {
+            seq[seqLen++] = static_cast<char>(0x40 | ((len - 1) >> 8));
+            seq[seqLen++] = static_cast<char>((len - 1) & 0xff);
+        } else {
+            seq[seqLen++] = static_cast<char>(len - 1);
+        }
+    };
+    long offset = index - first;
+    appendRun(oldValue, offset);
+    appendRun(count, 1);
+    appendRun(oldValue, runLen - offset - 1);
+    if (hll.size() - opLen + seqLen > HLL_HDR_SIZE + HLL_SPARSE_MAX_BYTES) {
+        promoteToDense(hll, index, count);
+        return true;
+    }
+    size_t position = p - bytesOf(hll);
+    size_t mergeFrom = prev != nullptr ? prev - bytesOf(hll) : position;
+    hll.replace(position, opLen, seq, seqLen);
+
+    // 相邻且值相同的VAL合并成一个（总长度不超过4），只检查修改位置附近的几个操作码
+    size_t pos = mergeFrom;
+    for (int scanned = 0; scanned < 5 && pos < hll.size(); scanned++) {
+        uint8_t* op = bytesOf(hll) + pos;
+        if (HLL_SPARSE_IS_XZERO(op)) {
+            pos += 2;
+            continue;
+        }
+        if (HLL_SPARSE_IS_ZERO(op) || pos + 1 >= hll.size()) {
+            pos++;
+            continue;
+        }
+        uint8_t* next = op + 1;
+        if (!HLL_SPARSE_IS_ZERO(next) && !HLL_SPARSE_IS_XZERO(next) &&
+            HLL_SPARSE_VAL_VALUE(op) == HLL_SPARSE_VAL_VALUE(next)) {
+            long merged = HLL_SPARSE_VAL_LEN(op) + HLL_SPARSE_VAL_LEN(next);
+            if (merged <= HLL_SPARSE_VAL_MAX_LEN) {
+                *op = static_cast<uint8_t>((*op & ~0x3) | (merged - 1));
+                hll.erase(pos + 1, 1);
+                continue; //合并后的操作码还可能和下一个合并
+            }
+        }
+        pos++;
+    }
+    invalidateCache(hll);
+    return true;
+}
+
+// 稀疏编码放不下时转为稠密编码，这是唯一需要解码全部寄存器的情况
+void HyperLogLog::promoteToDense(std::string& hll, long index, uint8_t count) {
+    uint8_t registers[HLL_REGISTERS];
+    decodeSparse(hll, registers);
+    registers[index] = count;
+    hll.assign(HLL_DENSE_SIZE, '\0');
+    memcpy(&hll[0], "HYLL", 4);
+    hll[4] = DENSE;
+    packDense(registers, bytesOf(hll) + HLL_HDR_SIZE);
+    invalidateCache(hll);
+}
+
+void HyperLogLog::mergeInto(uint8_t* registers, const std::string& hll) {
+    if (hll[4] == DENSE) {
+        alignas(16) uint8_t other[HLL_REGISTERS];
+        unpackDense(bytesOf(hll) + HLL_HDR_SIZE, other);
+        long i = 0;
+#ifdef __SSE2__
+        for (; i + 16 <= HLL_REGISTERS; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(registers + i));
+            __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(other + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(registers + i), _mm_max_epu8(a, b));
+        }
+#endif
+        for (; i < HLL_REGISTERS; i++) {
+            registers[i] = std::max(registers[i], other[i]);
+        }
+        return;
+    }
+    const uint8_t* p = bytesOf(hll) + HLL_HDR_SIZE;
+    const uint8_t* end = bytesOf(hll) + hll.size();
+    long index = 0;
+    while (p < end) {
+        if (HLL_SPARSE_IS_ZERO(p)) {
+            index += HLL_SPARSE_ZERO_LEN(p);
+            p++;
+        } else if (HLL_SPARSE_IS_XZERO(p)) {
+            index += HLL_SPARSE_XZERO_LEN(p);
+            p += 2;
+        } else {
+            long runLen = HLL_SPARSE_VAL_LEN(p);
+            uint8_t value = HLL_SPARSE_VAL_VALUE(p);
+            for (long i = 0; i < runLen; i++) {
+                registers[index + i] = std::max(registers[index + i], value);
+            }
+            index += runLen;
+            p++;
+        }
+    }
+}
+
+// 调和平均估计：E = alpha * m^2 / sum(2^-M[j])，基数较小时改用线性计数
+uint64_t HyperLogLog::estimateFromHistogram(const int* histogram) {
+    const double m = HLL_REGISTERS;
+    const double alpha = 0.7213 / (1 + 1.079 / m);
+    double sum = 0;
+    for (int k = HLL_Q + 1; k >= 0; k--) {
+        sum += histogram[k] * std::ldexp(1.0, -k);
+    }
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && histogram[0] != 0) {
+        estimate = m * std::log(m / histogram[0]);
+    }
+    return static_cast<uint64_t>(std::llround(estimate));
+}
+
+uint64_t HyperLogLog::estimate(const uint8_t* registers) {
+    int histogram[64] = {0};
+    for (long i = 0; i < HLL_REGISTERS; i++) {
+        histogram[registers[i]]++;
+    }
+    return estimateFromHistogram(histogram);
+}
+
+uint64_t HyperLogLog::count(std::string& hll) {
+    uint8_t* card = bytesOf(hll) + 8;
+    bool cached = (card[7] & 0x80) == 0;
+    uint64_t result = peekCount(hll);
+    if (!cached) {
+        for (int i = 0; i < 8; i++) {
+            card[i] = (result >> (8 * i)) & 0xff;
+        }
+    }
+    return result;
+}
+
+uint64_t HyperLogLog::peekCount(const std::string& hll) {
+    const uint8_t* card = bytesOf(hll) + 8;
+    if ((card[7] & 0x80) == 0) {
+        uint64_t cached = 0;
+        for (int i = 7; i >= 0; i--) {
+            cached = (cached << 8) | card[i];
+        }
+        return cached;
+    }
+    int histogram[64] = {0};
+    if (hll[4] == DENSE) {
+        const uint8_t* dense = bytesOf(hll) + HLL_HDR_SIZE;
+        for (long i = 0; i < HLL_REGISTERS; i += 4, dense += 3) {
+            histogram[dense[0] & 0x3f]++;
+            histogram[((dense[0] >> 6) | (dense[1] << 2)) & 0x3f]++;
+            histogram[((dense[1] >> 4) | (dense[2] << 4)) & 0x3f]++;
+            histogram[dense[2] >> 2]++;
+        }
+    } else {
+        const uint8_t* p = bytesOf(hll) + HLL_HDR_SIZE;
+        const uint8_t* end = bytesOf(hll) + hll.size();
+        while (p < end) {
+            if (HLL_SPARSE_IS_ZERO(p)) {
+                histogram[0] += HLL_SPARSE_ZERO_LEN(p);
+                p++;
+            } else if (HLL_SPARSE_IS_XZERO(p)) {
+                histogram[0] += HLL_SPARSE_XZERO_LEN(p);
+                p += 2;
+            } else {
+                histogram[HLL_SPARSE_VAL_VALUE(p)] += HLL_SPARSE_VAL_LEN(p);
+                p++;
+            }
+        }
+    }
+    return estimateFromHistogram(histogram);
+}
@@ -0,0 +1,65 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+#include <cstdint>
+#include <string>
+
+/*
+    HyperLogLog 基数估计
+    整个结构保存在一个字符串值中，布局与Redis相同：
+    16字节头部（"HYLL"魔数、编码方式、3字节保留、8字节缓存的基数）+ 寄存器数据。
+    稠密编码：16384个6位寄存器，共12288字节。
+    稀疏编码：用ZERO/XZERO/VAL操作码对连续的寄存器做游程编码，基数较小时只占几十字节，
+    寄存器值超过32或编码长度超过HLL_SPARSE_MAX_BYTES时自动转为稠密编码。
+*/
+#define HLL_P 14
+#define HLL_REGISTERS (1 << HLL_P)
+#define HLL_BITS 6
+#define HLL_HDR_SIZE 16
+#define HLL_DENSE_SIZE (HLL_HDR_SIZE + (HLL_REGISTERS * HLL_BITS + 7) / 8)
+#define HLL_SPARSE_MAX_BYTES 3000
+
+class HyperLogLog {
+public:
+    enum Encoding{
+        DENSE = 0, SPARSE = 1
+    };
+
+    // 创建一个空的HyperLogLog（稀疏编码）
+    static std::string create();
+
+    // 检查字符串是否是合法的HyperLogLog
+    static bool isValid(const std::string& hll);
+
+    // 添加元素，寄存器发生变化时返回true
+    static bool add(std::string& hll, const char* element, size_t len);
+
+    // 估算基数，会读取/更新头部中缓存的基数
+    static uint64_t count(std::string& hll);
+    // 估算基数，只读取缓存不写回，可以和其它读者并发执行
+    static uint64_t peekCount(const std::string& hll);
+
+    // 将hll的寄存器按最大值合并到registers（每个寄存器占一个字节，共HLL_REGISTERS字节）
+    static void mergeInto(uint8_t* registers, const std::string& hll);
+
+    // 根据寄存器数组估算基数
+    static uint64_t estimate(const uint8_t* registers);
+
+    // 由寄存器数组构造HyperLogLog，能用稀疏编码表示时优先使用稀疏编码
+    static std::string fromRegisters(const uint8_t* registers);
+
+private:
+    static uint64_t murmurHash64A(const void* key, size_t len, uint64_t seed);
+    static int patternLength(const char* element, size_t len, long& index);
+
+    static void unpackDense(const uint8_t* dense, uint8_t* registers);
+    static void packDense(const uint8_t* registers, uint8_t* dense);
+    static bool decodeSparse(const std::string& hll, uint8_t* registers);
+    static bool encodeSparse(const uint8_t* registers, std::string& out);
+    // 稀疏编码的寄存器index设为count后转为稠密编码
+    static void promoteToDense(std::string& hll, long index, uint8_t count);
+
+    static uint64_t estimateFromHistogram(const int* histogram);
+    static void invalidateCache(std::string& hll);
+};
+
+#endif
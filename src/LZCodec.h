@@ -0,0 +1,224 @@
+#ifndef LZCODEC_H
+#define LZCODEC_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/*
+    LZCodec 快照用的LZ77压缩，输出格式与LZ4的block格式相同
+    压缩结果由若干个序列组成，每个序列是：
+        token(高4位字面量长度，低4位匹配长度-4) [字面量长度扩展] 字面量 偏移(2字节小端) [匹配长度扩展]
+    长度为15时后面跟扩展字节，每个255表示继续累加。最后一个序列只有字面量，
+    最后5个字节总是字面量，最后一个匹配至少在结尾12个字节之前开始。
+    压缩用一张按4字节内容哈希的位置表找重复，找不到时步长逐渐变大，快速跳过不可压缩的数据；
+    快照中的键名前缀、JSON结构字符大量重复，结构化的记录通常能压缩到原来的1/3以下；解压基本只是内存复制，比解析记录快得多。
+*/
+class LZCodec {
+private:
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t LAST_LITERALS = 5;
+    static constexpr size_t MF_LIMIT = 12;
+    static constexpr size_t MAX_OFFSET = 65535;
+    static constexpr int HASH_LOG = 14;
+
+    static uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    static uint64_t read64(const uint8_t* p) {
+        uint64_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    static uint32_t hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_LOG);
+    }
+
+    // 长度达到15时token中记15，剩余部分写成扩展字节
+    static uint8_t* writeLength(uint8_t* op, size_t length) {
+        length -= 15;
+        while (length >= 255) {
+            *op++ = 255;
+            length -= 255;
+        }
+        *op++ = static_cast<uint8_t>(length);
+        return op;
+    }
+
+    // 写一个序列，返回新的输出位置；matchLength为0表示最后一个只有字面量的序列
+    static uint8_t* writeSequence(uint8_t* op, const uint8_t* literal, size_t literalLength,
+                                  size_t offset, size_t matchLength) {
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+        if (literalLength >= 15) {
+            op = writeLength(op, literalLength);
+        }
+        memcpy(op, literal, literalLength);
+        op += literalLength;
+        if (matchLength > 0) {
+            *op++ = static_cast<uint8_t>(offset & 0xff);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+            size_t length = matchLength - MIN_MATCH;
+            *token |= length >= 15 ? 15 : length;
+            if (length >= 15) {
+                op = writeLength(op, length);
+            }
+        }
+        return op;
+    }
+
+    // 从ip复制8字节的整数倍到op，最多多写7个字节，调用方保证两边都有足够的空间
+    static void wildCopy(uint8_t* op, const uint8_t* ip, size_t length) {
+        uint8_t* end = op + length;
+        do {
+            memcpy(op, ip, 8);
+            op += 8;
+            ip += 8;
+        } while (op < end);
+    }
+
+    // 从两个位置开始比较，返回相同字节数，不超过limit
+    static size_t matchLength(const uint8_t* a, const uint8_t* b, size_t limit) {
+        size_t length = 0;
+        while (length + 8 <= limit) {
+            uint64_t diff = read64(a + length) ^ read64(b + length);
+            if (diff != 0) {
+                return length + (__builtin_ctzll(diff) >> 3); //小端序，最低的不同字节就是第一个不同的字节
+            }
+            length += 8;
+        }
+        while (length < limit && a[length] == b[length]) {
+            length++;
+        }
+        return length;
+    }
+
+public:
+    // 压缩后的最大长度（数据完全不可压缩时）
+    static size_t maxCompressedSize(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    // 把src压缩后追加到out
+    static void compress(const char* src, size_t size, std::string& out) {
+        //位置表放在栈上（64KB），每次压缩重新清空；表中的位置只是候选，用前会比较内容
+        uint32_t table[1 << HASH_LOG] = {};
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(src);
+        size_t start = out.size();
+        out.resize(start + maxCompressedSize(size));
+        uint8_t* op = reinterpret_cast<uint8_t*>(&out[start]);
+        uint8_t* outputBegin = op;
+        size_t anchor = 0;
+        if (size > MF_LIMIT) {
+            size_t searchLimit = size - MF_LIMIT;
+            size_t matchLimit = size - LAST_LITERALS;
+            size_t pos = 0;
+            size_t misses = 0;
+            while (pos < searchLimit) {
+                uint32_t sequence = read32(base + pos);
+                uint32_t& slot = table[hash(sequence)];
+                size_t candidate = slot;
+                slot = static_cast<uint32_t>(pos);
+                if (candidate >= pos || pos - candidate > MAX_OFFSET || read32(base + candidate) != sequence) {
+                    pos += 1 + (misses++ >> 6);
+                    continue;
+                }
+                //匹配尽量向前延伸，但不越过上一个序列的结尾
+                while (pos > anchor && candidate > 0 && base[pos - 1] == base[candidate - 1]) {
+                    pos--;
+                    candidate--;
+                }
+                size_t length = MIN_MATCH + matchLength(base + pos + MIN_MATCH, base + candidate + MIN_MATCH,
+                                                        matchLimit - pos - MIN_MATCH);
+                op = writeSequence(op, base + anchor, pos - anchor, pos - candidate, length);
+                pos += length;
+                anchor = pos;
+                misses = 0;
+                //匹配结尾处的位置也登记到表里，连续的重复内容可以马上接着匹配
+                if (pos - 2 < searchLimit) {
+                    table[hash(read32(base + pos - 2))] = static_cast<uint32_t>(pos - 2);
+                }
+            }
+        }
+        op = writeSequence(op, base + anchor, size - anchor, 0, 0);
+        out.resize(start + (op - outputBegin));
+    }
+
+    // 把src解压到dst，dst正好有rawSize字节；数据损坏或长度不符时返回false
+    static bool decompress(const char* src, size_t size, char* dst, size_t rawSize) {
+        const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+        const uint8_t* inputEnd = ip + size;
+        uint8_t* op = reinterpret_cast<uint8_t*>(dst);
+        uint8_t* outputEnd = op + rawSize;
+        uint8_t* outputBegin = op;
+        while (ip < inputEnd) {
+            uint8_t token = *ip++;
+            size_t literalLength = token >> 4;
+            if (literalLength == 15) {
+                uint8_t extra;
+                do {
+                    if (ip >= inputEnd) {
+                        return false;
+                    }
+                    extra = *ip++;
+                    literalLength += extra;
+                } while (extra == 255);
+            }
+            if (literalLength > static_cast<size_t>(inputEnd - ip) || literalLength > static_cast<size_t>(outputEnd - op)) {
+                return false;
+            }
+            //离两边的结尾都足够远时按8字节整块复制，多写的字节会被后面的数据覆盖
+            if (literalLength + 8 <= static_cast<size_t>(inputEnd - ip) && literalLength + 8 <= static_cast<size_t>(outputEnd - op)) {
+                wildCopy(op, ip, literalLength);
+            } else {
+                memcpy(op, ip, literalLength);
+            }
+            op += literalLength;
+            ip += literalLength;
+            if (ip == inputEnd) {
+                break; //最后一个序列没有匹配部分
+            }
+            if (inputEnd - ip < 2) {
+                return false;
+            }
+            size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+            ip += 2;
+            if (offset == 0 || offset > static_cast<size_t>(op - outputBegin)) {
+                return false;
+            }
+            size_t length = token & 0x0f;
+            if (length == 15) {
+                uint8_t extra;
+                do {
+                    if (ip >= inputEnd) {
+                        return false;
+                    }
+                    extra = *ip++;
+                    length += extra;
+                } while (extra == 255);
+            }
+            length += MIN_MATCH;
+            if (length > static_cast<size_t>(outputEnd - op)) {
+                return false;
+            }
+            const uint8_t* match = op - offset;
+            if (offset >= 8 && length + 8 <= static_cast<size_t>(outputEnd - op)) {
+                wildCopy(op, match, length); //每次复制的8字节都已经写好，重叠也没有问题
+                op += length;
+            } else if (offset >= length) {
+                memcpy(op, match, length);
+                op += length;
+            } else {
+                //匹配和输出重叠（如重复的短模式），只能逐字节复制
+                for (size_t k = 0; k < length; k++) {
+                    *op++ = *match++;
+                }
+            }
+        }
+        return op == outputEnd;
+    }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef LEFTRIGHT_H
+#define LEFTRIGHT_H
+#include <atomic>
+#include <thread>
+
+#define LEFT_RIGHT_READER_SLOTS 64 //读者计数槽的个数，线程多于槽数时几个线程共用一个槽
+
+/*
+    LeftRight 读写分离的双份数据
+    同一份数据保存两个实例，读者只读其中一个（读端），唯一的写者修改另一个（写端）：
+        modify：先修改写端 -> 交换读写端 -> 等待还在旧读端上的读者离开 -> 再对旧读端做同样的修改
+    读者不加锁也不会被写者阻塞，只在自己线程的计数槽上加减一次计数；计数槽按缓存行对齐，
+    不同线程的读者不会争用同一个缓存行。
+    等待读者离开相当于RCU的宽限期：交换之后进入的读者都在新读端上，旧读端的计数归零后就不再有人读它。
+    代价是数据占用两倍内存，每次修改执行两遍；修改必须是确定性的，两边执行后内容相同。
+    写者之间不互斥，由调用方保证同一时间只有一个写者。
+*/
+template<typename T>
+class LeftRight {
+private:
+    struct alignas(64) ReaderSlot {
+        std::atomic<int> readers[2] = {{0}, {0}}; //在第0/1份数据上的读者数
+    };
+
+    T* instances[2] = {nullptr, nullptr};
+    std::atomic<int> readSide{-1}; //读端的下标，-1表示未启用
+    ReaderSlot slots[LEFT_RIGHT_READER_SLOTS];
+
+    ReaderSlot& currentSlot() {
+        static std::atomic<unsigned> nextSlot{0};
+        static thread_local unsigned slot = nextSlot.fetch_add(1) % LEFT_RIGHT_READER_SLOTS;
+        return slots[slot];
+    }
+
+    // 等待side上的读者全部离开
+    void waitForReaders(int side) {
+        for (auto& slot : slots) {
+            while (slot.readers[side].load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+public:
+    bool enabled() const { return readSide.load() >= 0; }
+
+    // 启用，两个实例的内容必须相同；调用时不能有写者
+    void enable(T* first, T* second) {
+        disable();
+        instances[0] = first;
+        instances[1] = second;
+        readSide.store(0);
+    }
+
+    // 停用并等待所有读者离开，返回后两个实例都可以直接使用
+    void disable() {
+        int side = readSide.exchange(-1);
+        if (side >= 0) {
+            waitForReaders(side);
+        }
+    }
+
+    // 在读端上执行func(T&)，未启用时返回false，调用方改走其它路径
+    template<typename Func>
+    bool read(Func func) {
+        ReaderSlot& slot = currentSlot();
+        while (true) {
+            int side = readSide.load();
+            if (side < 0) {
+                return false;
+            }
+            slot.readers[side].fetch_add(1);
+            //登记之后读端没有变，写者交换读端后一定会等到这次读取结束
+            if (readSide.load() == side) {
+                func(*instances[side]);
+                slot.readers[side].fetch_sub(1);
+                return true;
+            }
+            slot.readers[side].fetch_sub(1);
+        }
+    }
+
+    // 依次在两个实例上执行func(T&)，第一次执行的是交换后成为读端的实例
+    template<typename Func>
+    void modify(Func func) {
+        int front = readSide.load();
+        int back = 1 - front;
+        func(*instances[back]);
+        readSide.store(back);
+        waitForReaders(front);
+        func(*instances[front]);
+    }
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "Migration.h"
+#include "Cluster.h"
+#include "Crc32c.h"
+#include "NodeLink.h"
+#include "RedisHelper.h"
+#include "RedisServer.h"
+#include "Replication.h"
+#include "ValueCodec.h"
+#include <sstream>
+
+Migration::Migration() = default;
+
+Migration::~Migration() {
+    closeLink();
+}
+
+Migration* Migration::getInstance() {
+    static Migration migration;
+    return &migration;
+}
+
+void Migration::closeLink() {
+    if (linkFd >= 0) {
+        close(linkFd);
+    }
+    linkFd = -1;
+    linkReader.reset();
+    linkHost.clear();
+    linkPort = 0;
+}
+
+bool Migration::sendBatch(ReplyBuilder& reply, const std::string& host, int port, std::string_view db, int timeoutMs,
+                          const std::string& payload, size_t count, bool replace) {
+    std::string frame = "RESTORE " + std::string(db) + " " + std::to_string(count) + " " + std::to_string(payload.size()) +
+                        " " + std::to_string(Crc32c::value(payload.data(), payload.size())) + " " + (replace ? "1" : "0") + "\n";
+    frame += payload;
+    //缓存的连接可能已被目标节点关闭（如目标重启），这种情况下目标一定没有收到这一批，换新连接重发一次
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = linkFd >= 0 && linkHost == host && linkPort == port;
+        if (!reused) {
+            closeLink();
+            linkFd = connectTo(host, port + REPLICATION_PORT_OFFSET, timeoutMs);
+            if (linkFd < 0) {
+                reply.error("IOERR", "error or timeout connecting to the target instance");
+                return false;
+            }
+            linkHost = host;
+            linkPort = port;
+            linkReader = std::make_unique<SocketReader>(linkFd);
+        } else {
+            timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+            setsockopt(linkFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            setsockopt(linkFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        }
+        std::string line;
+        errno = 0;
+        bool sent = sendAll(linkFd, frame);
+        uint64_t before = linkReader->consumedBytes();
+        if (sent && linkReader->readLine(line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line == "+OK") {
+                return true;
+            }
+            //目标节点的错误原样返回给客户端
+            size_t space = line.find(' ');
+            if (line.size() > 1 && line[0] == '-' && space != std::string::npos) {
+                reply.error(std::string_view(line).substr(1, space - 1), std::string_view(line).substr(space + 1));
+            } else {
+                reply.error("Target instance replied with error: " + line);
+            }
+            return false;
+        }
+        bool stale = reused && errno != EAGAIN && errno != EWOULDBLOCK && linkReader->consumedBytes() == before;
+        closeLink();
+        if (!stale) {
+            break;
+        }
+    }
+    reply.error("IOERR", "error or timeout reading from the target instance");
+    return false;
+}
+
+bool Migration::migrateKeys(RedisHelper& helper, ReplyBuilder& reply, const std::string& host, int port, std::string_view db,
+                            int timeoutMs, std::vector<std::string>& keys, bool copy, bool replace) {
+    std::string payload;
+    helper.encodeRecords(keys, payload);
+    if (keys.empty()) {
+        return true;
+    }
+    if (!sendBatch(reply, host, port, db, timeoutMs, payload, keys.size(), replace)) {
+        return false;
+    }
+    if (copy) {
+        return true;
+    }
+    std::vector<std::string_view> tokens;
+    tokens.push_back("del");
+    tokens.insert(tokens.end(), keys.begin(), keys.end());
+    std::string scratch;
+    ReplyBuilder deleted(scratch);
+    helper.del(deleted, ArgSpan(tokens).subspan(1));
+    RedisServer::getInstance()->signalModified(helper.getDataBaseIndex(), ArgSpan(tokens).subspan(1));
+    //迁移的键在副本上同样删除；在事务中时并入事务的复制流条目，保持和事务中其它命令的先后顺序
+    if (Replication::getInstance()->isRecording()) {
+        std::vector<std::string> effects(1);
+        for (auto& token : tokens) {
+            appendArgument(effects[0], token);
+        }
+        RedisServer::getInstance()->propagateEffects(effects);
+    }
+    return true;
+}
+
+// 语法：migrate host port key|"" destination-db timeout [COPY] [REPLACE] [KEYS key [key ...]]
+// 127.0.0.1:6379> migrate 127.0.0.1 6380 user:1 0 5000
+// OK
+void Migration::migrate(RedisHelper& helper, ReplyBuilder& reply, const std::string& host, int port, std::string_view db,
+                        int timeoutMs, std::vector<std::string> keys, bool copy, bool replace) {
+    if (!migrateKeys(helper, reply, host, port, db, timeoutMs, keys, copy, replace)) {
+        return;
+    }
+    reply.status(keys.empty() ? "NOKEY" : "OK");
+}
+
+// 语法：migraterange host port start end [COUNT count] [REPLACE]
+// 127.0.0.1:6379> migraterange 127.0.0.1 6380 [sensor:2024-01 (sensor:2024-02 count 100
+// (integer) 100
+// 迁走的键已经从本节点删除，下一批仍从范围的起点开始，返回0时迁移完成。
+void Migration::migrateRange(RedisHelper& helper, ReplyBuilder& reply, const std::string& host, int port,
+                             std::string_view start, std::string_view end, size_t count, bool replace) {
+    std::vector<std::string> keys;
+    if (!helper.rangeKeys(start, end, count, keys)) {
+        return reply.error("min or max not valid string range item");
+    }
+    if (!migrateKeys(helper, reply, host, port, helper.getDataBaseIndex(), MIGRATE_TIMEOUT_MS, keys, false, replace)) {
+        return;
+    }
+    reply.integer(keys.size());
+}
+
+// 语法：migrateslot host port slot cursor [COUNT count] [REPLACE]
+// 127.0.0.1:6379> migrateslot 127.0.0.1 6380 866 0 count 1000
+// 1) "757365723a3938"
+// 2) (integer) 3
+// 键空间按键名而不是按槽位排序，迁移一个槽位需要用游标遍历一遍所有键，COUNT是每次检查的键数。
+void Migration::migrateSlot(RedisHelper& helper, ReplyBuilder& reply, const std::string& host, int port,
+                            int slot, std::string_view cursor, size_t count, bool replace) {
+    std::vector<std::string> keys;
+    std::string next = helper.scanKeys(cursor, count, [slot](const std::string& key) {
+        return Cluster::keySlot(key) == slot;
+    }, keys);
+    if (next.empty()) {
+        return reply.error("invalid cursor");
+    }
+    if (!migrateKeys(helper, reply, host, port, helper.getDataBaseIndex(), MIGRATE_TIMEOUT_MS, keys, false, replace)) {
+        return;
+    }
+    reply.arrayHeader(2);
+    reply.bulk(next);
+    reply.integer(keys.size());
+}
+
+void Migration::serveRestore(int fd, SocketReader& reader, std::string line) {
+    std::string command, db, payload, out;
+    do {
+        size_t count = 0, size = 0;
+        uint32_t checksum = 0;
+        int replace = 0;
+        std::istringstream fields(line);
+        if (!(fields >> command >> db >> count >> size >> checksum >> replace) || command != "RESTORE" ||
+            !reader.readBytes(size, payload)) {
+            break;
+        }
+        out.clear();
+        ReplyBuilder reply(out);
+        if (Crc32c::value(payload.data(), payload.size()) != checksum) {
+            reply.error("Migration payload checksum mismatch");
+        } else {
+            RedisServer::getInstance()->runExclusive([&] {
+                if (Replication::getInstance()->isReplica()) {
+                    return reply.error("READONLY", "You can't write against a read only replica.");
+                }
+                auto helper = CommandParser::getRedisHelper();
+                //数据库编号是全局状态，写入后切换回客户端原来选择的数据库
+                std::string current = helper->getDataBaseIndex();
+                std::string scratch;
+                ReplyBuilder selected(scratch);
+                int index = 0;
+                bool switched = current != db;
+                if (switched) {
+                    if (!parseInteger(db, index) || index < 0 || index >= DATABASE_FILE_NUMBER) {
+                        return reply.error("database index out of range.");
+                    }
+                    helper->select(selected, index);
+                }
+                std::vector<std::string> keys;
+                bool restored = helper->restoreRecords(reply, payload, count, replace != 0, keys);
+                std::vector<std::string_view> restoredKeys(keys.begin(), keys.end());
+                RedisServer::getInstance()->signalModified(db, restoredKeys);
+                if (restored && Replication::getInstance()->isRecording()) {
+                    //每个键作为一条RESTORE写入复制流，副本上得到同样的值
+                    std::vector<std::string> commands;
+                    std::string data;
+                    for (auto& key : keys) {
+                        data.clear();
+                        helper->dumpValue(key, data);
+                        std::string command = "restore";
+                        appendArgument(command, key);
+                        commands.push_back(command + " 0 " + ValueCodec::toHex(data) + " replace");
+                    }
+                    Replication::getInstance()->propagate(db, commands);
+                }
+                if (switched && parseInteger(current, index)) {
+                    helper->select(selected, index);
+                }
+            });
+        }
+        if (!sendAll(fd, out)) {
+            break;
+        }
+    } while (reader.readLine(line));
+    close(fd);
+}
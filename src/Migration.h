@@ -0,0 +1,62 @@
+#ifndef MIGRATION_H
+#define MIGRATION_H
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ReplyBuilder.h"
+
+class RedisHelper;
+class SocketReader;
+
+#define MIGRATE_DEFAULT_BATCH 100  //MIGRATERANGE/MIGRATESLOT默认每批迁移的键数
+#define MIGRATE_TIMEOUT_MS 5000    //MIGRATERANGE/MIGRATESLOT等待目标节点的时间
+
+/*
+    Migration 在节点之间迁移键（MIGRATE、MIGRATERANGE、MIGRATESLOT）
+    源节点把一批键编码成二进制记录（ValueCodec.h），通过目标节点的复制端口发送：
+        RESTORE <数据库编号> <记录条数> <字节数> <CRC32C> <replace 0|1>\n<记录>
+    目标节点在命令锁内校验并写入整批记录（有一个键已存在且没有REPLACE时整批都不写），回复一行RESP：
+        +OK\r\n  或  -BUSYKEY ...\r\n 等错误
+    源节点收到+OK后才删除这批键，迁移中途失败时键仍在源节点上，不会丢失。
+    每次命令只迁移一批，批与批之间源节点照常处理其它客户端的命令；管理员或脚本重复调用直到迁移完：
+        MIGRATERANGE返回0时范围内已经没有键；MIGRATESLOT返回的游标为0时槽位已经遍历完。
+    源节点的方法都在命令锁内调用，到目标节点的连接只有一个，缓存下来给下一批使用。
+*/
+class Migration {
+private:
+    std::string linkHost;
+    int linkPort = 0;
+    int linkFd = -1;
+    std::unique_ptr<SocketReader> linkReader;
+
+    Migration();
+    void closeLink();
+    // 发送一批记录并等待目标节点的回复，失败时把错误写入reply并返回false
+    bool sendBatch(ReplyBuilder& reply, const std::string& host, int port, std::string_view db, int timeoutMs,
+                   const std::string& payload, size_t count, bool replace);
+    // 迁移keys中存在的键，copy为false时成功后在本节点删除；keys中只留下实际迁移的键
+    bool migrateKeys(RedisHelper& helper, ReplyBuilder& reply, const std::string& host, int port, std::string_view db,
+                     int timeoutMs, std::vector<std::string>& keys, bool copy, bool replace);
+
+public:
+    static Migration* getInstance();
+    ~Migration();
+
+    // MIGRATE host port key|"" destination-db timeout [COPY] [REPLACE] [KEYS key ...]
+    // 全部迁移成功返回OK，没有一个键存在时返回NOKEY
+    void migrate(RedisHelper& helper, ReplyBuilder& reply, const std::string& host, int port, std::string_view db,
+                 int timeoutMs, std::vector<std::string> keys, bool copy, bool replace);
+    // MIGRATERANGE host port start end [COUNT count] [REPLACE]：迁移KRANGE范围内的前count个键，返回迁移的键数
+    void migrateRange(RedisHelper& helper, ReplyBuilder& reply, const std::string& host, int port,
+                      std::string_view start, std::string_view end, size_t count, bool replace);
+    // MIGRATESLOT host port slot cursor [COUNT count] [REPLACE]：从cursor开始检查count个键，迁移其中属于slot的键
+    // 返回[下一个游标, 迁移的键数]，游标与SCAN相同
+    void migrateSlot(RedisHelper& helper, ReplyBuilder& reply, const std::string& host, int port,
+                     int slot, std::string_view cursor, size_t count, bool replace);
+
+    // 目标节点：处理复制端口上第一行以RESTORE开头的连接，直到源节点断开
+    void serveRestore(int fd, SocketReader& reader, std::string line);
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef NODELINK_H
+#define NODELINK_H
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define NODE_LINK_CHUNK_SIZE (64 << 10) //每次从套接字读取的最大字节数
+
+/*
+    节点之间TCP连接的读写工具
+    主从复制（Replication）和槽位迁移（Migration）共用复制端口上的连接，都是"一行文本命令+原始字节"的格式。
+*/
+
+// 发送全部数据，对端关闭时不产生SIGPIPE
+inline bool sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(sent);
+    }
+    return true;
+}
+
+// 用sendfile把整个文件发给对端，数据不经过用户态
+inline bool sendFile(int fd, int fileFd, size_t size) {
+    off_t offset = 0;
+    while (static_cast<size_t>(offset) < size) {
+        ssize_t sent = sendfile(fd, fileFd, &offset, size - offset);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    带缓冲地从套接字读取一行或指定长度的数据
+    consumed记录已经交给调用方的字节数，副本据此计算复制偏移量
+*/
+class SocketReader {
+private:
+    int fd;
+    std::string buffer;
+    size_t pos = 0;
+    uint64_t consumed = 0;
+
+    bool fill() {
+        if (pos == buffer.size()) {
+            buffer.clear();
+            pos = 0;
+        } else if (pos > NODE_LINK_CHUNK_SIZE) {
+            buffer.erase(0, pos);
+            pos = 0;
+        }
+        char chunk[NODE_LINK_CHUNK_SIZE];
+        ssize_t received;
+        do {
+            received = recv(fd, chunk, sizeof(chunk), 0);
+        } while (received < 0 && errno == EINTR);
+        if (received <= 0) {
+            return false;
+        }
+        buffer.append(chunk, received);
+        return true;
+    }
+
+public:
+    explicit SocketReader(int fd) : fd(fd) {}
+
+    uint64_t consumedBytes() const { return consumed; }
+
+    // 读取一行，不含换行符
+    bool readLine(std::string& line) {
+        size_t end;
+        while ((end = buffer.find('\n', pos)) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        line.assign(buffer, pos, end - pos);
+        consumed += end + 1 - pos;
+        pos = end + 1;
+        return true;
+    }
+
+    bool readBytes(size_t size, std::string& out) {
+        while (buffer.size() - pos < size) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        out.assign(buffer, pos, size);
+        consumed += size;
+        pos += size;
+        return true;
+    }
+
+    // 把接下来的size个字节写入文件，大文件不会整个读进内存
+    bool copyTo(int fileFd, size_t size) {
+        while (size > 0) {
+            if (pos == buffer.size() && !fill()) {
+                return false;
+            }
+            size_t count = std::min(size, buffer.size() - pos);
+            if (write(fileFd, buffer.data() + pos, count) != static_cast<ssize_t>(count)) {
+                return false;
+            }
+            pos += count;
+            consumed += count;
+            size -= count;
+        }
+        return true;
+    }
+};
+
+// 连接host:port，timeoutMs大于0时同时作为连接、发送和接收的超时时间
+inline int connectTo(const std::string& host, int port, int timeoutMs = 0) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo* address = result; address != nullptr; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (timeoutMs > 0) {
+            //Linux上SO_SNDTIMEO同样限制connect的等待时间
+            timeval timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        }
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    if (fd >= 0) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+#endif
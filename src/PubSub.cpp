@@ -0,0 +1,260 @@
+#include "PubSub.h"
+#include <algorithm>
+#include <chrono>
+
+PubSub::PubSub() = default;
+
+PubSub* PubSub::getInstance() {
+    static PubSub pubsub;
+    return &pubsub;
+}
+
+std::shared_ptr<PubSub::Subscriber> PubSub::find(std::string_view id, ReplyBuilder& reply) {
+    uint64_t value = 0;
+    auto it = parseInteger(id, value) ? subscribers.find(value) : subscribers.end();
+    if (it == subscribers.end()) {
+        reply.error("no such subscriber");
+        return nullptr;
+    }
+    return it->second;
+}
+
+size_t PubSub::subscriptionCount(const Subscriber& subscriber) {
+    return subscriber.channels.size() + subscriber.patterns.size();
+}
+
+bool PubSub::deliver(Subscriber& subscriber, const std::shared_ptr<const std::string>& message) {
+    subscriber.pendingBytes += message->size();
+    if (subscriber.pendingBytes > PUBSUB_PENDING_LIMIT) {
+        return false;
+    }
+    subscriber.pending.push_back(message);
+    return true;
+}
+
+void PubSub::removeChannel(Subscriber& subscriber, const std::string& channel) {
+    auto it = channels.find(channel);
+    if (it == channels.end()) {
+        return;
+    }
+    auto& list = it->second;
+    list.erase(std::remove(list.begin(), list.end(), &subscriber), list.end());
+    if (list.empty()) {
+        channels.erase(it);
+    }
+}
+
+void PubSub::removePattern(Subscriber& subscriber, const std::string& pattern) {
+    for (auto it = patterns.begin(); it != patterns.end(); ++it) {
+        if (it->pattern != pattern) {
+            continue;
+        }
+        auto& list = it->subscribers;
+        list.erase(std::remove(list.begin(), list.end(), &subscriber), list.end());
+        if (list.empty()) {
+            patterns.erase(it);
+        }
+        return;
+    }
+}
+
+void PubSub::close(Subscriber& subscriber) {
+    for (auto& channel : subscriber.channels) {
+        removeChannel(subscriber, channel);
+    }
+    for (auto& pattern : subscriber.patterns) {
+        removePattern(subscriber, pattern);
+    }
+    subscriber.channels.clear();
+    subscriber.patterns.clear();
+    subscriber.pending.clear();
+    uint64_t id = subscriber.id;
+    subscribers.erase(id); //最后删除，subscriber可能只剩这一份引用
+}
+
+void PubSub::expireIdle() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastSweep < std::chrono::milliseconds(PUBSUB_SWEEP_INTERVAL_MS)) {
+        return;
+    }
+    lastSweep = now;
+    std::vector<uint64_t> idle;
+    for (auto& entry : subscribers) {
+        if (now - entry.second->lastListen > std::chrono::milliseconds(PUBSUB_IDLE_TIMEOUT_MS)) {
+            idle.push_back(entry.first);
+        }
+    }
+    for (auto id : idle) {
+        close(*subscribers[id]);
+    }
+}
+
+// 语法：publish channel message
+// 127.0.0.1:6379> publish news hello
+// (integer) 2
+void PubSub::publish(ReplyBuilder& reply, std::string_view channel, std::string_view message) {
+    std::lock_guard<std::mutex> lock(mutex);
+    expireIdle(); //先删除已经离开的订阅者，不再给它们积压消息
+    size_t receivers = 0;
+    std::vector<uint64_t> overflowed;
+    auto fanOut = [&](const std::vector<Subscriber*>& list, const std::shared_ptr<const std::string>& frame) {
+        for (auto* subscriber : list) {
+            if (!deliver(*subscriber, frame)) {
+                overflowed.push_back(subscriber->id);
+            }
+        }
+        receivers += list.size();
+    };
+    std::string frame;
+    ReplyBuilder builder(frame);
+    auto it = channels.find(std::string(channel));
+    if (it != channels.end()) {
+        builder.arrayHeader(3);
+        builder.bulk("message");
+        builder.bulk(channel);
+        builder.bulk(message);
+        fanOut(it->second, std::make_shared<const std::string>(std::move(frame)));
+    }
+    for (auto& entry : patterns) {
+        if (!entry.glob.match(channel)) {
+            continue;
+        }
+        frame.clear();
+        builder.arrayHeader(4);
+        builder.bulk("pmessage");
+        builder.bulk(entry.pattern);
+        builder.bulk(channel);
+        builder.bulk(message);
+        fanOut(entry.subscribers, std::make_shared<const std::string>(std::move(frame)));
+    }
+    //积压过多的订阅者不再取消息了，和Redis断开输出缓冲区超限的客户端一样丢弃它
+    for (auto id : overflowed) {
+        auto found = subscribers.find(id);
+        if (found != subscribers.end()) { //同一个订阅者可能通过多个模式超限
+            close(*found->second);
+        }
+    }
+    reply.integer(static_cast<long long>(receivers));
+}
+
+// 语法：subscribe channel [channel ...]，回复的第一个元素是订阅者编号，之后每个频道一条确认
+// 127.0.0.1:6379> subscribe news sports
+// 1) (integer) 1
+// 2) 1) "subscribe"
+//    2) "news"
+//    3) (integer) 1
+// 3) 1) "subscribe"
+//    2) "sports"
+//    3) (integer) 2
+void PubSub::subscribe(ReplyBuilder& reply, ArgSpan names, bool pattern) {
+    std::lock_guard<std::mutex> lock(mutex);
+    expireIdle();
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->id = nextId++;
+    subscriber->lastListen = std::chrono::steady_clock::now();
+    subscribers.emplace(subscriber->id, subscriber);
+    reply.arrayHeader(names.size() + 1);
+    reply.integer(static_cast<long long>(subscriber->id));
+    for (auto& name : names) {
+        auto& own = pattern ? subscriber->patterns : subscriber->channels;
+        if (std::find(own.begin(), own.end(), name) == own.end()) { //重复的频道只订阅一次
+            own.emplace_back(name);
+            if (!pattern) {
+                channels[own.back()].push_back(subscriber.get());
+            } else {
+                auto entry = std::find_if(patterns.begin(), patterns.end(),
+                                          [&](const PatternEntry& e) { return e.pattern == name; });
+                if (entry == patterns.end()) {
+                    patterns.push_back({own.back(), GlobPattern(name), {}}); //模式只在第一次被订阅时编译
+                    entry = patterns.end() - 1;
+                }
+                entry->subscribers.push_back(subscriber.get());
+            }
+        }
+        reply.arrayHeader(3);
+        reply.bulk(pattern ? "psubscribe" : "subscribe");
+        reply.bulk(name);
+        reply.integer(static_cast<long long>(subscriptionCount(*subscriber)));
+    }
+}
+
+void PubSub::subscribeChannels(ReplyBuilder& reply, ArgSpan channels) {
+    subscribe(reply, channels, false);
+}
+
+void PubSub::subscribePatterns(ReplyBuilder& reply, ArgSpan patterns) {
+    subscribe(reply, patterns, true);
+}
+
+// 语法：unsubscribe id [channel ...]，每个频道一条确认，count为剩余的订阅数，为0时订阅者被删除
+// 127.0.0.1:6379> unsubscribe 1 news
+// 1) 1) "unsubscribe"
+//    2) "news"
+//    3) (integer) 1
+void PubSub::unsubscribe(ReplyBuilder& reply, std::string_view id, ArgSpan names, bool pattern) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto subscriber = find(id, reply);
+    if (subscriber == nullptr) {
+        return;
+    }
+    auto& own = pattern ? subscriber->patterns : subscriber->channels;
+    std::vector<std::string> targets = names.empty() ? own : std::vector<std::string>(names.begin(), names.end());
+    const char* kind = pattern ? "punsubscribe" : "unsubscribe";
+    if (targets.empty()) { //没有这一类订阅时与Redis相同，回复一条频道为nil的确认
+        reply.arrayHeader(1);
+        reply.arrayHeader(3);
+        reply.bulk(kind);
+        reply.nil();
+        reply.integer(static_cast<long long>(subscriptionCount(*subscriber)));
+        return;
+    }
+    reply.arrayHeader(targets.size());
+    for (auto& name : targets) {
+        auto it = std::find(own.begin(), own.end(), name);
+        if (it != own.end()) {
+            own.erase(it);
+            if (pattern) {
+                removePattern(*subscriber, name);
+            } else {
+                removeChannel(*subscriber, name);
+            }
+        }
+        reply.arrayHeader(3);
+        reply.bulk(kind);
+        reply.bulk(name);
+        reply.integer(static_cast<long long>(subscriptionCount(*subscriber)));
+    }
+    if (subscriptionCount(*subscriber) == 0) {
+        close(*subscriber);
+    }
+}
+
+void PubSub::unsubscribeChannels(ReplyBuilder& reply, std::string_view id, ArgSpan channels) {
+    unsubscribe(reply, id, channels, false);
+}
+
+void PubSub::unsubscribePatterns(ReplyBuilder& reply, std::string_view id, ArgSpan patterns) {
+    unsubscribe(reply, id, patterns, true);
+}
+
+// 语法：listen id
+// 127.0.0.1:6379> listen 1                 另一个客户端 publish news hello 之后
+// 1) 1) "message"
+//    2) "news"
+//    3) "hello"
+// 不等待，没有消息时返回空数组；订阅者已被删除（退订全部频道、积压过多或长时间没有LISTEN）时返回错误
+void PubSub::listen(ReplyBuilder& reply, std::string_view id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto subscriber = find(id, reply);
+    if (subscriber == nullptr) {
+        return;
+    }
+    subscriber->lastListen = std::chrono::steady_clock::now();
+    //消息在发布时已经序列化好，这里只拼接共享的缓冲区
+    reply.arrayHeader(subscriber->pending.size());
+    for (auto& message : subscriber->pending) {
+        reply.buffer() += *message;
+    }
+    subscriber->pending.clear();
+    subscriber->pendingBytes = 0;
+}
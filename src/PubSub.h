@@ -0,0 +1,88 @@
+#ifndef PUBSUB_H
+#define PUBSUB_H
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "CommandArgs.h"
+#include "GlobPattern.h"
+#include "ReplyBuilder.h"
+
+#define PUBSUB_PENDING_LIMIT (32ULL << 20) //订阅者未取走的消息的最大字节数，超过时丢弃该订阅者（与Redis的pubsub输出缓冲区硬限制相同）
+#define PUBSUB_IDLE_TIMEOUT_MS 30000       //订阅者超过这个时间没有LISTEN时视为客户端已经退出，删除它
+#define PUBSUB_SWEEP_INTERVAL_MS 1000      //检查空闲订阅者的最小间隔
+
+/*
+    PubSub 发布订阅（PUBLISH、SUBSCRIBE、PSUBSCRIBE、UNSUBSCRIBE、PUNSUBSCRIBE、LISTEN）
+    客户端和服务器之间是一问一答的RPC，服务器不能主动推送，所以订阅者是服务器上的一个"邮箱"：
+    SUBSCRIBE/PSUBSCRIBE创建订阅者并返回它的编号，发布的消息放进订阅者的待取队列，
+    客户端用LISTEN轮询取走（不等待，没有消息时返回空数组），UNSUBSCRIBE等命令也按编号指定订阅者。
+    客户端退出时不会发送UNSUBSCRIBE，长时间没有LISTEN的订阅者被删除，积压的消息随之释放。
+    频道到订阅者是哈希表，模式是编译好的GlobPattern列表，PUBLISH时每个模式只匹配一次。
+    一条消息只序列化一次（RESP格式的message/pmessage数组），所有订阅者的队列共享同一份缓冲区（shared_ptr），
+    不按订阅者拷贝消息内容；LISTEN时直接把这些缓冲区拼到回复中。
+    LISTEN不在请求中等待：等待的请求占用server.cpp的一个工作线程，订阅者的数量不应受线程数限制。
+    订阅状态有自己的锁，SUBSCRIBE、LISTEN等不进入命令锁（见RedisServer::servePubSub）；
+    PUBLISH是普通命令，可以在事务和脚本中执行，在命令锁内调用publish；它写入复制流，副本上的订阅者同样收到消息。
+*/
+class PubSub {
+private:
+    struct Subscriber {
+        uint64_t id;
+        std::vector<std::string> channels;
+        std::vector<std::string> patterns;
+        std::vector<std::shared_ptr<const std::string>> pending; //待取走的消息，与其它订阅者共享
+        size_t pendingBytes = 0;
+        std::chrono::steady_clock::time_point lastListen; //创建或最近一次LISTEN的时间
+    };
+    struct PatternEntry {
+        std::string pattern;
+        GlobPattern glob;
+        std::vector<Subscriber*> subscribers;
+    };
+
+    std::mutex mutex;
+    uint64_t nextId = 1;
+    std::unordered_map<uint64_t, std::shared_ptr<Subscriber>> subscribers;
+    std::unordered_map<std::string, std::vector<Subscriber*>> channels; //频道 -> 订阅者
+    std::vector<PatternEntry> patterns;                                 //模式 -> 订阅者
+    std::chrono::steady_clock::time_point lastSweep;
+
+    PubSub();
+    // 以下在持有mutex时调用
+    std::shared_ptr<Subscriber> find(std::string_view id, ReplyBuilder& reply);
+    // 订阅者当前的频道和模式总数，即确认消息中的count
+    static size_t subscriptionCount(const Subscriber& subscriber);
+    // 消息放入订阅者的队列，积压超过上限时返回false
+    static bool deliver(Subscriber& subscriber, const std::shared_ptr<const std::string>& message);
+    void removeChannel(Subscriber& subscriber, const std::string& channel);
+    void removePattern(Subscriber& subscriber, const std::string& pattern);
+    // 订阅者不再有任何订阅：从表中删除
+    void close(Subscriber& subscriber);
+    // 删除超过PUBSUB_IDLE_TIMEOUT_MS没有LISTEN的订阅者，最多每PUBSUB_SWEEP_INTERVAL_MS检查一次
+    void expireIdle();
+    void subscribe(ReplyBuilder& reply, ArgSpan names, bool pattern);
+    void unsubscribe(ReplyBuilder& reply, std::string_view id, ArgSpan names, bool pattern);
+
+public:
+    static PubSub* getInstance();
+
+    // PUBLISH channel message：返回收到消息的订阅者数，同一订阅者通过频道和模式各收到一次时计为两次（与Redis相同）
+    void publish(ReplyBuilder& reply, std::string_view channel, std::string_view message);
+    // SUBSCRIBE channel [channel ...]：创建订阅者，返回编号和每个频道的确认
+    void subscribeChannels(ReplyBuilder& reply, ArgSpan channels);
+    // PSUBSCRIBE pattern [pattern ...]
+    void subscribePatterns(ReplyBuilder& reply, ArgSpan patterns);
+    // UNSUBSCRIBE id [channel ...]：不指定频道时退订全部频道，没有任何订阅后订阅者被删除
+    void unsubscribeChannels(ReplyBuilder& reply, std::string_view id, ArgSpan channels);
+    // PUNSUBSCRIBE id [pattern ...]
+    void unsubscribePatterns(ReplyBuilder& reply, std::string_view id, ArgSpan patterns);
+    // LISTEN id：取走全部待取的消息，没有消息时返回空数组
+    void listen(ReplyBuilder& reply, std::string_view id);
+};
+
+#endif
@@ -1,53 +1,110 @@
 
 #include"RedisHelper.h"
 #include"FileCreator.h"
+#include"Bitmap.h"
+#include"HyperLogLog.h"
+#include"GlobPattern.h"
+#include"RedisValue/Stream.h"
+#include"Snapshot.h"
+#include"ValueCodec.h"
+#include<chrono>
+
+// 字符串值按原始字节保存（RedisValue::stringValue），读写都直接使用这些字节，
+// 不经过dump()的JSON转义，因此可以保存图片、序列化数据等任意二进制内容。
+#define NOT_A_STRING(key) ("The key:" +std::string(key)+" "+"already exists and the value is not a string!")
+
+// 回复任意类型的值：字符串返回原始字节，其它类型返回序列化后的文本
+static void replyValue(ReplyBuilder& reply,RedisValue& value){
+    if(value.type()==RedisValue::STRING){
+        reply.bulk(value.stringValue());
+    }else{
+        reply.bulk(value.dump());
+    }
+}
 
 
 void RedisHelper::flush(){
-    // 打开文件并覆盖写入
+    if(!persistent){
+        return;
+    }
+    // 打开文件并覆盖写入，记录经过大块缓冲区顺序写出（见Snapshot.h）
     std::string filePath=getFilePath();
-    std::ofstream outputFile(filePath);
+    SnapshotWriter writer(filePath);
     // 检查文件是否成功打开
-    if (!outputFile) {
+    if (!writer.isOpen()) {
         std::cout<<"文件："<<filePath<<"打开失败"<<std::endl;
         return ;
     }
-    auto currentNode=redisDataBase->getHead();
-    while(currentNode!=nullptr){
-        std::string key=currentNode->key;
-        RedisValue value=currentNode->value;
-        if(!key.empty())
-            outputFile<<key<<":"<<value.dump()<<std::endl;
-        currentNode=currentNode->forward[0];
+    // 记录直接序列化到同一个缓冲区，攒满一个数据块再交给writer（按需压缩），不为每个键复制键值或分配临时字符串
+    std::string records;
+    for(auto node=redisDataBase->getHead()->forward[0];node!=nullptr;node=node->forward[0]){
+        SnapshotFormat::appendRecord(records,node->key,node->value);
+        if(records.size()>=SNAPSHOT_BATCH_SIZE){
+            writer.appendBlock(records);
+            records.clear();
+        }
     }
+    writer.appendBlock(records);
     // 关闭文件
-    outputFile.close();
+    if(!writer.close()){
+        std::cout<<"文件："<<filePath<<"写入失败"<<std::endl;
+    }
 }
 
 std::string RedisHelper::getFilePath(){
-    std::string folder = DEFAULT_DB_FOLDER; //文件夹名
+    std::string folder = dataFolder; //文件夹名
     std::string fileName = DATABASE_FILE_NAME; //文件名
     std::string filePath=folder+"/"+fileName+dataBaseIndex; //文件路径
     return filePath;
 }
 
+std::string RedisHelper::getFilePath(int index)const{
+    return dataFolder+"/"+DATABASE_FILE_NAME+std::to_string(index);
+}
+
 //从文件中加载
 void RedisHelper::loadData(std::string loadPath){
     redisDataBase->loadFile(loadPath);
 }
 
+void RedisHelper::reload(){
+    resetDataBase();
+    loadData(getFilePath());
+}
+
+void RedisHelper::resetDataBase(){
+    redisDataBase=std::make_shared<SkipList<std::string, RedisValue>>();
+    redisDataBase->setLocking(locking);
+}
+
+std::shared_ptr<RedisHelper> RedisHelper::createMirror()const{
+    auto mirror=std::make_shared<RedisHelper>(dataFolder);
+    mirror->persistent=false;
+    if(mirror->dataBaseIndex!=dataBaseIndex){
+        mirror->dataBaseIndex=dataBaseIndex;
+        mirror->reload();
+    }
+    mirror->setLocking(locking);
+    return mirror;
+}
+
+void RedisHelper::setLocking(bool enabled){
+    locking=enabled;
+    redisDataBase->setLocking(enabled);
+}
+
 //选择数据库
-std::string RedisHelper::select(int index){
+void RedisHelper::select(ReplyBuilder& reply,int index){
     if(index<0||index>DATABASE_FILE_NUMBER-1){
-        return "database index out of range.";
+        return reply.error("database index out of range.");
     }
     flush(); //选择数据库之前先写入一下
-    redisDataBase=std::make_shared<SkipList<std::string, RedisValue>>();
+    resetDataBase();
     dataBaseIndex=std::to_string(index);
     std::string filePath=getFilePath(); //根据选择的数据库，修改文件路径，然后加载
 
     loadData(filePath);
-    return "OK";
+    reply.status("OK");
 }
 // key操作命令
 // 获取所有键
@@ -55,117 +112,401 @@ std::string RedisHelper::select(int index){
 // 127.0.0.1:6379> keys *
 // 1) "javastack"
 // *表示通配符，表示任意字符，会遍历所有键显示所有的键列表，时间复杂度O(n)，在生产环境不建议使用。
-std::string RedisHelper::keys(const std::string pattern){
-    std::string res="";
-    auto node=redisDataBase->getHead()->forward[0];
-    int count=0;
-    while(node!=nullptr){
-        res+=std::to_string(++count)+") "+"\""+node->key+"\""+"\n";
+// 支持*、?、[...]和\转义；模式以字面量开头（如user:123:*）时只遍历该前缀范围内的键。
+void RedisHelper::keys(ReplyBuilder& reply,std::string_view pattern){
+    GlobPattern glob(pattern);
+    const std::string& prefix=glob.literalPrefix();
+    //键空间有序，有字面量前缀时直接定位到前缀范围的起点，越过前缀范围即可停止
+    auto node=prefix.empty()?redisDataBase->getHead()->forward[0]:redisDataBase->lowerBound(prefix);
+    //匹配的键数事先未知，先写键再补数组头
+    size_t array=reply.beginArray();
+    size_t count=0;
+    while(node!=nullptr&&!glob.pastPrefix(node->key)){
+        if(glob.match(node->key)){
+            reply.bulk(node->key);
+            count++;
+        }
         node=node->forward[0];
     }
-    if(!res.empty())
-        res.pop_back();
-    else{
-        res="this database is empty!";
+    reply.endArray(array,count);
+}
+// 增量遍历
+// 游标是上一批最后检查的键（十六进制编码），下一批从严格大于它的键开始，"0"表示开始/结束。
+// 由于键空间按跳表有序，遍历期间一直存在的键恰好返回一次，新增或删除的键不影响其它键。
+static std::string encodeCursor(const std::string&key){
+    return ValueCodec::toHex(key);
+}
+
+static bool decodeCursor(std::string_view cursor,std::string&key){
+    if(cursor=="0"){
+        key.clear();
+        return true;
+    }
+    return ValueCodec::fromHex(cursor,key);
+}
+
+static std::string typeName(const RedisValue&value){
+    switch(value.type()){
+        case RedisValue::STRING: return "string";
+        case RedisValue::ARRAY: return "list";
+        case RedisValue::OBJECT: return "hash";
+        case RedisValue::STREAM: return "stream";
+        default: return "none";
+    }
+}
+
+// 回复游标和本批结果：[cursor, [item ...]]
+static void replyScan(ReplyBuilder& reply,std::string_view cursor,const std::vector<std::string_view>&items){
+    reply.arrayHeader(2);
+    reply.bulk(cursor);
+    reply.arrayHeader(items.size());
+    for(auto& item:items){
+        reply.bulk(item);
+    }
+}
+
+// 语法：scan cursor [MATCH pattern] [COUNT count] [TYPE type]
+// 127.0.0.1:6379> scan 0 match user:* count 2
+// 1) "757365723a32"
+// 2) 1) "user:1"
+//    2) "user:2"
+// COUNT是每次检查的键数，MATCH和TYPE在检查之后过滤，所以一批结果可能少于COUNT甚至为空。
+void RedisHelper::scan(ReplyBuilder& reply,std::string_view cursor,std::string_view pattern,size_t count,std::string_view type){
+    std::string lastKey;
+    if(!decodeCursor(cursor,lastKey)){
+        return reply.error("invalid cursor");
+    }
+    GlobPattern glob(pattern);
+    const std::string& prefix=glob.literalPrefix();
+    //游标还没到前缀范围时直接跳到前缀范围的起点
+    auto node=cursor=="0"||lastKey<prefix?redisDataBase->lowerBound(prefix):redisDataBase->upperBound(lastKey);
+    std::vector<std::shared_ptr<SkipListNode<std::string,RedisValue>>>nodes; //持有节点，保证回复前键有效
+    std::vector<std::string_view>keys;
+    size_t examined=0;
+    while(node!=nullptr&&examined<count&&!glob.pastPrefix(node->key)){
+        lastKey=node->key;
+        examined++;
+        if((type.empty()||typeName(node->value)==type)&&glob.match(node->key)){
+            nodes.push_back(node);
+            keys.push_back(node->key);
+        }
+        node=node->forward[0];
+    }
+    bool finished=node==nullptr||glob.pastPrefix(node->key);
+    replyScan(reply,finished?"0":encodeCursor(lastKey),keys);
+}
+
+// 键范围查询
+// 边界语法与ZRANGEBYLEX一致：[key包含key，(key不包含key，-和+表示无穷小和无穷大。
+// 先在跳表中定位到范围的一端，然后沿第0层（逆序时沿backward）线性遍历，不需要逐个查找。
+struct KeyBound{
+    std::string_view key;
+    bool inclusive=true;
+    bool unbounded=false;
+    bool empty=false; //起点为+或终点为-，范围一定为空
+};
+
+static bool parseKeyBound(std::string_view text,bool isStart,KeyBound&bound){
+    if(text.empty()){
+        return false;
+    }
+    if(text=="-"||text=="+"){
+        //起点为-、终点为+时不限制该端，反之范围为空
+        bound.unbounded=(text=="-")==isStart;
+        bound.empty=!bound.unbounded;
+        return true;
+    }
+    if(text[0]=='['||text[0]=='('){
+        bound.inclusive=text[0]=='[';
+        bound.key=text.substr(1);
+    }else{
+        bound.key=text;
+    }
+    return true;
+}
+
+static bool beforeEnd(const std::string&key,const KeyBound&end){
+    return end.unbounded||key<end.key||(end.inclusive&&key==end.key);
+}
+
+static bool afterStart(const std::string&key,const KeyBound&start){
+    return start.unbounded||start.key<key||(start.inclusive&&key==start.key);
+}
+
+// 语法：krange start end [WITHVALUES] [LIMIT count]
+// 127.0.0.1:6379> krange [sensor:2024-01 (sensor:2024-02 limit 2
+// 1) "sensor:2024-01-01"
+// 2) "sensor:2024-01-02"
+// 语法：krevrange end start [WITHVALUES] [LIMIT count]，从end开始逆序返回。
+void RedisHelper::krange(ReplyBuilder& reply,std::string_view start,std::string_view end,bool withValues,size_t limit,bool reverse){
+    KeyBound startBound,endBound;
+    if(!parseKeyBound(start,true,startBound)||!parseKeyBound(end,false,endBound)){
+        return reply.error("min or max not valid string range item");
+    }
+    if(startBound.empty||endBound.empty){
+        return reply.arrayHeader(0);
+    }
+    size_t array=reply.beginArray();
+    size_t count=0;
+    if(!reverse){
+        auto node=startBound.unbounded?redisDataBase->getHead()->forward[0]
+                 :startBound.inclusive?redisDataBase->lowerBound(startBound.key):redisDataBase->upperBound(startBound.key);
+        for(;node!=nullptr&&beforeEnd(node->key,endBound)&&(limit==0||count<limit);node=node->forward[0],count++){
+            reply.bulk(node->key);
+            if(withValues){
+                replyValue(reply,node->value);
+            }
+        }
+    }else{
+        auto node=endBound.unbounded?redisDataBase->getTail():redisDataBase->findLast(endBound.key,endBound.inclusive);
+        for(;node!=nullptr&&afterStart(node->key,startBound)&&(limit==0||count<limit);node=node->backward.lock(),count++){
+            reply.bulk(node->key);
+            if(withValues){
+                replyValue(reply,node->value);
+            }
+        }
+    }
+    reply.endArray(array,withValues?count*2:count);
+}
+
+// 语法：kcount start end
+// 127.0.0.1:6379> kcount [sensor:2024-01 (sensor:2024-02
+// (integer) 31
+void RedisHelper::kcount(ReplyBuilder& reply,std::string_view start,std::string_view end){
+    KeyBound startBound,endBound;
+    if(!parseKeyBound(start,true,startBound)||!parseKeyBound(end,false,endBound)){
+        return reply.error("min or max not valid string range item");
+    }
+    if(startBound.empty||endBound.empty){
+        return reply.integer(0);
+    }
+    auto node=startBound.unbounded?redisDataBase->getHead()->forward[0]
+             :startBound.inclusive?redisDataBase->lowerBound(startBound.key):redisDataBase->upperBound(startBound.key);
+    long long count=0;
+    for(;node!=nullptr&&beforeEnd(node->key,endBound);node=node->forward[0]){
+        count++;
+    }
+    reply.integer(count);
+}
+
+// 序列化键的值
+// 语法：dump key
+// 127.0.0.1:6379> dump user:1
+// "0004746f6d"
+// 返回值的二进制编码（见ValueCodec.h）的十六进制文本，键不存在时返回nil，可以用RESTORE在其它节点上恢复。
+bool RedisHelper::dumpValue(std::string_view key,std::string&out){
+    auto node=redisDataBase->searchItem(key);
+    if(node==nullptr){
+        return false;
+    }
+    ValueCodec::encode(node->value,out);
+    return true;
+}
+
+void RedisHelper::dump(ReplyBuilder& reply,std::string_view key){
+    std::string data;
+    if(!dumpValue(key,data)){
+        return reply.nil();
+    }
+    reply.bulk(ValueCodec::toHex(data));
+}
+
+// 恢复DUMP得到的值
+// 语法：restore key ttl serialized-value [REPLACE]
+// 127.0.0.1:6379> restore user:1 0 0004746f6d
+// OK
+// 键已经存在且没有REPLACE时返回BUSYKEY错误。键没有过期时间，ttl只能是0。
+void RedisHelper::restore(ReplyBuilder& reply,std::string_view key,long long ttl,std::string_view serialized,bool replace){
+    if(ttl!=0){
+        return reply.error("Invalid TTL value, keys with expiration are not supported");
+    }
+    std::string data;
+    RedisValue value;
+    if(!ValueCodec::fromHex(serialized,data)||!ValueCodec::decode(data,value)){
+        return reply.error("DUMP payload version or checksum are wrong");
+    }
+    if(!replace&&redisDataBase->searchItem(key)!=nullptr){
+        return reply.error("BUSYKEY","Target key name already exists.");
+    }
+    store(key,value);
+    reply.status("OK");
+}
+
+void RedisHelper::encodeRecords(std::vector<std::string>&keys,std::string&payload){
+    size_t kept=0;
+    for(size_t i=0;i<keys.size();i++){
+        auto node=redisDataBase->searchItem(keys[i]);
+        if(node!=nullptr){
+            ValueCodec::appendRecord(payload,keys[i],node->value);
+            if(kept!=i){
+                keys[kept]=std::move(keys[i]);
+            }
+            kept++;
+        }
+    }
+    keys.resize(kept);
+}
+
+bool RedisHelper::restoreRecords(ReplyBuilder& reply,std::string_view payload,size_t count,bool replace,std::vector<std::string>&keys){
+    //先解码全部记录再写入，格式错误或键冲突时一个也不写
+    if(count>payload.size()){
+        reply.error("Bad data format in migration payload");
+        return false;
+    }
+    std::vector<std::pair<std::string,RedisValue>>records(count);
+    const char* pos=payload.data();
+    const char* end=payload.data()+payload.size();
+    for(auto& record:records){
+        if(!ValueCodec::readRecord(pos,end,record.first,record.second)){
+            reply.error("Bad data format in migration payload");
+            return false;
+        }
+    }
+    if(pos!=end){
+        reply.error("Bad data format in migration payload");
+        return false;
     }
-    return res;
+    if(!replace){
+        for(auto& record:records){
+            if(redisDataBase->searchItem(record.first)!=nullptr){
+                reply.error("BUSYKEY","Target key name already exists.");
+                return false;
+            }
+        }
+    }
+    for(auto& record:records){
+        store(record.first,record.second);
+        keys.push_back(std::move(record.first));
+    }
+    reply.status("OK");
+    return true;
 }
+
+bool RedisHelper::rangeKeys(std::string_view start,std::string_view end,size_t limit,std::vector<std::string>&keys){
+    KeyBound startBound,endBound;
+    if(!parseKeyBound(start,true,startBound)||!parseKeyBound(end,false,endBound)){
+        return false;
+    }
+    if(startBound.empty||endBound.empty){
+        return true;
+    }
+    auto node=startBound.unbounded?redisDataBase->getHead()->forward[0]
+             :startBound.inclusive?redisDataBase->lowerBound(startBound.key):redisDataBase->upperBound(startBound.key);
+    for(;node!=nullptr&&beforeEnd(node->key,endBound)&&keys.size()<limit;node=node->forward[0]){
+        keys.push_back(node->key);
+    }
+    return true;
+}
+
+std::string RedisHelper::scanKeys(std::string_view cursor,size_t count,const std::function<bool(const std::string&)>&match,std::vector<std::string>&keys){
+    std::string lastKey;
+    if(!decodeCursor(cursor,lastKey)){
+        return "";
+    }
+    auto node=cursor=="0"?redisDataBase->getHead()->forward[0]:redisDataBase->upperBound(lastKey);
+    for(size_t examined=0;node!=nullptr&&examined<count;node=node->forward[0],examined++){
+        lastKey=node->key;
+        if(match(node->key)){
+            keys.push_back(node->key);
+        }
+    }
+    return node==nullptr?"0":encodeCursor(lastKey);
+}
+
 // 获取键总数
 // 语法：dbsize
 // 127.0.0.1:6379> dbsize
 // (integer) 6
 // 获取键总数时不会遍历所有的键，直接获取内部变量，时间复杂度O(1)。
-std::string RedisHelper::dbsize()const{
-    std::string res="(integer) " +std::to_string(redisDataBase->size());
-    return res;
+void RedisHelper::dbsize(ReplyBuilder& reply)const{
+    reply.integer(redisDataBase->size());
 }
 // 查询键是否存在
 // 语法：exists key [key ...]
 // 127.0.0.1:6379> exists javastack java
 // (integer) 2
 // 查询查询多个，返回存在的个数。
-std::string RedisHelper::exists(const std::vector<std::string>&keys){
+void RedisHelper::exists(ReplyBuilder& reply,ArgSpan keys){
     int count=0;
     for(auto& key:keys){
         if(redisDataBase->searchItem(key)!=nullptr){
             count++;
         }
     }
-    std::string res="(integer) " +std::to_string(count);
-    return res;
+    reply.integer(count);
+}
+
+bool RedisHelper::hasKey(std::string_view key){
+    return redisDataBase->searchItem(key)!=nullptr;
 }
 // 删除键
 // 语法：del key [key ...]
 // 127.0.0.1:6379> del java javastack
 // (integer) 1
 // 可以删除多个，返回删除成功的个数。
-std::string RedisHelper::del(const std::vector<std::string>&keys){
+void RedisHelper::del(ReplyBuilder& reply,ArgSpan keys){
     int count=0;
     for(auto& key:keys){
         if(redisDataBase->deleteItem(key)){
             count++;
         }
     }
-        std::string res="(integer) " +std::to_string(count);
-    return res;
+    reply.integer(count);
 }
 
 // 更改键名称
 // 语法：rename key newkey
 // 127.0.0.1:6379[2]> rename javastack javastack123
 // OK
-std::string RedisHelper::rename(const std::string&oldName,const std::string&newName){
+void RedisHelper::rename(ReplyBuilder& reply,std::string_view oldName,std::string_view newName){
     auto currentNode=redisDataBase->searchItem(oldName);
-    std::string resMessage="";
     if(currentNode==nullptr){
-        resMessage+=oldName+" does not exist!";
-        return resMessage;
+        return reply.error(std::string(oldName)+" does not exist!");
+    }
+    if(oldName==newName){
+        return reply.status("OK");
     }
-    currentNode->key=newName;
-    resMessage="OK";
-    return resMessage;
+    //直接修改节点的key会破坏跳表的有序性，需要删除后按新键重新插入
+    RedisValue value=currentNode->value;
+    redisDataBase->deleteItem(oldName);
+    redisDataBase->deleteItem(newName);
+    redisDataBase->addItem(std::string(newName),value);
+    reply.status("OK");
 }
 
 // 字符串操作命令
 // 存放键值
 // 语法：set key value [EX seconds] [PX milliseconds] [NX|XX]
 // nx：如果key不存在则建立，xx：如果key存在则修改其值，也可以直接使用setnx/setex命令。
-std::string RedisHelper::set(const std::string& key, const RedisValue& value,const SET_MODEL model){
-    
-    if(model==XX){
-        return setex(key,value);
-    }else if(model==NX){
-        return setnx(key,value);
+// 条件不满足时不写入，返回(nil)。
+bool RedisHelper::store(std::string_view key, const RedisValue& value,const SET_MODEL model){
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        if(model==XX){
+            return false;
+        }
+        redisDataBase->addItem(std::string(key),value);
     }else{
-        auto currentNode=redisDataBase->searchItem(key);
-        if(currentNode==nullptr){
-            setnx(key,value);
-        }else{
-            setex(key,value);
+        if(model==NX){
+            return false;
         }
+        currentNode->value=value;
     }
-    
-    return "OK";
+    return true;
 }
 
-std::string RedisHelper::setnx(const std::string& key, const RedisValue& value){
-    auto currentNode=redisDataBase->searchItem(key);
-    if(currentNode!=nullptr){
-        return "key: "+ key +"  exists!";
-    }else{
-        redisDataBase->addItem(key,value);
-        
+void RedisHelper::set(ReplyBuilder& reply,std::string_view key, const RedisValue& value,const SET_MODEL model){
+    if(!store(key,value,model)){
+        return reply.nil();
     }
-    return "OK";
+    reply.status("OK");
 }
-std::string RedisHelper::setex(const std::string& key, const RedisValue& value){
-    auto currentNode=redisDataBase->searchItem(key);
-    if(currentNode==nullptr){
-        return "key: "+ key +" does not exist!";
-    }else{
-        currentNode->value=value;
-    }
-    return "OK";
+
+void RedisHelper::setnx(ReplyBuilder& reply,std::string_view key, const RedisValue& value){
+    set(reply,key,value,NX);
+}
+void RedisHelper::setex(ReplyBuilder& reply,std::string_view key, const RedisValue& value){
+    set(reply,key,value,XX);
 }
 // 127.0.0.1:6379> set javastack 666
 // OK
@@ -173,13 +514,16 @@ std::string RedisHelper::setex(const std::string& key, const RedisValue& value){
 // 语法：get key
 // 127.0.0.1:6379[2]> get javastack
 // "666"
-std::string RedisHelper::get(const std::string&key){
+// 值直接从节点拷贝到回复缓冲区，不做任何转换
+void RedisHelper::get(ReplyBuilder& reply,std::string_view key){
     auto currentNode=redisDataBase->searchItem(key);
     if(currentNode==nullptr){
-        return "key: "+ key +" does not exist!";
+        return reply.nil();
     }
-    return currentNode->value.dump();
-
+    if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
+    }
+    reply.bulk(currentNode->value.stringValue());
 }
 // 值递增/递减
 // 如果字符串中的值是数字类型的，可以使用incr命令每次递增，不是数字类型则报错。
@@ -188,77 +532,69 @@ std::string RedisHelper::get(const std::string&key){
 // 127.0.0.1:6379[2]> incr javastack
 // (integer) 667
 // 一次想递增N用incrby命令，如果是浮点型数据可以用incrbyfloat命令递增。
-std::string RedisHelper::incr(const std::string& key){
-    return incrby(key,1);
+void RedisHelper::incr(ReplyBuilder& reply,std::string_view key){
+    incrby(reply,key,1);
 }
-std::string RedisHelper::incrby(const std::string& key,int increment){
+void RedisHelper::incrby(ReplyBuilder& reply,std::string_view key,int increment){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string value="";
     if(currentNode==nullptr){
-        value=std::to_string(increment);
-        redisDataBase->addItem(key,value);
-        return "(integer) "+value;
+        redisDataBase->addItem(std::string(key),std::to_string(increment));
+        return reply.integer(increment);
     }
-    value=currentNode->value.dump();
-    //去掉双引号
-    value.erase(0, 1); 
-    value.erase(value.size()-1);
-    for(char ch:value){
-        if(!isdigit(ch)){
-            std::string res="The value of "+key +" is not a numeric type";
-            return res;
-        }
+    if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
+    }
+    std::string& value=currentNode->value.stringValue();
+    long long curValue=0;
+    if(!parseInteger(value,curValue)){
+        return reply.error("The value of "+std::string(key) +" is not a numeric type");
+    }
+    if(__builtin_add_overflow(curValue,static_cast<long long>(increment),&curValue)){
+        return reply.error("increment or decrement would overflow");
     }
-    int curValue=std::stoi(value)+increment;
     value=std::to_string(curValue);
-    currentNode->value=value;
-    std::string res="(integer) "+value;
-    return res;
+    reply.integer(curValue);
 }
-std::string RedisHelper::incrbyfloat(const std::string&key,double increment){
+// 与Redis一致，浮点数结果以字符串返回
+void RedisHelper::incrbyfloat(ReplyBuilder& reply,std::string_view key,double increment){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string value="";
     if(currentNode==nullptr){
-        value=std::to_string(increment);
-        redisDataBase->addItem(key,value);
-        return "(float) "+value;
+        std::string value=std::to_string(increment);
+        reply.bulk(value);
+        redisDataBase->addItem(std::string(key),std::move(value));
+        return;
+    }
+    if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
     }
-    value=currentNode->value.dump();
-    value.erase(0, 1); 
-    value.erase(value.size()-1);
+    std::string& value=currentNode->value.stringValue();
     double curValue=0.0;
-    try {
-        curValue = std::stod(value)+increment;
-    } catch (std::invalid_argument const &e) {
-        return "The value of "+key +" is not a numeric type";
-    } 
-    value=std::to_string(curValue);
-    currentNode->value=value;
-    std::string res="(float) "+value;
-    return res;
+    if(!parseDouble(value,curValue)){
+        return reply.error("The value of "+std::string(key) +" is not a numeric type");
+    }
+    value=std::to_string(curValue+increment);
+    reply.bulk(value);
 }
 // 同样，递减使用decr、decrby命令。
-std::string RedisHelper::decr(const std::string&key){
-    return incrby(key,-1);
+void RedisHelper::decr(ReplyBuilder& reply,std::string_view key){
+    incrby(reply,key,-1);
 }
-std::string RedisHelper::decrby(const std::string&key,int increment){
-    return incrby(key,-increment);
+void RedisHelper::decrby(ReplyBuilder& reply,std::string_view key,int increment){
+    incrby(reply,key,-increment);
 }
 // 批量存放键值
 // 语法：mset key value [key value ...]
 // 127.0.0.1:6379[2]> mset java1 1 java2 2 java3 3
 // OK
 
-std::string RedisHelper::mset(std::vector<std::string>&items){
+void RedisHelper::mset(ReplyBuilder& reply,ArgSpan items){
     if(items.size()%2!=0){
-        return "wrong number of arguments for MSET.";
+        return reply.error("wrong number of arguments for MSET.");
     }
-    for(int i=0;i<items.size();i+=2){
-        std::string key=items[i];
-        std::string value=items[i+1];
-        set(key,value);
+    for(size_t i=0;i<items.size();i+=2){
+        store(items[i],RedisValue(std::string(items[i+1])));
     }
-    return "OK";
+    reply.status("OK");
 }
 // 获取获取键值
 // 语法：mget key [key ...]
@@ -266,56 +602,55 @@ std::string RedisHelper::mset(std::vector<std::string>&items){
 // 1) "1"
 // 2) "2"
 // Redis接收的是UTF-8的编码，如果是中文一个汉字将占3位返回。
-std::string RedisHelper::mget(std::vector<std::string>&keys){
+void RedisHelper::mget(ReplyBuilder& reply,ArgSpan keys){
     if(keys.size()==0){
-        return "wrong number of arguments for MGET.";
+        return reply.error("wrong number of arguments for MGET.");
     }
-    std::vector<std::string>values;
-    std::string res="";
-    for(int i=0;i<keys.size();i++){
-        std::string& key=keys[i];
-        std::string value="";
+    reply.arrayHeader(keys.size());
+    for(auto& key:keys){
         auto currentNode=redisDataBase->searchItem(key);
-        if(currentNode==nullptr){
-            value="(nil)";
-            res+=std::to_string(i+1)+") "+value+"\n";
+        if(currentNode==nullptr||currentNode->value.type()!=RedisValue::STRING){
+            reply.nil();
         }else{
-            value=currentNode->value.dump();
-            res+=std::to_string(i+1)+") "+value+"\n";
+            reply.bulk(currentNode->value.stringValue());
         }
-        
     }
-    res.pop_back();
-    return res;
 }
 // 获取值长度
 // 语法：strlen key
 // 127.0.0.1:6379[2]> strlen javastack (integer) 3
-std::string RedisHelper::strlen(const std::string& key){
+void RedisHelper::strlen(ReplyBuilder& reply,std::string_view key){
     auto currentNode=redisDataBase->searchItem(key);
     if(currentNode==nullptr){
-        return "(integer) 0";
+        return reply.integer(0);
+    }
+    if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
     }
-    return "(integer) "+std::to_string(currentNode->value.dump().size());
+    reply.integer(currentNode->value.stringValue().size());
 }
 // 追加内容
 // 语法：append key value
 // 127.0.0.1:6379[2]> append javastack hi
 // (integer) 5
 // 向键值尾部添加，如上命令执行后由666变成666hi
-std::string RedisHelper::append(const std::string&key,const std::string &value){
+void RedisHelper::append(ReplyBuilder& reply,std::string_view key,std::string_view value){
     auto currentNode=redisDataBase->searchItem(key);
     if(currentNode==nullptr){
-        redisDataBase->addItem(key,value);
-        return "(integer) "+std::to_string(value.size());
+        redisDataBase->addItem(std::string(key),RedisValue(std::string(value)));
+        return reply.integer(value.size());
+    }
+    if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
     }
-    currentNode->value=currentNode->value.dump()+value;
-    return "(integer) "+std::to_string(currentNode->value.dump().size());
+    std::string& bytes=currentNode->value.stringValue(); //原地追加，不重新构造整个值
+    bytes.append(value.data(),value.size());
+    reply.integer(bytes.size());
 }
 
 
-RedisHelper::RedisHelper(){
-    FileCreator::createFolderAndFiles(DEFAULT_DB_FOLDER,DATABASE_FILE_NAME,DATABASE_FILE_NUMBER);
+RedisHelper::RedisHelper(const std::string& dataFolder):dataFolder(dataFolder){
+    FileCreator::createFolderAndFiles(dataFolder,DATABASE_FILE_NAME,DATABASE_FILE_NUMBER);
     std::string filePath=getFilePath();
     loadData(filePath);
 }
@@ -328,112 +663,156 @@ RedisHelper::~RedisHelper(){flush();}
 // LPOP key：移出并获取列表的第一个元素。
 // RPOP key：移出并获取列表的最后一个元素。
 // LRANGE key start stop：获取列表指定范围内的元素。
-std::string RedisHelper::lpush(const std::string&key,const std::string &value){
+void RedisHelper::lpush(ReplyBuilder& reply,std::string_view key,std::string_view value){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
     int size = 0;
     if(currentNode==nullptr){
         std::vector<RedisValue>data;
         RedisValue redisList(data) ;
         RedisValue::array& valueList = redisList.arrayItems();
-        valueList.insert(valueList.begin(),value);
-        redisDataBase->addItem(key,redisList);
+        valueList.insert(valueList.begin(),RedisValue(std::string(value)));
+        redisDataBase->addItem(std::string(key),redisList);
         size = 1;
     }else{
         if(currentNode->value.type()!=RedisValue::ARRAY){
-            resMessage="The key:" +key+" "+"already exists and the value is not a list!";
-            return resMessage;
+            return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a list!");
         }else{
             RedisValue::array& valueList = currentNode->value.arrayItems();
-            valueList.insert(valueList.begin(),value);
+            valueList.insert(valueList.begin(),RedisValue(std::string(value)));
             size = valueList.size();
         }
     }
 
-    resMessage="(integer) "+std::to_string(size);
-    return resMessage;
+    reply.integer(size);
 }
-std::string RedisHelper::rpush(const std::string&key,const std::string &value){
+void RedisHelper::rpush(ReplyBuilder& reply,std::string_view key,std::string_view value){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
     int size = 0;
     if(currentNode==nullptr){
         std::vector<RedisValue>data;
         RedisValue redisList(data) ;
         RedisValue::array& valueList = redisList.arrayItems();
-        valueList.push_back(value);
-        redisDataBase->addItem(key,redisList);
+        valueList.push_back(RedisValue(std::string(value)));
+        redisDataBase->addItem(std::string(key),redisList);
         size = 1;
     }else{
         if(currentNode->value.type()!=RedisValue::ARRAY){
-            resMessage="The key:" +key+" "+"already exists and the value is not a list!";
-            return resMessage;
+            return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a list!");
         }else{
             RedisValue::array& valueList = currentNode->value.arrayItems();
-            valueList.push_back(value);
+            valueList.push_back(RedisValue(std::string(value)));
             size = valueList.size();
         }
     }
 
-    resMessage="(integer) "+std::to_string(size);
-    return resMessage;
+    reply.integer(size);
 }
-std::string RedisHelper::lpop(const std::string&key){
+void RedisHelper::lpop(ReplyBuilder& reply,std::string_view key){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int size = 0;
-    if(currentNode==nullptr||currentNode->value.type()!=RedisValue::ARRAY){
-        resMessage="(nil)";
+    if(currentNode==nullptr||currentNode->value.type()!=RedisValue::ARRAY||currentNode->value.arrayItems().empty()){
+        reply.nil();
     }else{
-        
         RedisValue::array& valueList = currentNode->value.arrayItems();
-        resMessage = (*valueList.begin()).dump();
+        reply.bulk(valueList.front().stringValue()); //先写入回复再删除元素
         valueList.erase(valueList.begin());
-        resMessage.erase(0,1);
-        resMessage.erase(resMessage.size()-1);
     }
-    return resMessage;
 }
-std::string RedisHelper::rpop(const std::string&key){
+void RedisHelper::rpop(ReplyBuilder& reply,std::string_view key){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int size = 0;
-    if(currentNode==nullptr||currentNode->value.type()!=RedisValue::ARRAY){
-        resMessage="(nil)";
+    if(currentNode==nullptr||currentNode->value.type()!=RedisValue::ARRAY||currentNode->value.arrayItems().empty()){
+        reply.nil();
     }else{
         RedisValue::array& valueList = currentNode->value.arrayItems();
-        resMessage = (valueList.back()).dump();
+        reply.bulk(valueList.back().stringValue());
         valueList.pop_back();
-        resMessage.erase(0,1);
-        resMessage.erase(resMessage.size()-1);
     }
-    return resMessage;
 }
-std::string RedisHelper::lrange(const std::string&key,const std::string &start,const std::string&end){
+void RedisHelper::lrange(ReplyBuilder& reply,std::string_view key,int start,int end){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int size = 0;
-    if(currentNode==nullptr||currentNode->value.type()!=RedisValue::ARRAY){
-        resMessage="(nil)";
-    }else{
-        
+    if(currentNode==nullptr){
+        return reply.arrayHeader(0);
+    }
+    if(currentNode->value.type()!=RedisValue::ARRAY){
+        return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a list!");
+    }
+    RedisValue::array& valueList = currentNode->value.arrayItems();
+    int left = std::max(start,0);
+    int right = std::min(end,int(valueList.size())-1);
+    if(right<left){
+        return reply.arrayHeader(0);
+    }
+    reply.arrayHeader(right-left+1);
+    for(int i=left;i<=right;i++){
+        reply.bulk(valueList[i].stringValue());
+    }
+}
+bool RedisHelper::popFirst(ReplyBuilder& reply,ArgSpan keys,bool left){
+    for(auto& key:keys){
+        auto currentNode=redisDataBase->searchItem(key);
+        if(currentNode==nullptr){
+            continue;
+        }
+        if(currentNode->value.type()!=RedisValue::ARRAY){
+            reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a list!");
+            return true;
+        }
         RedisValue::array& valueList = currentNode->value.arrayItems();
-        int left = std::stoi(start);
-        int right = std::stoi(end);
-        left = std::max(left,0);
-        right = std::min(right,int(valueList.size()-1));
-        if(right<left||left>=valueList.size()){
-            resMessage="(empty list or set)";
-        }
-        for(int i=left;i<=right;i++){
-            auto item = valueList[i];
-            resMessage+=std::to_string(i+1)+") "+item.dump();
-            if(i!=right){
-                resMessage+="\n";
-            }
+        if(valueList.empty()){
+            continue;
         }
+        reply.arrayHeader(2);
+        reply.bulk(key);
+        if(left){
+            reply.bulk(valueList.front().stringValue());
+            valueList.erase(valueList.begin());
+        }else{
+            reply.bulk(valueList.back().stringValue());
+            valueList.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+bool RedisHelper::move(ReplyBuilder& reply,std::string_view source,std::string_view destination,bool fromLeft,bool toLeft){
+    auto sourceNode=redisDataBase->searchItem(source);
+    if(sourceNode==nullptr){
+        return false;
+    }
+    if(sourceNode->value.type()!=RedisValue::ARRAY){
+        reply.error("The key:" +std::string(source)+" "+"already exists and the value is not a list!");
+        return true;
     }
-    return resMessage;
+    if(sourceNode->value.arrayItems().empty()){
+        return false;
+    }
+    //先检查目标的类型，出错时源列表保持不变
+    auto destinationNode=redisDataBase->searchItem(destination);
+    if(destinationNode!=nullptr&&destinationNode->value.type()!=RedisValue::ARRAY){
+        reply.error("The key:" +std::string(destination)+" "+"already exists and the value is not a list!");
+        return true;
+    }
+    RedisValue::array& sourceList = sourceNode->value.arrayItems();
+    RedisValue value;
+    if(fromLeft){
+        value=std::move(sourceList.front());
+        sourceList.erase(sourceList.begin());
+    }else{
+        value=std::move(sourceList.back());
+        sourceList.pop_back();
+    }
+    reply.bulk(value.stringValue());
+    //source和destination相同时destinationNode就是sourceNode，元素从一端转到另一端
+    if(destinationNode==nullptr){
+        redisDataBase->addItem(std::string(destination),RedisValue(RedisValue::array{std::move(value)}));
+        return true;
+    }
+    RedisValue::array& destinationList = destinationNode->value.arrayItems();
+    if(toLeft){
+        destinationList.insert(destinationList.begin(),std::move(value));
+    }else{
+        destinationList.push_back(std::move(value));
+    }
+    return true;
 }
 
 // 哈希表操作
@@ -442,125 +821,572 @@ std::string RedisHelper::lrange(const std::string&key,const std::string &start,c
 // HDEL key field：删除哈希表 key 中的一个或多个指定字段。
 // HKEYS key：获取哈希表中的所有字段名。
 // HVALS key：获取哈希表中的所有值。
+// HSCAN key cursor [MATCH pattern] [COUNT count]：增量遍历哈希表的字段。
 
 
-std::string RedisHelper::hset(const std::string&key,const std::vector<std::string>&filed){
+void RedisHelper::hset(ReplyBuilder& reply,std::string_view key,ArgSpan filed){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
     int count = 0;
     if(currentNode==nullptr){
-        std::map<std::string,RedisValue>data;
+        RedisValue::object data;
         RedisValue redisHash(data) ;
         RedisValue::object& valueMap = redisHash.objectItems();
-        for(int i=0;i<filed.size();i+=2){
-            std::string hkey=filed[i];
-            RedisValue hval=filed[i+1];
-            if(!valueMap.count(hkey)){
-                valueMap[hkey] = hval;
+        for(size_t i=0;i<filed.size();i+=2){
+            if(valueMap.find(filed[i])==valueMap.end()){
+                valueMap.emplace(std::string(filed[i]),RedisValue(std::string(filed[i+1])));
                 count++;
             }
         }
-        redisDataBase->addItem(key,valueMap);
+        redisDataBase->addItem(std::string(key),valueMap);
     }else{
         if(currentNode->value.type()!=RedisValue::OBJECT){
-            resMessage="The key:" +key+" "+"already exists and the value is not a hashtable!";
-            return resMessage;
+            return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a hashtable!");
         }else{
             RedisValue::object& valueMap = currentNode->value.objectItems();
-            for(int i=0;i<filed.size();i+=2){
-                std::string hkey=filed[i];
-                RedisValue hval=filed[i+1];
-                if(!valueMap.count(hkey)){
-                    valueMap[hkey] = hval;
+            for(size_t i=0;i<filed.size();i+=2){
+                if(valueMap.find(filed[i])==valueMap.end()){
+                    valueMap.emplace(std::string(filed[i]),RedisValue(std::string(filed[i+1])));
                     count++;
                 }
             }
         }
     }
 
-    resMessage="(integer) "+std::to_string(count);
-    return resMessage;
+    reply.integer(count);
 }
-std::string RedisHelper::hget(const std::string&key,const std::string&filed){
+void RedisHelper::hget(ReplyBuilder& reply,std::string_view key,std::string_view filed){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int count = 0;
     if(currentNode==nullptr||currentNode->value.type()!=RedisValue::OBJECT){
-        resMessage="(nil)";
-    }else{
-        RedisValue::object& valueMap = currentNode->value.objectItems();
-        if(!valueMap.count(filed)){
-            resMessage="(nil)";
-        }else{
-            resMessage = valueMap[filed].stringValue();
-        }
-        
+        return reply.nil();
+    }
+    RedisValue::object& valueMap = currentNode->value.objectItems();
+    auto it=valueMap.find(filed);
+    if(it==valueMap.end()){
+        return reply.nil();
     }
-    return resMessage;
+    reply.bulk(it->second.stringValue());
 }
-std::string RedisHelper::hdel(const std::string&key,const std::vector<std::string>&filed){
+void RedisHelper::hdel(ReplyBuilder& reply,std::string_view key,ArgSpan filed){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
     int count = 0;
     if(currentNode==nullptr||currentNode->value.type()!=RedisValue::OBJECT){
         count = 0;
     }else{
         RedisValue::object& valueMap = currentNode->value.objectItems();
         for(auto& hkey:filed){
-            if(valueMap.count(hkey)){
+            auto it=valueMap.find(hkey);
+            if(it!=valueMap.end()){
                 count++;
-                valueMap.erase(hkey);
+                valueMap.erase(it);
             }
         }
     }
-    resMessage="(integer) "+std::to_string(count);
-    return resMessage;
+    reply.integer(count);
 }
 
-std::string RedisHelper::hkeys(const std::string&key){
+void RedisHelper::hkeys(ReplyBuilder& reply,std::string_view key){
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        return reply.arrayHeader(0);
+    }
+    if(currentNode->value.type()!=RedisValue::OBJECT){
+        return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a hashtable!");
+    }
+    RedisValue::object& valueMap = currentNode->value.objectItems();
+    reply.arrayHeader(valueMap.size());
+    for(auto& hkey:valueMap){
+        reply.bulk(hkey.first);
+    }
+}
+
+void RedisHelper::hvals(ReplyBuilder& reply,std::string_view key){
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        return reply.arrayHeader(0);
+    }
+    if(currentNode->value.type()!=RedisValue::OBJECT){
+        return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a hashtable!");
+    }
+    RedisValue::object& valueMap = currentNode->value.objectItems();
+    reply.arrayHeader(valueMap.size());
+    for(auto& hkey:valueMap){
+        reply.bulk(hkey.second.stringValue());
+    }
+}
+
+// 位图操作
+// 位图直接作用于字符串值的原始字节（stringValue），而不是dump()产生的转义文本。
+// 偏移量从字节的最高位开始计数，与Redis保持一致。
+
+// 将[start,end]字节范围（支持负数下标）规整到[0,len-1]内，范围为空时返回false
+static bool normalizeByteRange(long long& start,long long& end,long long len){
+    if(start<0) start=len+start;
+    if(end<0) end=len+end;
+    if(start<0) start=0;
+    if(end<0) end=0;
+    if(end>=len) end=len-1;
+    return len>0&&start<=end;
+}
+
+// 语法：setbit key offset value
+// 127.0.0.1:6379> setbit mykey 7 1
+// (integer) 0
+// 字符串长度不足时自动用0补齐。
+void RedisHelper::setbit(ReplyBuilder& reply,std::string_view key,long long offset,int value){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int count = 0;
     if(currentNode==nullptr){
-        resMessage="The key:" +key+" "+"does not exist!";
-        return resMessage;
+        redisDataBase->addItem(std::string(key),std::string());
+        currentNode=redisDataBase->searchItem(key);
+    }else if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
+    }
+    std::string& bitmap=currentNode->value.stringValue();
+    size_t byteIndex=offset>>3;
+    if(byteIndex>=bitmap.size()){
+        bitmap.resize(byteIndex+1,'\0');
+    }
+    uint8_t mask=1<<(7-(offset&7));
+    uint8_t byte=static_cast<uint8_t>(bitmap[byteIndex]);
+    int oldBit=(byte&mask)?1:0;
+    byte=value?(byte|mask):(byte&~mask);
+    bitmap[byteIndex]=static_cast<char>(byte);
+    reply.integer(oldBit);
+}
+
+// 语法：getbit key offset
+// 127.0.0.1:6379> getbit mykey 7
+// (integer) 1
+void RedisHelper::getbit(ReplyBuilder& reply,std::string_view key,long long offset){
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        return reply.integer(0);
+    }
+    if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
+    }
+    const std::string& bitmap=currentNode->value.stringValue();
+    size_t byteIndex=offset>>3;
+    if(byteIndex>=bitmap.size()){
+        return reply.integer(0);
+    }
+    uint8_t byte=static_cast<uint8_t>(bitmap[byteIndex]);
+    reply.integer((byte>>(7-(offset&7)))&1);
+}
+
+// 语法：bitcount key [start end]
+// 127.0.0.1:6379> bitcount mykey 0 -1
+// (integer) 1
+// start和end是字节下标，支持负数。
+void RedisHelper::bitcount(ReplyBuilder& reply,std::string_view key,long long start,long long end){
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        return reply.integer(0);
+    }
+    if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
+    }
+    const std::string& bitmap=currentNode->value.stringValue();
+    if(!normalizeByteRange(start,end,bitmap.size())){
+        return reply.integer(0);
+    }
+    const uint8_t* data=reinterpret_cast<const uint8_t*>(bitmap.data());
+    reply.integer(Bitmap::popcount(data+start,end-start+1));
+}
+
+// 语法：bitpos key bit [start [end]]
+// 127.0.0.1:6379> bitpos mykey 1
+// (integer) 7
+// 查找0时如果没有指定end且范围内全为1，则认为字符串右侧补了无限个0，返回范围之后的第一个位。
+void RedisHelper::bitpos(ReplyBuilder& reply,std::string_view key,int bit,long long start,long long end,bool endGiven){
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        return reply.integer(bit?-1:0);
+    }
+    if(currentNode->value.type()!=RedisValue::STRING){
+        return reply.error(NOT_A_STRING(key));
+    }
+    const std::string& bitmap=currentNode->value.stringValue();
+    if(!normalizeByteRange(start,end,bitmap.size())){
+        return reply.integer(-1);
+    }
+    const uint8_t* data=reinterpret_cast<const uint8_t*>(bitmap.data());
+    long long pos=Bitmap::findFirstBit(data,start,end,bit);
+    if(pos==-1&&bit==0&&!endGiven){
+        pos=(end+1)*8;
+    }
+    reply.integer(pos);
+}
+
+// 语法：bitop operation destkey key [key ...]
+// 127.0.0.1:6379> bitop and dest key1 key2
+// (integer) 3
+// 返回结果的字节长度，不存在的键视为空字符串，结果为空时删除destkey。
+void RedisHelper::bitop(ReplyBuilder& reply,BITOP_TYPE op,std::string_view destKey,ArgSpan keys){
+    std::string empty;
+    std::vector<std::shared_ptr<SkipListNode<std::string,RedisValue>>>nodes; //持有节点，保证运算期间源数据有效
+    std::vector<const std::string*>sources;
+    for(auto& key:keys){
+        auto currentNode=redisDataBase->searchItem(key);
+        if(currentNode==nullptr){
+            sources.push_back(&empty);
+            continue;
+        }
+        if(currentNode->value.type()!=RedisValue::STRING){
+            return reply.error(NOT_A_STRING(key));
+        }
+        nodes.push_back(currentNode);
+        sources.push_back(&currentNode->value.stringValue());
+    }
+    std::string result=Bitmap::bitop(op,sources);
+    size_t length=result.size();
+    if(length==0){
+        redisDataBase->deleteItem(destKey);
     }else{
-        if(currentNode->value.type()!=RedisValue::OBJECT){
-            resMessage="The key:" +key+" "+"already exists and the value is not a hashtable!";
-            return resMessage;
+        store(destKey,RedisValue(std::move(result)));
+    }
+    reply.integer(length);
+}
+
+
+// HyperLogLog操作
+// HyperLogLog以字符串值保存，稀疏编码时只有几十字节，稠密编码固定为12KB。
+#define HLL_WRONG_TYPE "Key is not a valid HyperLogLog string value."
+
+// 语法：pfadd key element [element ...]
+// 127.0.0.1:6379> pfadd visitors alice bob
+// (integer) 1
+// 至少有一个寄存器被修改（或新建了键）时返回1，否则返回0。
+void RedisHelper::pfadd(ReplyBuilder& reply,std::string_view key,ArgSpan elements){
+    auto currentNode=redisDataBase->searchItem(key);
+    bool updated=false;
+    if(currentNode==nullptr){
+        redisDataBase->addItem(std::string(key),HyperLogLog::create());
+        currentNode=redisDataBase->searchItem(key);
+        updated=true;
+    }else if(currentNode->value.type()!=RedisValue::STRING||!HyperLogLog::isValid(currentNode->value.stringValue())){
+        return reply.error("WRONGTYPE",HLL_WRONG_TYPE);
+    }
+    std::string& hll=currentNode->value.stringValue();
+    for(auto& element:elements){
+        if(HyperLogLog::add(hll,element.data(),element.size())){
+            updated=true;
+        }
+    }
+    reply.integer(updated?1:0);
+}
+
+// 语法：pfcount key [key ...]
+// 127.0.0.1:6379> pfcount visitors
+// (integer) 2
+// 单个键时使用并更新头部缓存的基数；多个键时先在临时寄存器中合并再估算。
+void RedisHelper::pfcount(ReplyBuilder& reply,ArgSpan keys){
+    if(keys.size()==1){
+        auto currentNode=redisDataBase->searchItem(keys[0]);
+        if(currentNode==nullptr){
+            return reply.integer(0);
+        }
+        if(currentNode->value.type()!=RedisValue::STRING||!HyperLogLog::isValid(currentNode->value.stringValue())){
+            return reply.error("WRONGTYPE",HLL_WRONG_TYPE);
+        }
+        //跳表不加锁时（副本读视图）可能有多个线程同时读这个值，不能写回缓存
+        std::string& hll=currentNode->value.stringValue();
+        return reply.integer(locking?HyperLogLog::count(hll):HyperLogLog::peekCount(hll));
+    }
+    std::vector<uint8_t>registers(HLL_REGISTERS,0);
+    for(auto& key:keys){
+        auto currentNode=redisDataBase->searchItem(key);
+        if(currentNode==nullptr){
+            continue;
+        }
+        if(currentNode->value.type()!=RedisValue::STRING||!HyperLogLog::isValid(currentNode->value.stringValue())){
+            return reply.error("WRONGTYPE",HLL_WRONG_TYPE);
+        }
+        HyperLogLog::mergeInto(registers.data(),currentNode->value.stringValue());
+    }
+    reply.integer(HyperLogLog::estimate(registers.data()));
+}
+
+// 语法：pfmerge destkey sourcekey [sourcekey ...]
+// 127.0.0.1:6379> pfmerge all visitors1 visitors2
+// OK
+// destkey已存在时也参与合并。
+void RedisHelper::pfmerge(ReplyBuilder& reply,std::string_view destKey,ArgSpan keys){
+    std::vector<uint8_t>registers(HLL_REGISTERS,0);
+    for(size_t i=0;i<=keys.size();i++){
+        auto currentNode=redisDataBase->searchItem(i<keys.size()?keys[i]:destKey);
+        if(currentNode==nullptr){
+            continue;
+        }
+        if(currentNode->value.type()!=RedisValue::STRING||!HyperLogLog::isValid(currentNode->value.stringValue())){
+            return reply.error("WRONGTYPE",HLL_WRONG_TYPE);
+        }
+        HyperLogLog::mergeInto(registers.data(),currentNode->value.stringValue());
+    }
+    store(destKey,RedisValue(HyperLogLog::fromRegisters(registers.data())));
+    reply.status("OK");
+}
+
+
+// Stream操作
+// 消息保存在Stream的打包块中（见RedisValue/Stream.h），追加只写尾块，范围读取顺序扫描。
+
+// 回复消息列表：[[id, [field value ...]] ...]
+static void replyStreamEntries(ReplyBuilder& reply,const std::vector<StreamEntry>&entries){
+    reply.arrayHeader(entries.size());
+    for(auto& entry:entries){
+        reply.arrayHeader(2);
+        reply.bulk(entry.id.toString());
+        reply.arrayHeader(entry.fields.size());
+        for(auto& field:entry.fields){
+            reply.bulk(field);
+        }
+    }
+}
+
+// 解析范围边界：-和+表示最小和最大ID，"("开头表示不包含该ID
+static bool parseRangeID(std::string_view text,bool isStart,StreamID&id){
+    if(text=="-"){
+        id=StreamID::min();
+        return true;
+    }
+    if(text=="+"){
+        id=StreamID::max();
+        return true;
+    }
+    bool exclusive=!text.empty()&&text[0]=='(';
+    std::string_view idText=exclusive?text.substr(1):text;
+    if(!StreamID::parse(idText,id,isStart?0:UINT64_MAX)){
+        return false;
+    }
+    if(exclusive){
+        if(isStart){
+            if(id==StreamID::max()) return false;
+            id=id.seq==UINT64_MAX?StreamID(id.ms+1,0):StreamID(id.ms,id.seq+1);
         }else{
-            RedisValue::object& valueMap = currentNode->value.objectItems();
-            int index = 1;
-            for(auto hkey:valueMap){
-                resMessage+=std::to_string(index)+") "+hkey.first+"\n";
-                index++;
-            }
-            resMessage.erase(resMessage.size()-1);
+            if(id==StreamID::min()) return false;
+            id=id.seq==0?StreamID(id.ms-1,UINT64_MAX):StreamID(id.ms,id.seq-1);
         }
     }
-    return resMessage;
+    return true;
 }
 
-std::string RedisHelper::hvals(const std::string&key){
+// 裁剪阈值：MAXLEN为消息数，MINID为最小保留ID
+struct TrimThreshold{
+    STREAM_TRIM_MODEL model=TRIM_NONE;
+    bool approx=false;
+    long long maxLen=0;
+    StreamID minId;
+};
+
+static bool parseTrimThreshold(STREAM_TRIM_MODEL trimModel,bool approx,std::string_view threshold,TrimThreshold&trim){
+    trim.model=trimModel;
+    trim.approx=approx;
+    if(trimModel==TRIM_MAXLEN){
+        return parseInteger(threshold,trim.maxLen)&&trim.maxLen>=0;
+    }
+    if(trimModel==TRIM_MINID){
+        return StreamID::parse(threshold,trim.minId);
+    }
+    return true;
+}
+
+static size_t trimStream(Stream&stream,const TrimThreshold&trim){
+    if(trim.model==TRIM_MAXLEN){
+        return stream.trimMaxLen(trim.maxLen,trim.approx);
+    }
+    if(trim.model==TRIM_MINID){
+        return stream.trimMinID(trim.minId,trim.approx);
+    }
+    return 0;
+}
+
+// 语法：xadd key [NOMKSTREAM] [MAXLEN|MINID [=|~] threshold] *|id field value [field value ...]
+// 127.0.0.1:6379> xadd mystream * sensor 1234 temperature 19.8
+// "1518951480106-0"
+// id为*时使用当前毫秒时间自动生成，也可以写成ms-*只自动生成序号。
+void RedisHelper::xadd(ReplyBuilder& reply,std::string_view key,std::string_view id,ArgSpan fields,
+                       bool noMkStream,STREAM_TRIM_MODEL trimModel,bool approx,std::string_view threshold){
     auto currentNode=redisDataBase->searchItem(key);
-    std::string resMessage = "";
-    int count = 0;
     if(currentNode==nullptr){
-        resMessage="The key:" +key+" "+"does not exist!";
-        return resMessage;
-    }else{
-        if(currentNode->value.type()!=RedisValue::OBJECT){
-            resMessage="The key:" +key+" "+"already exists and the value is not a hashtable!";
-            return resMessage;
-        }else{
-            RedisValue::object& valueMap = currentNode->value.objectItems();
-            int index = 1;
-            for(auto hkey:valueMap){
-                resMessage+=std::to_string(index)+") "+hkey.second.stringValue()+"\n";
-                index++;
+        if(noMkStream){
+            return reply.nil();
+        }
+    }else if(currentNode->value.type()!=RedisValue::STREAM){
+        return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a stream!");
+    }
+    Stream empty;
+    Stream&stream=currentNode==nullptr?empty:currentNode->value.streamItems();
+
+    StreamID newId;
+    uint64_t now=std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if(id=="*"){
+        newId=stream.nextID(now);
+    }else if(id.size()>2&&id.compare(id.size()-2,2,"-*")==0){
+        if(!StreamID::parse(id.substr(0,id.size()-2),newId)){
+            return reply.error("Invalid stream ID specified as stream command argument");
+        }
+        if(newId.ms==stream.lastID().ms){
+            if(stream.lastID().seq==UINT64_MAX){
+                return reply.error("The ID specified in XADD is equal or smaller than the target stream top item");
             }
-            resMessage.erase(resMessage.size()-1);
+            newId.seq=stream.lastID().seq+1;
+        }
+    }else if(!StreamID::parse(id,newId)){
+        return reply.error("Invalid stream ID specified as stream command argument");
+    }
+    if(newId==StreamID::min()){
+        return reply.error("The ID specified in XADD must be greater than 0-0");
+    }
+    if(newId<=stream.lastID()){
+        return reply.error("The ID specified in XADD is equal or smaller than the target stream top item");
+    }
+    TrimThreshold trim;
+    if(!parseTrimThreshold(trimModel,approx,threshold,trim)){
+        return reply.error("The threshold of the trim strategy is invalid");
+    }
+
+    stream.append(newId,fields.begin(),fields.end());
+    trimStream(stream,trim);
+    if(currentNode==nullptr){
+        redisDataBase->addItem(std::string(key),RedisValue(std::move(empty)));
+    }
+    reply.bulk(newId.toString());
+}
+
+// 语法：xrange key start end [COUNT count]
+// 127.0.0.1:6379> xrange mystream - +
+// 1) 1) "1518951480106-0"
+//    2) 1) "sensor"
+//       2) "1234"
+void RedisHelper::xrange(ReplyBuilder& reply,std::string_view key,std::string_view start,std::string_view end,size_t count){
+    StreamID startId,endId;
+    if(!parseRangeID(start,true,startId)||!parseRangeID(end,false,endId)){
+        return reply.error("Invalid stream ID specified as stream command argument");
+    }
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        return reply.arrayHeader(0);
+    }
+    if(currentNode->value.type()!=RedisValue::STREAM){
+        return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a stream!");
+    }
+    replyStreamEntries(reply,currentNode->value.streamItems().range(startId,endId,count));
+}
+
+// 语法：xread [COUNT count] STREAMS key [key ...] id [id ...]
+// 127.0.0.1:6379> xread count 1 streams mystream 0
+// 1) 1) "mystream"
+//    2) 1) 1) "1518951480106-0"
+//          2) 1) "sensor"
+//             2) "1234"
+// 只返回ID严格大于给定ID的消息，$表示stream当前的最后一个ID。
+// 没有任何stream有新消息时返回(nil)。
+void RedisHelper::xread(ReplyBuilder& reply,ArgSpan keys,ArgSpan ids,size_t count){
+    //出错时需要丢弃已经写入的部分回复
+    size_t array=reply.beginArray();
+    size_t streams=0;
+    for(size_t i=0;i<keys.size();i++){
+        auto currentNode=redisDataBase->searchItem(keys[i]);
+        if(currentNode==nullptr){
+            continue;
+        }
+        if(currentNode->value.type()!=RedisValue::STREAM){
+            reply.buffer().resize(array);
+            return reply.error("The key:" +std::string(keys[i])+" "+"already exists and the value is not a stream!");
+        }
+        Stream&stream=currentNode->value.streamItems();
+        StreamID startId;
+        if(ids[i]=="$"){
+            startId=stream.lastID();
+        }else if(!StreamID::parse(ids[i],startId)){
+            reply.buffer().resize(array);
+            return reply.error("Invalid stream ID specified as stream command argument");
+        }
+        if(startId==StreamID::max()){
+            continue;
+        }
+        startId=startId.seq==UINT64_MAX?StreamID(startId.ms+1,0):StreamID(startId.ms,startId.seq+1);
+        std::vector<StreamEntry>entries=stream.range(startId,StreamID::max(),count);
+        if(entries.empty()){
+            continue;
         }
+        reply.arrayHeader(2);
+        reply.bulk(keys[i]);
+        replyStreamEntries(reply,entries);
+        streams++;
     }
-    return resMessage;
-}
\ No newline at end of file
+    if(streams==0){
+        return reply.nilArray();
+    }
+    reply.endArray(array,streams);
+}
+
+// 语法：xlen key
+// 127.0.0.1:6379> xlen mystream
+// (integer) 2
+void RedisHelper::xlen(ReplyBuilder& reply,std::string_view key){
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        return reply.integer(0);
+    }
+    if(currentNode->value.type()!=RedisValue::STREAM){
+        return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a stream!");
+    }
+    reply.integer(currentNode->value.streamItems().size());
+}
+
+// 语法：xtrim key MAXLEN|MINID [=|~] threshold
+// 127.0.0.1:6379> xtrim mystream maxlen 1000
+// (integer) 0
+// 使用~时只删除整块消息，实际保留的消息数可能略多于阈值，但不需要重新打包块。
+void RedisHelper::xtrim(ReplyBuilder& reply,std::string_view key,STREAM_TRIM_MODEL trimModel,bool approx,std::string_view threshold){
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode!=nullptr&&currentNode->value.type()!=RedisValue::STREAM){
+        return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a stream!");
+    }
+    TrimThreshold trim;
+    if(!parseTrimThreshold(trimModel,approx,threshold,trim)){
+        return reply.error("The threshold of the trim strategy is invalid");
+    }
+    if(currentNode==nullptr){
+        return reply.integer(0);
+    }
+    reply.integer(trimStream(currentNode->value.streamItems(),trim));
+}
+
+// 语法：hscan key cursor [MATCH pattern] [COUNT count]
+// 127.0.0.1:6379> hscan myhash 0
+// 1) "0"
+// 2) 1) "field1"
+//    2) "value1"
+// 哈希表按字段有序保存，游标同样是上一批最后检查的字段。
+void RedisHelper::hscan(ReplyBuilder& reply,std::string_view key,std::string_view cursor,std::string_view pattern,size_t count){
+    std::string lastField;
+    if(!decodeCursor(cursor,lastField)){
+        return reply.error("invalid cursor");
+    }
+    auto currentNode=redisDataBase->searchItem(key);
+    if(currentNode==nullptr){
+        return replyScan(reply,"0",{});
+    }
+    if(currentNode->value.type()!=RedisValue::OBJECT){
+        return reply.error("The key:" +std::string(key)+" "+"already exists and the value is not a hashtable!");
+    }
+    RedisValue::object& valueMap = currentNode->value.objectItems();
+    GlobPattern glob(pattern);
+    const std::string& prefix=glob.literalPrefix();
+    auto it=cursor=="0"||lastField<prefix?valueMap.lower_bound(prefix):valueMap.upper_bound(lastField);
+    std::vector<std::string_view>items;
+    size_t examined=0;
+    for(;it!=valueMap.end()&&examined<count&&!glob.pastPrefix(it->first);++it){
+        lastField=it->first;
+        examined++;
+        if(glob.match(it->first)){
+            items.push_back(it->first);
+            items.push_back(it->second.stringValue());
+        }
+    }
+    bool finished=it==valueMap.end()||glob.pastPrefix(it->first);
+    replyScan(reply,finished?"0":encodeCursor(lastField),items);
+}
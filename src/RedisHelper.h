@@ -1,10 +1,14 @@
 
 #ifndef REDISHELPER_H
 #define REDISHELPER_H
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
+#include <string_view>
 #include "SkipList.h" 
+#include "CommandArgs.h"
+#include "ReplyBuilder.h"
 #include "RedisValue/RedisValue.h"
 #define DEFAULT_DB_FOLDER "data_files"
 #define DATABASE_FILE_NAME "db"
@@ -15,75 +19,136 @@ private:
     // static const std::string DEFAULT_DB_FOLDER;
     // static const std::string DATABASE_FILE_NAME;
     // static const int DATABASE_FILE_NUMBER;
+    std::string dataFolder; //快照文件所在目录
     std::string dataBaseIndex="0"; //当前数据库索引
     std::shared_ptr<SkipList<std::string, RedisValue>> redisDataBase = std::make_shared<SkipList<std::string, RedisValue>>(); //数据库
+    bool persistent=true; //为false时不写快照文件（副本读视图的第二份数据，文件由第一份负责写）
+    bool locking=true; //跳表是否加锁，见setLocking
 public:
-    RedisHelper();
+    // 在本机运行多个实例（如主库和副本）时，每个实例需要自己的数据目录
+    explicit RedisHelper(const std::string& dataFolder=DEFAULT_DB_FOLDER);
     ~RedisHelper();
 private:
     
     //从文件中加载数据  持久性保存数据
-    void loadData(std::string loadPath);  
+    void loadData(std::string loadPath);
     std::string getFilePath();
+    //丢弃当前数据库的数据，换成一个空跳表
+    void resetDataBase();
+    //按SET的模式写入键值，不满足NX/XX条件时返回false；供set及需要写入结果的命令（BITOP、PFMERGE等）复用
+    bool store(std::string_view key, const RedisValue& value,const SET_MODEL model=NONE);
 public:
+    //以下命令都把回复写入reply（RESP格式），由服务器返回给客户端
     void flush(); //写入文件 
+    // 丢弃内存中的数据，从当前数据库的快照文件重新加载（副本全量同步后使用）
+    void reload();
+    const std::string& getDataBaseIndex()const{return dataBaseIndex;}
+    // 第index个数据库的快照文件路径
+    std::string getFilePath(int index)const;
+    // 从快照文件创建一份相同的数据（调用前内存与文件必须一致，如刚flush或reload过），它不写快照文件
+    std::shared_ptr<RedisHelper> createMirror()const;
+    // 跳表不加锁，由调用方保证读写不会并发（副本读视图，见LeftRight.h）
+    void setLocking(bool enabled);
+    // 在当前数据库上只加一次跳表锁执行func（事务），func中切换数据库后新的数据库仍按操作加锁
+    template<typename Func>
+    void batch(Func func){
+        auto dataBase=redisDataBase; //func中SELECT会替换redisDataBase，保证解锁的是加锁的那一个
+        dataBase->batch(func);
+    }
     //选择数据库
-    std::string select(int index);
+    void select(ReplyBuilder& reply,int index);
 
     // key操作命令
-    std::string keys(const std::string pattern="*");
+    void keys(ReplyBuilder& reply,std::string_view pattern="*");
+
+    // 增量遍历键空间
+    // SCAN cursor [MATCH pattern] [COUNT count] [TYPE type]
+    void scan(ReplyBuilder& reply,std::string_view cursor,std::string_view pattern="*",size_t count=10,std::string_view type="");
+
+    // 按键的字典序做范围查询
+    // KRANGE start end [WITHVALUES] [LIMIT count]：正序返回范围内的键。
+    // KREVRANGE end start [WITHVALUES] [LIMIT count]：逆序返回范围内的键。
+    // KCOUNT start end：统计范围内的键数。
+    void krange(ReplyBuilder& reply,std::string_view start,std::string_view end,bool withValues=false,size_t limit=0,bool reverse=false);
+    void kcount(ReplyBuilder& reply,std::string_view start,std::string_view end);
+
+    // 值的序列化，编码格式见ValueCodec.h
+    // DUMP key：返回值编码的十六进制文本，键不存在时返回nil。
+    // RESTORE key ttl serialized-value [REPLACE]：用DUMP的结果创建键。
+    void dump(ReplyBuilder& reply,std::string_view key);
+    void restore(ReplyBuilder& reply,std::string_view key,long long ttl,std::string_view serialized,bool replace=false);
+    // 把键的值编码后追加到out，键不存在时返回false
+    bool dumpValue(std::string_view key,std::string& out);
+
+    // 槽位迁移使用的接口（见Migration.h），调用方持有命令锁
+    // 把keys中存在的键编码成迁移记录追加到payload，不存在的键从keys中去掉
+    void encodeRecords(std::vector<std::string>& keys,std::string& payload);
+    // 写入payload中的count条迁移记录，写入的键追加到keys；replace为false时有一个键已存在就都不写入
+    // 结果（+OK或错误）写入reply
+    bool restoreRecords(ReplyBuilder& reply,std::string_view payload,size_t count,bool replace,std::vector<std::string>& keys);
+    // 按KRANGE的边界语法取出范围内最多limit个键，边界不合法时返回false
+    bool rangeKeys(std::string_view start,std::string_view end,size_t limit,std::vector<std::string>& keys);
+    // 与SCAN相同的游标，检查count个键并把满足match的追加到keys，返回下一个游标（"0"表示结束，游标不合法时返回空串）
+    std::string scanKeys(std::string_view cursor,size_t count,const std::function<bool(const std::string&)>& match,std::vector<std::string>& keys);
 
     // 获取键总数
-    std::string dbsize()const;
+    void dbsize(ReplyBuilder& reply)const;
 
     // 查询键是否存在
-    std::string exists(const std::vector<std::string>&keys);
+    void exists(ReplyBuilder& reply,ArgSpan keys);
+    // 键是否存在，不写回复（集群判断迁移中的键是否还在本节点）
+    bool hasKey(std::string_view key);
     
     // 删除键
-    std::string del(const std::vector<std::string>&keys);
+    void del(ReplyBuilder& reply,ArgSpan keys);
 
     // 更改键名称
-    std::string rename(const std::string&oldName,const std::string&newName);
+    void rename(ReplyBuilder& reply,std::string_view oldName,std::string_view newName);
 
     // 字符串操作命令
-    std::string set(const std::string& key, const RedisValue& value,const SET_MODEL model=NONE);
+    void set(ReplyBuilder& reply,std::string_view key, const RedisValue& value,const SET_MODEL model=NONE);
 
-    std::string setnx(const std::string& key, const RedisValue& value);
+    void setnx(ReplyBuilder& reply,std::string_view key, const RedisValue& value);
 
-    std::string setex(const std::string& key, const RedisValue& value);
+    void setex(ReplyBuilder& reply,std::string_view key, const RedisValue& value);
 
     // 获取键值
-    std::string get(const std::string&key);
+    void get(ReplyBuilder& reply,std::string_view key);
     // 值递增/递减
-    std::string incr(const std::string& key);
+    void incr(ReplyBuilder& reply,std::string_view key);
 
-    std::string incrby(const std::string& key,int increment);
+    void incrby(ReplyBuilder& reply,std::string_view key,int increment);
 
-    std::string incrbyfloat(const std::string&key,double increment);
+    void incrbyfloat(ReplyBuilder& reply,std::string_view key,double increment);
 
     // 同样，递减使用decr、decrby命令。
-    std::string decr(const std::string&key);
+    void decr(ReplyBuilder& reply,std::string_view key);
 
-    std::string decrby(const std::string&key,int increment);
+    void decrby(ReplyBuilder& reply,std::string_view key,int increment);
 
     // 批量存放键值
-    std::string mset(std::vector<std::string>&items);
+    void mset(ReplyBuilder& reply,ArgSpan items);
 
     // 获取获取键值
-    std::string mget(std::vector<std::string>&keys);
+    void mget(ReplyBuilder& reply,ArgSpan keys);
 
     // 获取值长度
-    std::string strlen(const std::string& key);
+    void strlen(ReplyBuilder& reply,std::string_view key);
 
     // 追加内容
-    std::string append(const std::string&key,const std::string &value);
+    void append(ReplyBuilder& reply,std::string_view key,std::string_view value);
     
     //列表操作
-    std::string lpush(const std::string&key,const std::string &value);
-    std::string rpush(const std::string&key,const std::string &value);
-    std::string lpop(const std::string&key);
-    std::string rpop(const std::string&key);
-    std::string lrange(const std::string&key,const std::string &start,const std::string&end);
+    void lpush(ReplyBuilder& reply,std::string_view key,std::string_view value);
+    void rpush(ReplyBuilder& reply,std::string_view key,std::string_view value);
+    void lpop(ReplyBuilder& reply,std::string_view key);
+    void rpop(ReplyBuilder& reply,std::string_view key);
+    void lrange(ReplyBuilder& reply,std::string_view key,int start,int end);
+    // BLPOP/BRPOP：从keys中第一个非空列表的头部（left）或尾部弹出一个元素，回复[键, 元素]
+    // 所有列表都为空或不存在时不写回复并返回false，有键不是列表时回复错误
+    bool popFirst(ReplyBuilder& reply,ArgSpan keys,bool left);
+    // BLMOVE：从source弹出一个元素推入destination（不存在时创建），回复该元素；source为空或不存在时同样返回false
+    bool move(ReplyBuilder& reply,std::string_view source,std::string_view destination,bool fromLeft,bool toLeft);
 
     //哈希表操作
     // HSET key field value：向哈希表中添加一个字段及其值。
@@ -91,11 +156,46 @@ public:
     // HDEL key field：删除哈希表 key 中的一个或多个指定字段。
     // HKEYS key：获取哈希表中的所有字段名。
     // HVALS key：获取哈希表中的所有值。
-    std::string hset(const std::string&key,const std::vector<std::string>&filed);
-    std::string hget(const std::string&key,const std::string&filed);
-    std::string hdel(const std::string&key,const std::vector<std::string>&filed);
-    std::string hkeys(const std::string&key);
-    std::string hvals(const std::string&key);
+    void hset(ReplyBuilder& reply,std::string_view key,ArgSpan filed);
+    void hget(ReplyBuilder& reply,std::string_view key,std::string_view filed);
+    void hdel(ReplyBuilder& reply,std::string_view key,ArgSpan filed);
+    void hkeys(ReplyBuilder& reply,std::string_view key);
+    void hvals(ReplyBuilder& reply,std::string_view key);
+    // HSCAN key cursor [MATCH pattern] [COUNT count]：增量遍历哈希表的字段。
+    void hscan(ReplyBuilder& reply,std::string_view key,std::string_view cursor,std::string_view pattern="*",size_t count=10);
+
+    //位图操作
+    // SETBIT key offset value：设置字符串值指定偏移处的位，返回原来的位。
+    // GETBIT key offset：获取字符串值指定偏移处的位。
+    // BITCOUNT key [start end]：统计指定字节范围内被设置为1的位数。
+    // BITPOS key bit [start [end]]：返回指定字节范围内第一个值为bit的位的偏移。
+    // BITOP operation destkey key [key ...]：对多个位图做AND/OR/XOR/NOT运算并保存到destkey。
+    void setbit(ReplyBuilder& reply,std::string_view key,long long offset,int value);
+    void getbit(ReplyBuilder& reply,std::string_view key,long long offset);
+    void bitcount(ReplyBuilder& reply,std::string_view key,long long start=0,long long end=-1);
+    void bitpos(ReplyBuilder& reply,std::string_view key,int bit,long long start=0,long long end=-1,bool endGiven=false);
+    void bitop(ReplyBuilder& reply,BITOP_TYPE op,std::string_view destKey,ArgSpan keys);
+
+    //HyperLogLog操作
+    // PFADD key element [element ...]：向HyperLogLog中添加元素。
+    // PFCOUNT key [key ...]：返回HyperLogLog的基数估计值，多个键时返回并集的基数。
+    // PFMERGE destkey sourcekey [sourcekey ...]：将多个HyperLogLog合并到destkey。
+    void pfadd(ReplyBuilder& reply,std::string_view key,ArgSpan elements);
+    void pfcount(ReplyBuilder& reply,ArgSpan keys);
+    void pfmerge(ReplyBuilder& reply,std::string_view destKey,ArgSpan keys);
+
+    //Stream操作
+    // XADD key [NOMKSTREAM] [MAXLEN|MINID [=|~] threshold] *|id field value [field value ...]：追加一条消息。
+    // XRANGE key start end [COUNT count]：按ID范围读取消息。
+    // XREAD [COUNT count] STREAMS key [key ...] id [id ...]：读取ID大于给定值的消息。
+    // XLEN key：获取消息数。
+    // XTRIM key MAXLEN|MINID [=|~] threshold：裁剪旧消息。
+    void xadd(ReplyBuilder& reply,std::string_view key,std::string_view id,ArgSpan fields,
+                     bool noMkStream=false,STREAM_TRIM_MODEL trimModel=TRIM_NONE,bool approx=false,std::string_view threshold="");
+    void xrange(ReplyBuilder& reply,std::string_view key,std::string_view start,std::string_view end,size_t count=0);
+    void xread(ReplyBuilder& reply,ArgSpan keys,ArgSpan ids,size_t count=0);
+    void xlen(ReplyBuilder& reply,std::string_view key);
+    void xtrim(ReplyBuilder& reply,std::string_view key,STREAM_TRIM_MODEL trimModel,bool approx,std::string_view threshold);
 };
 
 #endif
\ No newline at end of file
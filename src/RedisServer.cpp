@@ -34,8 +34,10 @@ void RedisServer::printStartMessage() {
     std::cout << initMessage << std::endl;
 }
 
-void RedisServer::start() {
+void RedisServer::start(int port) {
+    this->port = port;
     signal(SIGINT, signalHandler);  
+    Replication::getInstance()->start(port);
     printLogo();
     printStartMessage();
     // string s ;
@@ -47,169 +49,820 @@ void RedisServer::start() {
 }
 
 
-string RedisServer::executeTransaction(std::queue<std::string>&commandsQueue){
-    //存储所有的执行结果
-    std::vector<std::string>responseMessagesList; 
-    while(!commandsQueue.empty()){
-        std::string receivedData = std::move(commandsQueue.front());
-        commandsQueue.pop();
-        std::istringstream iss(receivedData);
-        std::string command;
-        std::vector<std::string> tokens;
-        std::string responseMessage;
-
-        
-        while (iss >> command) {
-            tokens.push_back(command);
-        }
-        command = tokens.front();
-        if (!tokens.empty()) {
-            command = tokens.front();
-            std::string responseMessage;
-            if(command=="quit"||command=="exit"){
-                responseMessage="stop";
-                return responseMessage;
-            }else if(command=="multi"){
-                responseMessage="Open the transaction repeatedly!";
-                responseMessagesList.emplace_back(responseMessage);
+// 按空白切分命令，参数直接指向line，不做拷贝
+// 以"或'开头的参数到同一种引号后紧跟空白或行尾为止，可以包含空白或为空串（EVAL的脚本、带空格的值）；
+// 双引号内\"和\\是转义（与redis-cli相同，appendArgument按这种格式写复制流），其它字符原样保留，
+// 含转义的参数还原后存放在unescaped中；单引号内不做转义。没有这样的结束引号时按普通参数处理
+// tokens在每次调用时清空后复用，容量保留下来，稳定运行后切分不再分配内存
+static void tokenize(std::string_view line, std::vector<std::string_view>& tokens, std::deque<std::string>& unescaped) {
+    tokens.clear();
+    unescaped.clear();
+    auto isEscape = [&line](size_t pos) {
+        return line[pos] == '\\' && pos + 1 < line.size() && (line[pos + 1] == '"' || line[pos + 1] == '\\');
+    };
+    size_t pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && isspace(static_cast<unsigned char>(line[pos]))) {
+            pos++;
+        }
+        if (pos < line.size() && line[pos] == '"') {
+            size_t close = pos + 1;
+            bool escaped = false;
+            while (close < line.size() &&
+                   (line[close] != '"' || (close + 1 < line.size() && !isspace(static_cast<unsigned char>(line[close + 1]))))) {
+                escaped = escaped || isEscape(close);
+                close += isEscape(close) ? 2 : 1;
+            }
+            if (close < line.size()) {
+                if (!escaped) {
+                    tokens.push_back(line.substr(pos + 1, close - pos - 1));
+                } else {
+                    std::string& arg = unescaped.emplace_back();
+                    for (size_t i = pos + 1; i < close; i++) {
+                        i += isEscape(i) ? 1 : 0;
+                        arg += line[i];
+                    }
+                    tokens.push_back(arg);
+                }
+                pos = close + 1;
                 continue;
-            }else if(command == "exec"){
-                //处理未打开事物就执行的操作
-                responseMessage="No transaction is opened!";
-                 responseMessagesList.emplace_back(responseMessage);
+            }
+        } else if (pos < line.size() && line[pos] == '\'') {
+            size_t close = line.find('\'', pos + 1);
+            while (close != std::string_view::npos && close + 1 < line.size() &&
+                   !isspace(static_cast<unsigned char>(line[close + 1]))) {
+                close = line.find('\'', close + 1);
+            }
+            if (close != std::string_view::npos) {
+                tokens.push_back(line.substr(pos + 1, close - pos - 1));
+                pos = close + 1;
                 continue;
-            }else{
-                //处理常规指令
-                
-                std::shared_ptr<CommandParser> commandParser = flyweightFactory->getParser(command); //获取解析器
-                
-                try {
-                    responseMessage = commandParser->parse(tokens);
-                } catch (const std::exception& e) {
-                    responseMessage = "Error processing command '" + command + "': " + e.what();
-                }   
-                responseMessagesList.emplace_back(responseMessage);
             }
-                    
         }
-                
+        size_t start = pos;
+        while (pos < line.size() && !isspace(static_cast<unsigned char>(line[pos]))) {
+            pos++;
+        }
+        if (pos > start) {
+            tokens.push_back(line.substr(start, pos - start));
+        }
     }
-    string res = "";
-    for(int i=0;i<responseMessagesList.size();i++){      
-        std::string responseMessage = std::to_string(i+1)+")"+responseMessagesList[i];
-        res += responseMessage;
-        if(i!=responseMessagesList.size()-1){
-            res+="\n";
-        } 
+}
+
+// 在作用域内让当前线程的解析器使用读视图中的某一份数据
+struct HelperBinding {
+    explicit HelperBinding(RedisHelper& helper) { CommandParser::bindHelper(&helper); }
+    ~HelperBinding() { CommandParser::bindHelper(nullptr); }
+};
+
+// 写入复制流的命令文本，必须在副本上得到和主库相同的结果
+// XADD的*会按副本的时钟生成另一个ID，替换成主库实际生成的ID（回复中的$len\r\nID\r\n）
+static std::string replicatedCommand(const CommandDescriptor& descriptor, ArgSpan tokens,
+                                     std::string_view receivedData, std::string_view replyText) {
+    if (descriptor.command != XADD || replyText.empty() || replyText[0] != '$') {
+        return std::string(receivedData);
     }
+    size_t begin = replyText.find("\r\n");
+    size_t end = replyText.find("\r\n", begin + 2);
+    std::string_view id = replyText.substr(begin + 2, end - begin - 2);
+    std::string command;
+    bool replaced = false;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        //ID之前只有键和裁剪选项，第一个*就是ID
+        bool isId = !replaced && i >= 2 && tokens[i] == "*";
+        appendArgument(command, isId ? id : tokens[i]);
+        replaced = replaced || isId;
+    }
+    return command;
+}
 
-    return res;
+// 成功执行后按命令原文写入复制流的命令：写命令和CMD_MAY_REPLICATE的命令；CMD_SELF_REPLICATED的命令自己写入实际的修改
+static bool replicatesText(const CommandDescriptor& descriptor) {
+    return ((descriptor.flags & CMD_WRITE) && !(descriptor.flags & CMD_SELF_REPLICATED)) ||
+           (descriptor.flags & CMD_MAY_REPLICATE);
+}
+
+// 按参数重新拼出命令文本，用于没有客户端原文的命令（脚本中调用的命令）
+static std::string joinArguments(ArgSpan tokens) {
+    std::string command;
+    for (auto& token : tokens) {
+        appendArgument(command, token);
+    }
+    return command;
+}
+
+void RedisServer::enqueueCommand(const CommandDescriptor& descriptor, ArgSpan tokens, const std::string& receivedData) {
+    size_t textBegin = queuedText.size();
+    queuedText += receivedData;
+    commandsQueue.push_back({&descriptor, textBegin, queuedText.size(), queuedArgs.size(), tokens.size()});
+    const char* begin = receivedData.data();
+    const char* end = begin + receivedData.size();
+    for (auto& token : tokens) {
+        if (std::less<const char*>()(token.data(), begin) || std::less<const char*>()(end, token.data())) {
+            //含转义的参数不在原文中，还原后的参数追加在原文之后
+            queuedArgs.emplace_back(queuedText.size(), token.size());
+            queuedText.append(token.data(), token.size());
+            continue;
+        }
+        queuedArgs.emplace_back(textBegin + (token.data() - begin), token.size());
+    }
+}
+
+void RedisServer::clearQueue() {
+    commandsQueue.clear();
+    queuedText.clear();
+    queuedArgs.clear();
+}
+
+// 执行事务队列中的命令，回复是一个数组，依次为每条命令的回复
+// 成功的写命令（以及改变数据库的SELECT）作为一个条目写入复制流
+// 命令在入队时已经分词和查表，这里只是依次调用解析器；整个事务只加一次跳表锁（RedisHelper::batch）
+void RedisServer::executeTransaction(ReplyBuilder& reply){
+    Replication* replication = Replication::getInstance();
+    bool recording = replication->isRecording();
+    auto helper = CommandParser::getRedisHelper();
+    std::string db = recording ? helper->getDataBaseIndex() : "";
+    std::vector<std::string> replicated;
+    replicationSink = &replicated; //事务中脚本的写命令与其它命令写入同一个条目
+    //队列不再增长，参数的偏移可以一次换成视图
+    std::vector<std::string_view> args;
+    args.reserve(queuedArgs.size());
+    for (auto& arg : queuedArgs) {
+        args.emplace_back(queuedText.data() + arg.first, arg.second);
+    }
+    reply.arrayHeader(commandsQueue.size());
+    helper->batch([&] {
+        for (auto& queued : commandsQueue) {
+            const CommandDescriptor* descriptor = queued.descriptor;
+            ArgSpan tokens(args.data() + queued.firstArg, queued.argCount);
+            size_t position = reply.buffer().size();
+            try {
+                dispatch(*descriptor, tokens, reply);
+            } catch (const std::exception& e) {
+                reply.buffer().resize(position); //丢弃写了一半的回复，保证数组元素个数正确
+                reply.error("Error processing command '" + std::string(descriptor->name) + "': " + e.what());
+            }
+            std::string_view replyText = std::string_view(reply.buffer()).substr(position);
+            if ((descriptor->flags & CMD_WRITE) && replyText[0] != '-') {
+                signalModified(helper->getDataBaseIndex(), *descriptor, tokens); //唤醒阻塞在这些键上的客户端
+            }
+            if (recording && (replicatesText(*descriptor) || descriptor->command == SELECT) && replyText[0] != '-') {
+                std::string_view receivedData(queuedText.data() + queued.textBegin, queued.textEnd - queued.textBegin);
+                replicated.push_back(replicatedCommand(*descriptor, tokens, receivedData, replyText));
+            }
+        }
+    });
+    replicationSink = nullptr;
+    clearQueue();
+    replication->propagate(db, replicated);
+}
+
+void RedisServer::applyReplicated(std::string_view db, const std::vector<std::string>& commands) {
+    static std::string scratch; //副本不需要回复，只在复制线程中使用
+    std::vector<std::string_view> tokens;
+    std::deque<std::string> unescaped;
+    std::lock_guard<std::mutex> lock(commandMutex);
+    auto apply = [&](RedisHelper& helper) {
+        HelperBinding binding(helper);
+        scratch.clear();
+        ReplyBuilder reply(scratch);
+        //数据库编号是全局状态，执行完切换回副本客户端原来选择的数据库
+        std::string current = helper.getDataBaseIndex();
+        int index = 0;
+        bool switched = current != db && parseInteger(db, index);
+        if (switched) {
+            helper.select(reply, index);
+        }
+        for (const auto& command : commands) {
+            tokenize(command, tokens, unescaped);
+            const CommandDescriptor* descriptor = tokens.empty() ? nullptr : CommandTable::lookup(tokens.front());
+            if (descriptor == nullptr || descriptor->parser == nullptr || !CommandTable::checkArity(*descriptor, tokens.size())) {
+                continue;
+            }
+            try {
+                descriptor->parser->parse(tokens, reply);
+            } catch (const std::exception& e) {
+                std::cout << "复制命令执行失败：" << command << "，" << e.what() << std::endl;
+            }
+            if (descriptor->flags & CMD_WRITE) {
+                signalModified(helper.getDataBaseIndex(), *descriptor, tokens);
+            }
+        }
+        if (switched && parseInteger(current, index)) {
+            helper.select(reply, index);
+        }
+    };
+    if (readView.enabled()) {
+        //第二份数据切换数据库时从快照文件加载，先把第一份的当前数据库写入文件
+        if (CommandParser::getRedisHelper()->getDataBaseIndex() != db) {
+            CommandParser::getRedisHelper()->flush();
+        }
+        readView.modify(apply);
+    } else {
+        apply(*CommandParser::getRedisHelper());
+    }
+}
+
+// 乐观事务
+// WATCH key [key ...]：监视键，返回这次监视的编号；之后任何客户端修改（包括删除）其中一个键，带这个编号的EXEC都不执行并返回nil。
+// EXEC [id ...]、DISCARD [id ...]、UNWATCH [id ...]：取消这些编号的监视，不影响其它客户端的监视；
+// 多次WATCH时EXEC带上所有的编号。client.cpp记下WATCH返回的编号，自动加到之后的EXEC、DISCARD、UNWATCH后面。
+// 127.0.0.1:6379> watch balance
+// (integer) 1
+// 127.0.0.1:6379> multi
+// ...
+// 127.0.0.1:6379> exec 1
+// (nil)                     WATCH之后balance被其它客户端修改过
+// 不加锁也不阻塞其它客户端：修改方只在写命令成功后查一次被监视的键，客户端读出新值后重试即可（check-and-set）。
+void RedisServer::watch(ArgSpan keys, ReplyBuilder& reply) {
+    expireWatchers();
+    uint64_t id = nextWatcherId++;
+    Watcher& watcher = watchers[id];
+    watcher.created = std::chrono::steady_clock::now();
+    const std::string& db = CommandParser::getRedisHelper()->getDataBaseIndex();
+    for (auto& key : keys) {
+        std::string name = db + " " + std::string(key);
+        auto& ids = watchedKeys[name];
+        if (ids.empty() || ids.back() != id) { //同一个键出现多次时只记一次
+            ids.push_back(id);
+            watcher.keys.push_back(std::move(name));
+        }
+    }
+    reply.integer(static_cast<long long>(id));
+}
+
+bool RedisServer::unwatch(ArgSpan ids) {
+    bool modified = false;
+    for (auto& text : ids) {
+        uint64_t id = 0;
+        auto it = parseInteger(text, id) ? watchers.find(id) : watchers.end();
+        if (it == watchers.end()) {
+            modified = true;
+            continue;
+        }
+        modified = modified || it->second.dirty;
+        for (auto& key : it->second.keys) {
+            auto found = watchedKeys.find(key);
+            if (found == watchedKeys.end()) {
+                continue; //键被修改后整条记录已经删除
+            }
+            auto& list = found->second;
+            list.erase(std::remove(list.begin(), list.end(), id), list.end());
+            if (list.empty()) {
+                watchedKeys.erase(found);
+            }
+        }
+        watchers.erase(it);
+    }
+    return modified;
+}
+
+void RedisServer::expireWatchers() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastWatchSweep < std::chrono::seconds(1)) {
+        return;
+    }
+    lastWatchSweep = now;
+    std::vector<std::string> expired;
+    for (auto& entry : watchers) {
+        if (now - entry.second.created > std::chrono::milliseconds(WATCH_TIMEOUT_MS)) {
+            expired.push_back(std::to_string(entry.first));
+        }
+    }
+    std::vector<std::string_view> ids(expired.begin(), expired.end());
+    unwatch(ids);
+}
+
+void RedisServer::signalModified(std::string_view db, ArgSpan keys) {
+    if (watchedKeys.empty() && blockedKeys.empty()) {
+        return; //没有监视的键和阻塞的客户端时写命令只多一次判断
+    }
+    std::string name;
+    for (auto& key : keys) {
+        name.assign(db.data(), db.size());
+        name += ' ';
+        name.append(key.data(), key.size());
+        auto watched = watchedKeys.find(name);
+        if (watched != watchedKeys.end()) {
+            for (uint64_t id : watched->second) {
+                watchers[id].dirty = true;
+            }
+            watchedKeys.erase(watched); //这些监视已经失败，之后的修改不用再查
+        }
+        if (blockedKeys.count(name) != 0) {
+            readyKeys.push_back(name);
+        }
+    }
+}
+
+void RedisServer::signalModified(std::string_view db, const CommandDescriptor& descriptor, ArgSpan tokens) {
+    if (watchedKeys.empty() && blockedKeys.empty()) {
+        return;
+    }
+    std::vector<size_t> positions;
+    std::vector<std::string_view> keys;
+    CommandTable::getKeyPositions(descriptor, tokens, positions);
+    for (size_t position : positions) {
+        keys.push_back(tokens[position]);
+    }
+    signalModified(db, keys);
+}
+
+void RedisServer::signalFlushed() {
+    for (auto& entry : watchers) {
+        entry.second.dirty = true;
+    }
+    watchedKeys.clear();
+}
+
+// 阻塞弹出
+// BLPOP key [key ...] timeout / BRPOP key [key ...] timeout / BLMOVE source destination LEFT|RIGHT LEFT|RIGHT timeout
+// 127.0.0.1:6379> blpop jobs 0             另一个客户端 rpush jobs j1 之后返回
+// 1) "jobs"
+// 2) "j1"
+// 客户端按阻塞的先后得到元素，超时返回nil，timeout为0时一直等待。在事务和脚本中不阻塞，没有元素时直接返回nil。
+// 一次请求最多等待BLOCKED_HOLD_MS，之后回复-BLOCKED <编号>，客户端（client.cpp）立即用BPOLL <编号>继续等待。
+// 元素只在等待者自己的请求中弹出，复制流中记录为等价的非阻塞弹出；客户端断开后元素留在列表中。
+void RedisServer::blockClient(const CommandDescriptor& descriptor, ArgSpan tokens, ReplyBuilder& reply) {
+    expireBlocked();
+    if (blockedClients.size() >= BLOCKED_CLIENTS_LIMIT) { //每个等待的请求占用一个RPC线程
+        return reply.error("max number of blocked clients reached");
+    }
+    double timeout = 0;
+    parseDouble(tokens.back(), timeout); //解析器已经检查过
+    auto client = std::make_unique<BlockedClient>();
+    client->id = nextBlockedId++;
+    client->descriptor = &descriptor;
+    client->args.assign(tokens.begin(), tokens.end());
+    client->db = CommandParser::getRedisHelper()->getDataBaseIndex();
+    client->lastPoll = std::chrono::steady_clock::now();
+    //超大的超时时间换算成时钟刻度时会溢出，限制在约30年以内
+    client->deadline = timeout == 0 ? std::chrono::steady_clock::time_point::max()
+                                    : client->lastPoll + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                          std::chrono::duration<double>(std::min(timeout, 1e9)));
+    ArgSpan keys = descriptor.command == BLMOVE ? tokens.subspan(1, 1) : tokens.subspan(1, tokens.size() - 2);
+    for (auto& key : keys) {
+        auto& queue = blockedKeys[client->db + " " + std::string(key)];
+        if (queue.empty() || queue.back() != client.get()) { //同一个键出现多次时只排一次队
+            queue.push_back(client.get());
+        }
+    }
+    BlockedClient& waiter = *client;
+    blockedClients.emplace(client->id, std::move(client));
+    waitBlocked(waiter, reply);
+}
+
+// 语法：bpoll id
+void RedisServer::pollBlocked(std::string_view id, ReplyBuilder& reply) {
+    expireBlocked();
+    uint64_t value = 0;
+    auto it = parseInteger(id, value) ? blockedClients.find(value) : blockedClients.end();
+    if (it == blockedClients.end()) {
+        return reply.error("no such blocked client");
+    }
+    if (it->second->waiting) {
+        return reply.error("blocked client is already waiting");
+    }
+    waitBlocked(*it->second, reply);
+}
+
+void RedisServer::waitBlocked(BlockedClient& client, ReplyBuilder& reply) {
+    //调用方（handleClient）持有命令锁，等待时释放，被唤醒或超时后重新持有，返回后仍由调用方解锁
+    std::unique_lock<std::mutex> lock(commandMutex, std::adopt_lock);
+    client.waiting = true;
+    serveBlocked(); //expireBlocked删除的等待者没有取走的元素先交给下一个等待者，可能就是这一个
+    auto hold = std::min(client.deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(BLOCKED_HOLD_MS));
+    while (true) {
+        if (!client.readyOn.empty() && serveClient(client, reply)) {
+            lock.release();
+            return unblock(client);
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= client.deadline) {
+            bool move = client.descriptor->command == BLMOVE;
+            lock.release();
+            unblock(client);
+            return move ? reply.nil() : reply.nilArray();
+        }
+        if (now >= hold) {
+            break;
+        }
+        client.wake.wait_until(lock, hold);
+    }
+    lock.release();
+    client.waiting = false;
+    client.lastPoll = std::chrono::steady_clock::now();
+    reply.error("BLOCKED", std::to_string(client.id));
+}
+
+bool RedisServer::abandoned(const BlockedClient& client, std::chrono::steady_clock::time_point now) {
+    return !client.waiting && now - client.lastPoll > std::chrono::milliseconds(BLOCKED_POLL_TIMEOUT_MS);
+}
+
+void RedisServer::expireBlocked() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<BlockedClient*> expired;
+    for (auto& entry : blockedClients) {
+        if (abandoned(*entry.second, now)) {
+            expired.push_back(entry.second.get());
+        }
+    }
+    for (auto* client : expired) {
+        unblock(*client);
+    }
+}
+
+void RedisServer::dequeue(BlockedClient& client) {
+    std::vector<std::string_view> args(client.args.begin(), client.args.end());
+    ArgSpan tokens(args);
+    ArgSpan keys = client.descriptor->command == BLMOVE ? tokens.subspan(1, 1) : tokens.subspan(1, tokens.size() - 2);
+    for (auto& key : keys) {
+        auto it = blockedKeys.find(client.db + " " + std::string(key));
+        if (it == blockedKeys.end()) {
+            continue; //同一个键出现多次或已经离开过队列
+        }
+        auto& queue = it->second;
+        queue.erase(std::remove(queue.begin(), queue.end(), &client), queue.end());
+        if (queue.empty()) {
+            blockedKeys.erase(it);
+        }
+    }
+}
+
+void RedisServer::unblock(BlockedClient& client) {
+    dequeue(client);
+    for (auto& key : client.readyOn) {
+        readyKeys.push_back(client.db + " " + key); //没有取走的元素交给下一个等待者
+    }
+    uint64_t id = client.id;
+    blockedClients.erase(id);
+}
+
+bool RedisServer::serveClient(BlockedClient& client, ReplyBuilder& reply) {
+    auto helper = CommandParser::getRedisHelper();
+    std::string scratch;
+    ReplyBuilder selected(scratch);
+    std::string current = helper->getDataBaseIndex();
+    int index = 0;
+    if (current != client.db && parseInteger(client.db, index)) { //其它客户端可能已经SELECT了别的数据库
+        helper->select(selected, index);
+    }
+    std::vector<std::string> keys = std::move(client.readyOn);
+    client.readyOn.clear();
+    size_t position = reply.buffer().size();
+    bool served = false;
+    for (auto& key : keys) {
+        //用解析器执行一次非阻塞的弹出：BLPOP/BRPOP只弹出这个键，BLMOVE原样执行
+        std::vector<std::string_view> args;
+        if (client.descriptor->command == BLMOVE) {
+            args.assign(client.args.begin(), client.args.end());
+        } else {
+            args = {client.args.front(), key, client.args.back()};
+        }
+        try {
+            client.descriptor->parser->parse(args, reply);
+        } catch (const std::exception& e) {
+            reply.buffer().resize(position);
+            reply.error("Error processing command '" + std::string(client.descriptor->name) + "': " + e.what());
+        }
+        //列表仍为空；BLPOP/BRPOP的键被改成了其它类型时与Redis相同，客户端继续等待
+        std::string_view replyText = std::string_view(reply.buffer()).substr(position);
+        if (replyText == "*-1\r\n" || replyText == "$-1\r\n" ||
+            (replyText[0] == '-' && client.descriptor->command != BLMOVE)) {
+            reply.buffer().resize(position);
+            continue;
+        }
+        if (replyText[0] != '-') {
+            signalModified(client.db, *client.descriptor, args); //列表中还有元素时轮到下一个等待者，BLMOVE的目标上也可能有
+            if (Replication::getInstance()->isRecording()) {
+                Replication::getInstance()->propagate(client.db, {joinArguments(args)});
+            }
+        }
+        served = true;
+        break;
+    }
+    if (helper->getDataBaseIndex() != current && parseInteger(current, index)) {
+        helper->select(selected, index);
+    }
+    return served;
+}
+
+void RedisServer::serveBlocked() {
+    auto now = std::chrono::steady_clock::now();
+    while (!readyKeys.empty()) {
+        std::string ready = std::move(readyKeys.back());
+        readyKeys.pop_back();
+        for (auto it = blockedKeys.find(ready); it != blockedKeys.end(); it = blockedKeys.find(ready)) {
+            BlockedClient* client = it->second.front();
+            //已经离开的客户端删除；已经超时的等下一次BPOLL返回nil
+            if (abandoned(*client, now)) {
+                unblock(*client);
+                continue;
+            }
+            if (!client->waiting && now >= client->deadline) {
+                dequeue(*client);
+                continue;
+            }
+            //只标记不弹出：等待者正在请求中时立即醒来弹出，不在时等它的下一次BPOLL
+            std::string key = ready.substr(ready.find(' ') + 1);
+            if (std::find(client->readyOn.begin(), client->readyOn.end(), key) == client->readyOn.end()) {
+                client->readyOn.push_back(std::move(key));
+            }
+            client->wake.notify_one();
+            break;
+        }
+    }
+}
+
+void RedisServer::enableReadView() {
+#ifdef REPLICA_READ_VIEW
+    readView.disable();
+    auto helper = CommandParser::getRedisHelper();
+    helper->setLocking(false);
+    mirror = helper->createMirror();
+    readView.enable(helper.get(), mirror.get());
+#endif
+}
+
+void RedisServer::disableReadView() {
+    if (!readView.enabled()) {
+        return;
+    }
+    readView.disable();
+    CommandParser::getRedisHelper()->setLocking(true);
+    mirror.reset();
+}
+
+// 副本的只读命令在读视图上执行，不进入命令锁，跳表也不加锁；不能这样执行时返回false，由调用方走命令锁
+bool RedisServer::serveRead(const std::string& receivedData, ReplyBuilder& reply) {
+    static thread_local std::vector<std::string_view> tokens;
+    static thread_local std::deque<std::string> unescaped;
+    tokenize(receivedData, tokens, unescaped);
+    const CommandDescriptor* descriptor = tokens.empty() ? nullptr : CommandTable::lookup(tokens.front());
+    if (descriptor == nullptr || !(descriptor->flags & CMD_READONLY) || startMulti || asking ||
+        !CommandTable::checkArity(*descriptor, tokens.size())) {
+        return false;
+    }
+    return readView.read([&](RedisHelper& helper) {
+        if (!Cluster::getInstance()->route(*descriptor, tokens, helper, false, reply)) {
+            return;
+        }
+        HelperBinding binding(helper);
+        size_t position = reply.buffer().size();
+        try {
+            descriptor->parser->parse(tokens, reply);
+        } catch (const std::exception& e) {
+            reply.buffer().resize(position);
+            reply.error("Error processing command '" + std::string(descriptor->name) + "': " + e.what());
+        }
+    });
+}
+
+// 订阅相关的命令（SUBSCRIBE、LISTEN等）只访问PubSub的状态，不进入命令锁；
+// 不是这类命令时返回false。先只查第一个词，其它命令不需要在这里分词
+bool RedisServer::servePubSub(const std::string& receivedData, ReplyBuilder& reply) {
+    std::string_view line(receivedData);
+    size_t start = 0;
+    while (start < line.size() && isspace(static_cast<unsigned char>(line[start]))) {
+        start++;
+    }
+    size_t end = start;
+    while (end < line.size() && !isspace(static_cast<unsigned char>(line[end]))) {
+        end++;
+    }
+    const CommandDescriptor* descriptor = CommandTable::lookup(line.substr(start, end - start));
+    if (descriptor == nullptr || !(descriptor->flags & CMD_PUBSUB)) {
+        return false;
+    }
+    static thread_local std::vector<std::string_view> tokens;
+    static thread_local std::deque<std::string> unescaped;
+    tokenize(line, tokens, unescaped);
+    if (!CommandTable::checkArity(*descriptor, tokens.size())) {
+        reply.error(CommandTable::arityError(*descriptor));
+        return true;
+    }
+    if (startMulti) {
+        reply.error("Command not allowed inside a transaction");
+        return true;
+    }
+    size_t position = reply.buffer().size();
+    try {
+        descriptor->parser->parse(tokens, reply);
+    } catch (const std::exception& e) {
+        reply.buffer().resize(position);
+        reply.error("Error processing command '" + std::string(descriptor->name) + "': " + e.what());
+    }
+    return true;
+}
+
+// 脚本中的redis.call：检查后直接调用命令的解析器，调用方（Scripting）已经持有命令锁
+void RedisServer::callFromScript(ArgSpan tokens, ReplyBuilder& reply, std::vector<std::string>& effects) {
+    const CommandDescriptor* descriptor = CommandTable::lookup(tokens.front());
+    if (descriptor == nullptr) {
+        return reply.error("Unknown Redis command called from script");
+    }
+    //事务、SELECT、EVAL等改变连接状态或本身就是脚本的命令不能在脚本中调用
+    if (descriptor->parser == nullptr || (descriptor->flags & CMD_NO_SCRIPT)) {
+        return reply.error("This Redis command is not allowed from scripts");
+    }
+    if (!CommandTable::checkArity(*descriptor, tokens.size())) {
+        return reply.error("Wrong number of args calling Redis command from script");
+    }
+    bool write = descriptor->flags & CMD_WRITE;
+    if (write && Replication::getInstance()->isReplica()) {
+        return reply.error("READONLY", "You can't write against a read only replica.");
+    }
+    //脚本访问的键同样要属于本节点，没有在KEYS中声明的键也会检查
+    if (!Cluster::getInstance()->route(*descriptor, tokens, *CommandParser::getRedisHelper(), false, reply)) {
+        return;
+    }
+    size_t position = reply.buffer().size();
+    try {
+        dispatch(*descriptor, tokens, reply);
+    } catch (const std::exception& e) {
+        reply.buffer().resize(position);
+        reply.error("Error processing command '" + std::string(descriptor->name) + "': " + e.what());
+    }
+    std::string_view replyText = std::string_view(reply.buffer()).substr(position);
+    if (replyText[0] == '-') {
+        return;
+    }
+    if (write) {
+        signalModified(CommandParser::getRedisHelper()->getDataBaseIndex(), *descriptor, tokens);
+    }
+    if (replicatesText(*descriptor) && Replication::getInstance()->isRecording()) {
+        effects.push_back(replicatedCommand(*descriptor, tokens, joinArguments(tokens), replyText));
+    }
+}
+
+void RedisServer::propagateEffects(std::vector<std::string>& effects) {
+    if (effects.empty()) {
+        return;
+    }
+    if (replicationSink != nullptr) {
+        replicationSink->insert(replicationSink->end(), std::make_move_iterator(effects.begin()),
+                                std::make_move_iterator(effects.end()));
+        return;
+    }
+    //脚本不能SELECT，迁移也只删除当前数据库中的键，所有修改都在当前数据库中
+    Replication::getInstance()->propagate(CommandParser::getRedisHelper()->getDataBaseIndex(), effects);
+}
+
+// 执行一条命令。开启读视图时改变当前数据库的SELECT要在两份数据上都执行，第二次的回复丢弃
+void RedisServer::dispatch(const CommandDescriptor& descriptor, ArgSpan tokens, ReplyBuilder& reply) {
+    if (descriptor.command != SELECT || !readView.enabled()) {
+        return descriptor.parser->parse(tokens, reply);
+    }
+    std::string scratch;
+    ReplyBuilder discarded(scratch);
+    bool first = true;
+    CommandParser::getRedisHelper()->flush(); //第二份数据从快照文件加载，先写入第一份的当前数据库
+    readView.modify([&](RedisHelper& helper) {
+        HelperBinding binding(helper);
+        descriptor.parser->parse(tokens, first ? reply : discarded);
+        first = false;
+    });
 }
-    
 
 string RedisServer::handleClient(string receivedData) {
-    
-   size_t bytesRead = receivedData.length();
-     if (bytesRead > 0) {
-         std::istringstream iss(receivedData);
-         std::string command;
-         std::vector<std::string> tokens;
-         while (iss >> command) { //以字符串分割
-             tokens.push_back(command);
-         }
-
-         if (!tokens.empty()) {
-             command = tokens.front();
-             std::string responseMessage;
-             if (command == "quit" || command == "exit") {
-                 responseMessage = "stop";
-                 
-                 return responseMessage;
-             }
-             else if (command == "multi") {
-                 if (startMulti) {
-                     responseMessage = "Open the transaction repeatedly!";
-                     
-                     return responseMessage;
-                 }
-                 startMulti = true;
-                 std::queue<std::string> empty;
-                 std::swap(empty, commandsQueue);
-                 responseMessage = "OK";
-                 return responseMessage;
-             }
-             else if (command == "exec") {
-                 if (startMulti == false) {
-                     //处理未打开事物就执行的操作
-                     responseMessage = "No transaction is opened!";
-                     return responseMessage;
-                 }
-                 startMulti = false;
-                 if (!fallback) {
-                     //执行事物
-                     responseMessage =  executeTransaction(commandsQueue);
-
-                     return responseMessage;
-                 }
-                 else {
-                     fallback = false;
-                     responseMessage = "(error) EXECABORT Transaction discarded because of previous errors.";
-                     return responseMessage;
-                 }
-             }
-             else if (command == "discard") {
-                 startMulti = false;
-                 fallback = false;
-                 responseMessage = "OK";
-                 return responseMessage;
-             }
-             else {
-                 //处理常规指令
-                 if (!startMulti) {
-                    std::shared_ptr<CommandParser> commandParser = flyweightFactory->getParser(command);
-                     if (commandParser == nullptr) {
-                         responseMessage = "Error: Command '" + command + "' not recognized.";
-                     }
-                     else {
-                         try {
-                             responseMessage = commandParser->parse(tokens);
-                         }
-                         catch (const std::exception& e) {
-                             responseMessage = "Error processing command '" + command + "': " + e.what();
-                         }
-                     }
-
-                     // 发送响应消息回客户端
-                     return responseMessage;
-                 }
-                 else {
-                     //添加到事物队列中
-                     std::shared_ptr<CommandParser> commandParser = flyweightFactory->getParser(command);
-                     if (commandParser == nullptr) {
-                        //编译错误,需要回退，后续增加回退功能
-                        fallback = true;
-                        responseMessage = "Error: Command '" + command + "' not recognized.";
-                        return responseMessage;
-                     }
-                     else {
-                        //加入到队列
-                        commandsQueue.emplace(receivedData);
-                        responseMessage = "QUEUED";
-                        return responseMessage;
-                     }
-
-                 }
-
-             }
-
-         }
-     }
-     else {
-         // 在非阻塞模式下，没有数据可读时继续循环
-         return "nil";
-     }
-    
-     return "error";
+    static thread_local std::string outputBuffer; //回复缓冲区，每次请求清空后复用，容量保留下来
+    outputBuffer.clear();
+    ReplyBuilder reply(outputBuffer);
+    if (servePubSub(receivedData, reply)) {
+        return outputBuffer;
+    }
+    if (readView.enabled() && serveRead(receivedData, reply)) {
+        return outputBuffer;
+    }
+    std::lock_guard<std::mutex> lock(commandMutex);
+    processCommand(receivedData, reply);
+    serveBlocked(); //唤醒阻塞在这条命令推入元素的键上的客户端
+    return outputBuffer;
+}
+
+void RedisServer::processCommand(const std::string& receivedData, ReplyBuilder& reply) {
+    static thread_local std::vector<std::string_view> tokens; //参数视图，指向receivedData（含转义的参数指向unescaped）
+    static thread_local std::deque<std::string> unescaped;
+    tokenize(receivedData, tokens, unescaped); //以空白分割
+    if (tokens.empty()) {
+        return reply.nil();
+    }
+    const CommandDescriptor* descriptor = CommandTable::lookup(tokens.front()); //不区分大小写
+    Command command = descriptor == nullptr ? INVALID_COMMAND : descriptor->command;
+    //参数个数不对的命令不会执行，事务中出现时整个事务在EXEC时被丢弃
+    if (descriptor != nullptr && !CommandTable::checkArity(*descriptor, tokens.size())) {
+        if (startMulti && !(descriptor->flags & CMD_NO_QUEUE)) {
+            fallback = true;
+        }
+        return reply.error(CommandTable::arityError(*descriptor));
+    }
+    if (command == ASKING) {
+        asking = true;
+        return reply.status("OK");
+    }
+    bool asked = asking.exchange(false); //ASKING只对紧接着的一条命令有效
+    //副本只读，写命令在入队前就拒绝，事务中出现时整个事务被丢弃
+    if (descriptor != nullptr && (descriptor->flags & CMD_WRITE) && Replication::getInstance()->isReplica()) {
+        if (startMulti) {
+            fallback = true;
+        }
+        return reply.error("READONLY", "You can't write against a read only replica.");
+    }
+    //集群模式下键不属于本节点时返回重定向，事务中出现时整个事务被丢弃
+    if (descriptor != nullptr && !Cluster::getInstance()->route(*descriptor, tokens, *CommandParser::getRedisHelper(), asked, reply)) {
+        if (startMulti && !(descriptor->flags & CMD_NO_QUEUE)) {
+            fallback = true;
+        }
+        return;
+    }
+    if (command == QUIT) {
+        return reply.status("OK");
+    }
+    else if (command == BPOLL) {
+        return pollBlocked(tokens[1], reply);
+    }
+    else if (command == WATCH) {
+        if (startMulti) {
+            return reply.error("WATCH inside MULTI is not allowed");
+        }
+        return watch(ArgSpan(tokens).subspan(1), reply);
+    }
+    else if (command == UNWATCH) {
+        unwatch(ArgSpan(tokens).subspan(1));
+        return reply.status("OK");
+    }
+    else if (command == MULTI) {
+        if (startMulti) {
+            return reply.error("Open the transaction repeatedly!");
+        }
+        startMulti = true;
+        clearQueue();
+        return reply.status("OK");
+    }
+    else if (command == EXEC) {
+        if (startMulti == false) {
+            //处理未打开事物就执行的操作
+            return reply.error("No transaction is opened!");
+        }
+        startMulti = false;
+        bool modified = unwatch(ArgSpan(tokens).subspan(1)); //不论事务是否执行，EXEC之后都取消这些监视
+        if (!fallback) {
+            if (modified) {
+                //监视的键在WATCH之后被修改过，事务不执行，客户端重新读取后重试
+                return reply.nilArray();
+            }
+            //执行事物
+            return executeTransaction(reply);
+        }
+        fallback = false;
+        clearQueue();
+        return reply.error("EXECABORT", "Transaction discarded because of previous errors.");
+    }
+    else if (command == DISCARD) {
+        startMulti = false;
+        fallback = false;
+        clearQueue();
+        unwatch(ArgSpan(tokens).subspan(1));
+        return reply.status("OK");
+    }
+    //处理常规指令
+    if (descriptor == nullptr) {
+        if (startMulti) {
+            //编译错误,需要回退，后续增加回退功能
+            fallback = true;
+        }
+        return reply.error("Command '" + std::string(tokens.front()) + "' not recognized.");
+    }
+    if (startMulti) {
+        //加入到事物队列
+        enqueueCommand(*descriptor, tokens, receivedData);
+        return reply.status("QUEUED");
+    }
+    size_t position = reply.buffer().size();
+    std::string db;
+    if (replicatesText(*descriptor) && Replication::getInstance()->isRecording()) {
+        db = CommandParser::getRedisHelper()->getDataBaseIndex();
+    }
+    try {
+        dispatch(*descriptor, tokens, reply);
+    }
+    catch (const std::exception& e) {
+        reply.buffer().resize(position);
+        reply.error("Error processing command '" + std::string(descriptor->name) + "': " + e.what());
+    }
+    std::string_view replyText = std::string_view(reply.buffer()).substr(position);
+    if ((descriptor->flags & CMD_BLOCKING) && (replyText == "*-1\r\n" || replyText == "$-1\r\n")) {
+        //没有可弹出的元素：丢弃空回复，在这些键上等待
+        reply.buffer().resize(position);
+        return blockClient(*descriptor, tokens, reply);
+    }
+    //执行成功的写命令写入复制流
+    if ((descriptor->flags & CMD_WRITE) && replyText[0] != '-') {
+        signalModified(CommandParser::getRedisHelper()->getDataBaseIndex(), *descriptor, tokens);
+    }
+    if (!db.empty() && replyText[0] != '-') {
+        Replication::getInstance()->propagate(db, {replicatedCommand(*descriptor, tokens, receivedData, replyText)});
+    }
 }
 
 
@@ -244,7 +897,6 @@ void RedisServer::signalHandler(int sig) {
 
 
 RedisServer::RedisServer(int port, const std::string& logoFilePath) 
-: port(port), logoFilePath(logoFilePath),
-flyweightFactory(new ParserFlyweightFactory()){
+: port(port), logoFilePath(logoFilePath){
     pid = getpid();
 }
\ No newline at end of file
@@ -19,20 +19,76 @@
 #include <signal.h>
 #include<fcntl.h>
 #include <cstring> 
-#include "ParserFlyweightFactory.h"
+#include "CommandParser.h"
+#include "CommandTable.h"
+#include "ReplyBuilder.h"
+#include "Replication.h"
+#include "LeftRight.h"
+#include "Cluster.h"
+#include <atomic>
 #include <queue>
+#include <deque>
+#include <unordered_map>
 #include <string>
+#include <string_view>
+#include <memory>
 using namespace std;
+
+#define RPC_WORKER_THREADS 16                          //server.cpp处理请求的线程数，阻塞命令等待时占用其中一个
+#define BLOCKED_CLIENTS_LIMIT (RPC_WORKER_THREADS / 2) //同时阻塞的客户端上限，其余线程留给普通命令
+#define BLOCKED_HOLD_MS 1000         //阻塞命令一次请求最多等待的时间，要小于客户端RPC的超时时间，之后客户端用BPOLL继续等待
+#define BLOCKED_POLL_TIMEOUT_MS 3000 //等待者不在请求中超过这个时间时视为客户端已经断开，删除它
+#define WATCH_TIMEOUT_MS 60000 //WATCH之后超过这个时间没有EXEC、DISCARD或UNWATCH的监视视为客户端已经离开，删除它
 class RedisServer {
 private:
-    std::unique_ptr<ParserFlyweightFactory> flyweightFactory; // 解析器工厂
     int port;
     std::atomic<bool> stop{false};
     pid_t pid;
     std::string logoFilePath;
-    bool startMulti = false;
+    std::atomic<bool> startMulti{false}; //副本的只读命令不进入命令锁，也要读这个状态
     bool fallback = false;
-    std::queue<std::string>commandsQueue;//事物指令队列
+    std::atomic<bool> asking{false}; //收到ASKING，下一条命令可以访问正在迁入本节点的槽位
+    //事务队列中的一条命令，入队时已经查好命令表并分好参数，EXEC时直接调用解析器
+    struct QueuedCommand {
+        const CommandDescriptor* descriptor;
+        size_t textBegin, textEnd;  //命令原文在queuedText中的范围（写入复制流）
+        size_t firstArg, argCount;  //参数在queuedArgs中的范围
+    };
+    std::vector<QueuedCommand> commandsQueue;//事物指令队列
+    std::string queuedText;//所有入队命令的原文连续存放，参数只记录偏移，追加时扩容不会使参数失效
+    std::vector<std::pair<size_t, size_t>> queuedArgs;//每个参数在queuedText中的偏移和长度
+    //一次WATCH：服务器按编号区分客户端（与SUBSCRIBE、BPOLL相同），EXEC、DISCARD、UNWATCH只处理参数中给出的编号
+    struct Watcher {
+        std::vector<std::string> keys; //监视的键，格式为"<数据库编号> <键>"
+        bool dirty = false;            //WATCH之后有被监视的键被修改，EXEC放弃执行
+        std::chrono::steady_clock::time_point created;
+    };
+    uint64_t nextWatcherId = 1;
+    std::unordered_map<uint64_t, Watcher> watchers;//编号 -> 监视
+    std::unordered_map<std::string, std::vector<uint64_t>> watchedKeys;//"<数据库编号> <键>" -> 还没有被修改的监视的编号
+    std::chrono::steady_clock::time_point lastWatchSweep;
+    std::mutex commandMutex;//命令锁：客户端命令、复制流的应用和全量同步时的快照互斥执行
+    LeftRight<RedisHelper> readView;//副本的读视图：两份数据，只读命令读其中一份，复制流在两份上依次执行
+                                    //只读命令不等待命令锁，可以在server.cpp的多个工作线程上和复制流的应用同时执行
+    std::shared_ptr<RedisHelper> mirror;//读视图的第二份数据，第一份是解析器共享的RedisHelper
+    std::vector<std::string>* replicationSink = nullptr;//执行事务时指向事务的复制流条目，脚本的写命令追加到其中
+    //阻塞在BLPOP/BRPOP/BLMOVE上的客户端。等待者是服务器上的一条记录，请求线程在它的条件变量上等待（释放命令锁）；
+    //推入元素的命令结束后只标记排在最前的等待者并唤醒它，弹出由等待者自己的请求执行，客户端不在时元素留在列表中
+    struct BlockedClient {
+        uint64_t id;
+        const CommandDescriptor* descriptor;
+        std::vector<std::string> args; //阻塞命令的参数，BPOLL的请求中没有这些参数，这里保存一份
+        std::string db;
+        std::vector<std::string> readyOn; //排在队首时被推入了元素的键，等待者醒来后依次尝试弹出
+        bool waiting = false; //有请求线程正在等待
+        std::chrono::steady_clock::time_point deadline; //timeout为0时为time_point::max()
+        std::chrono::steady_clock::time_point lastPoll; //最近一次请求结束等待的时间
+        std::condition_variable wake;
+    };
+    uint64_t nextBlockedId = 1;
+    std::unordered_map<uint64_t, std::unique_ptr<BlockedClient>> blockedClients;//编号 -> 等待者
+    std::unordered_map<std::string, std::deque<BlockedClient*>> blockedKeys;//"<数据库编号> <键>" -> 按阻塞先后排队的客户端
+    std::vector<std::string> readyKeys;//被修改且有客户端在等待的键，当前命令结束后依次服务
 
 private:
     RedisServer(int port = 5555, const std::string& logoFilePath = MY_PROJECT_DIR_LOGO);
@@ -41,11 +97,67 @@ private:
     void printStartMessage();
     void replaceText(std::string &text, const std::string &toReplaceText, const std::string &replaceText);
     std::string getDate();
-    string executeTransaction(std::queue<std::string>&commandsQueue);
+    void enqueueCommand(const CommandDescriptor& descriptor, ArgSpan tokens, const std::string& receivedData);
+    void clearQueue();
+    void executeTransaction(ReplyBuilder& reply);
+    void processCommand(const std::string& receivedData, ReplyBuilder& reply);
+    bool serveRead(const std::string& receivedData, ReplyBuilder& reply);
+    bool servePubSub(const std::string& receivedData, ReplyBuilder& reply);
+    void dispatch(const CommandDescriptor& descriptor, ArgSpan tokens, ReplyBuilder& reply);
+    void watch(ArgSpan keys, ReplyBuilder& reply);
+    //取消ids中的监视，返回其中是否有监视的键被修改过；编号不存在（已经取消或超时删除）也算作被修改
+    bool unwatch(ArgSpan ids);
+    //删除超过WATCH_TIMEOUT_MS的监视，最多每秒检查一次
+    void expireWatchers();
+    //阻塞命令没有可弹出的元素时调用（调用方持有命令锁）：登记等待者并等待
+    void blockClient(const CommandDescriptor& descriptor, ArgSpan tokens, ReplyBuilder& reply);
+    //BPOLL id：-BLOCKED之后继续等待
+    void pollBlocked(std::string_view id, ReplyBuilder& reply);
+    //在这次请求中等待：弹出成功时写入回复，超时回复nil，等待超过BLOCKED_HOLD_MS时回复-BLOCKED <编号>
+    void waitBlocked(BlockedClient& client, ReplyBuilder& reply);
+    //离开所有键的等待队列，记录仍保留到下一次BPOLL返回nil
+    void dequeue(BlockedClient& client);
+    //从键的等待队列和blockedClients中删除，client随之释放；它被标记过的键交给下一个等待者
+    void unblock(BlockedClient& client);
+    //删除已经离开的等待者
+    void expireBlocked();
+    //客户端不在请求中的时间超过BLOCKED_POLL_TIMEOUT_MS
+    static bool abandoned(const BlockedClient& client, std::chrono::steady_clock::time_point now);
+    //在等待者自己的请求中执行一次弹出，列表仍为空时返回false，客户端继续等待
+    bool serveClient(BlockedClient& client, ReplyBuilder& reply);
+    //在命令锁内、一条命令（事务、脚本）结束后调用：唤醒readyKeys中键上排在最前的等待者
+    void serveBlocked();
+    //写命令执行成功后调用，按命令表取出它修改的键
+    void signalModified(std::string_view db, const CommandDescriptor& descriptor, ArgSpan tokens);
 public:
-string handleClient(string receivedData);
+    //执行一条命令，返回RESP格式的回复（见ReplyBuilder.h）
+    string handleClient(string receivedData);
    static RedisServer* getInstance();
-    void start();
+    void start(int port = 5555);
+    //在命令锁内执行func，期间不会有命令修改数据（副本的只读命令仍可能在读视图上读取，见enableReadView）
+    template<typename Func>
+    void runExclusive(Func func) {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        func();
+        serveBlocked(); //如迁入的键上有阻塞的客户端
+    }
+    //在命令锁内调用：db中的keys被修改（包括删除），其中有被WATCH的键时下一次EXEC放弃执行
+    //客户端写命令由processCommand调用，复制流、槽位迁移等不经过processCommand的修改由修改方调用
+    void signalModified(std::string_view db, ArgSpan keys);
+    //在命令锁内调用：执行脚本中的一条命令（redis.call），成功的写命令按参数拼成文本追加到effects
+    void callFromScript(ArgSpan tokens, ReplyBuilder& reply, std::vector<std::string>& effects);
+    //在命令锁内调用：脚本执行结束后把它的写命令作为一个复制流条目写入（在事务中时并入事务的条目）
+    //迁移删除键等自己写复制流的命令同样经过这里，写入的是当前数据库
+    void propagateEffects(std::vector<std::string>& effects);
+    //在命令锁内调用：整个数据集被替换（副本全量同步），所有被WATCH的键都算作被修改
+    void signalFlushed();
+    //副本执行从主库收到的一组命令（一个复制流条目），db为主库执行时的数据库编号
+    void applyReplicated(std::string_view db, const std::vector<std::string>& commands);
+    //副本全量同步后在命令锁内调用：从刚加载的快照建立读视图，此后只读命令不进入命令锁
+    //编译时关闭REPLICA_READ_VIEW则什么都不做
+    void enableReadView();
+    //停用读视图并等待正在执行的只读命令结束，之后才能直接修改数据（重新加载快照、恢复为主库）
+    void disableReadView();
 };
 
 #endif 
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <string>
 #include <cmath>
 #include "RedisValue.h"
+#include "Stream.h"
+#include "JsonScanner.h"
 
 struct NullStruct{
     bool operator == ( NullStruct ) const { return true ; }
@@ -32,30 +34,51 @@ static void dump( double value , std::string& out ){
 static void dump( bool value , std::string& out ){
     out += value ? "true" : "false" ;
 }
+// 转义表：需要转义的字节（控制字符、引号、反斜杠）对应的转义序列，length为0表示原样输出
+struct EscapeTable{
+    char text[ 256 ][ 6 ] ;
+    uint8_t length[ 256 ] ;
+};
+constexpr EscapeTable buildEscapeTable(){
+    EscapeTable table{} ;
+    const char hex[] = "0123456789abcdef" ;
+    for( int ch = 0 ; ch < 0x20 ; ch ++ ){ // 控制字符使用Unicode转义
+        const char unicode[] = { '\\' , 'u' , '0' , '0' , hex[ ch >> 4 ] , hex[ ch & 0x0f ] } ;
+        for( int k = 0 ; k < 6 ; k ++ ) table.text[ ch ][ k ] = unicode[ k ] ;
+        table.length[ ch ] = 6 ;
+    }
+    const char shortEscapes[][2] = { { '\\' , '\\' } , { '"' , '"' } , { '\b' , 'b' } , { '\f' , 'f' } ,
+                                     { '\n' , 'n' } , { '\r' , 'r' } , { '\t' , 't' } } ;
+    for( const auto& escape : shortEscapes ){
+        uint8_t ch = static_cast<uint8_t>( escape[ 0 ] ) ;
+        table.text[ ch ][ 0 ] = '\\' ;
+        table.text[ ch ][ 1 ] = escape[ 1 ] ;
+        table.length[ ch ] = 2 ;
+    }
+    return table ;
+}
+static constexpr EscapeTable escapeTable = buildEscapeTable() ;
+
 // 用于将字符串值进行转义处理并追加到输出字符串中
+// 需要转义的字节正好是JsonScanner查找的那几类，两个特殊字节之间的整段直接拷贝，
+// 只有特殊字节查表输出。输出至少和输入一样长，先按输入长度预留空间。
 static void dump( const std::string & value , std::string & out ){
+    out.reserve( out.size() + value.size() + 2 ) ;
     out += '"' ;
-    for (char ch : value) {
-        // 根据字符进行相应的转义处理
-        switch (ch) {
-            case '\\': out += "\\\\"; break;
-            case '"': out += "\\\""; break;
-            case '\b': out += "\\b"; break;
-            case '\f': out += "\\f"; break;
-            case '\n': out += "\\n"; break;
-            case '\r': out += "\\r"; break;
-            case '\t': out += "\\t"; break;
-            default:
-                if (static_cast<uint8_t>(ch) <= 0x1f) {
-                    char buf[8];
-                    snprintf(buf, sizeof buf, "\\u%04x", ch); // 对控制字符进行Unicode转义
-                    out += buf;
-                } else {
-                    out += ch;
-                }
+    const char* data = value.data() ;
+    size_t size = value.size() ;
+    size_t pos = 0 ;
+    while( pos < size ){
+        size_t next = JsonScanner::findStringSpecial( data , pos , size ) ;
+        out.append( data + pos , next - pos ) ;
+        if( next == size ){
+            break ;
         }
+        uint8_t ch = static_cast<uint8_t>( data[ next ] ) ;
+        out.append( escapeTable.text[ ch ] , escapeTable.length[ ch ] ) ;
+        pos = next + 1 ;
     }
-    out += '"';
+    out += '"' ;
 }
 // 用于将Json对象转换为字符串并追加到输出字符串中
 static void dump( const RedisValue::object &values , std::string & out ){
@@ -64,12 +87,27 @@ static void dump( const RedisValue::object &values , std::string & out ){
     for( const auto & kv : values ){
         if( !first ){ out += ", " ; }
         dump( kv.first , out ) ;
-        out += "." ;
+        out += ":" ;
         kv.second.dump( out ) ;
         first = false ;
     }
     out += '}' ;
 }
+// 用于将数组转换为字符串并追加到输出字符串中
+static void dump( const RedisValue::array &values , std::string & out ){
+    bool first = true ;
+    out += '[' ;
+    for( const auto & value : values ){
+        if( !first ){ out += ", " ; }
+        value.dump( out ) ;
+        first = false ;
+    }
+    out += ']' ;
+}
+// stream自带序列化格式，见Stream::dump
+static void dump( const Stream &value , std::string & out ){
+    value.dump( out ) ;
+}
 
 
 #endif
@@ -17,7 +17,10 @@ struct Statics{
     std::vector<RedisValue> emptyVector;
 
     // 定义一个静态的空Json对象映射
-    std::map<std::string,RedisValue> emptyMap;
+    RedisValue::object emptyMap;
+
+    // 定义一个静态的空Stream
+    Stream emptyStream;
 
     // 默认构造函数
     Statics()= default;
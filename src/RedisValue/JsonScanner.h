@@ -0,0 +1,114 @@
+#ifndef JSONSCANNER_H
+#define JSONSCANNER_H
+#include <cstddef>
+#include <cstdint>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+    JSON解析/序列化用的字节扫描内核
+    解析和转义字符串时绝大部分字节不需要特殊处理，只需找到下一个引号、反斜杠或控制字符，
+    中间的整段字节可以一次拷贝（见Parse.cpp的parseString和Dump.h的dump）。
+    支持AVX2时每次比较32字节，否则用SSE2每次比较16字节，非x86平台退回逐字节扫描。比较结果用movemask压成位掩码，再用ctz取第一个命中的位置。
+*/
+class JsonScanner {
+    static inline bool isStringSpecial(uint8_t ch) {
+        return ch == '"' || ch == '\\' || ch < 0x20;
+    }
+    static inline bool isWhitespace(uint8_t ch) {
+        return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+    }
+
+public:
+    // 返回[pos,size)中第一个引号、反斜杠或控制字符的位置，没有时返回size
+    static size_t findStringSpecial(const char* data, size_t pos, size_t size) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+#ifdef __AVX2__
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+        const __m256i control = _mm256_set1_epi8(0x1f);
+        for (; pos + 32 <= size; pos += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + pos));
+            __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash));
+            //无符号比较v<=0x1f：max(v,0x1f)==0x1f
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+            if (mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+#elif defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1f);
+        for (; pos + 16 <= size; pos += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + pos));
+            __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+            if (mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+#endif
+        return findStringSpecialScalar(data, pos, size);
+    }
+
+    // 逐字节版本，处理向量化之后剩下的尾部，也用于基准测试对比
+    static size_t findStringSpecialScalar(const char* data, size_t pos, size_t size) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+        while (pos < size && !isStringSpecial(p[pos])) {
+            pos++;
+        }
+        return pos;
+    }
+
+    // 返回从pos开始第一个非空白字符的位置，没有时返回size
+    // 快照中的空白通常只有一个字符，先逐字节判断，遇到长的缩进才按块跳过
+    static size_t skipWhitespace(const char* data, size_t pos, size_t size) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+        for (int k = 0; k < 4; k++, pos++) {
+            if (pos >= size || !isWhitespace(p[pos])) {
+                return pos;
+            }
+        }
+#ifdef __AVX2__
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i newline = _mm256_set1_epi8('\n');
+        const __m256i ret = _mm256_set1_epi8('\r');
+        const __m256i tab = _mm256_set1_epi8('\t');
+        for (; pos + 32 <= size; pos += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + pos));
+            __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, newline)),
+                                         _mm256_or_si256(_mm256_cmpeq_epi8(v, ret), _mm256_cmpeq_epi8(v, tab)));
+            uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+            if (mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+#elif defined(__SSE2__)
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i ret = _mm_set1_epi8('\r');
+        const __m128i tab = _mm_set1_epi8('\t');
+        for (; pos + 16 <= size; pos += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + pos));
+            __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(v, ret), _mm_cmpeq_epi8(v, tab)));
+            uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(ws)) & 0xffff;
+            if (mask != 0) {
+                return pos + __builtin_ctz(mask);
+            }
+        }
+#endif
+        while (pos < size && isWhitespace(p[pos])) {
+            pos++;
+        }
+        return pos;
+    }
+};
+
+#endif
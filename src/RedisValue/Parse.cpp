@@ -1,5 +1,6 @@
 #include "Parse.h"
 #include "Global.h"
+#include "JsonScanner.h"
 
 
 
@@ -16,8 +17,7 @@ RedisValue RedisValueParser::fail(std::string &&msg) {
 }
 
 void RedisValueParser::consumeWhitespace() {
-    while (str[i] == ' ' || str[i] == '\r' || str[i] == '\n' || str[i] == '\t')
-        i++;
+    i = JsonScanner::skipWhitespace(str.data(), i, str.size());
 }
 
 bool RedisValueParser::consumeComment() {
@@ -96,27 +96,28 @@ std::string RedisValueParser::parseString() {
     std::string out;  // 用于存储解析后的字符串
     long last_escaped_codepoint = -1;  // 用于存储上一个转义的Unicode码点，初始化为-1
     while ( true ) {
+        // 常见情况：一段不需要转义的字符，找到下一个引号/反斜杠/控制字符后整段拷贝
+        size_t next = JsonScanner::findStringSpecial(str.data(), i, str.size());
+        if (next > i) {
+            encodeUTF8(last_escaped_codepoint, out);  // 将上一个转义的Unicode码点编码为UTF-8并添加到输出字符串
+            last_escaped_codepoint = -1;  // 重置上一个转义的Unicode码点
+            out.append(str, i, next - i);
+            i = next;
+        }
+
         if ( i == str.size() )
             return fail("在字符串中意外遇到输入结束", "");
 
-        char ch = str[i++];  // 获取当前字符
+        char ch = str[i++];  // 获取当前字符，只可能是引号、反斜杠或控制字符
 
         if (ch == '"') {
             encodeUTF8(last_escaped_codepoint, out);  // 将上一个转义的Unicode码点编码为UTF-8并添加到输出字符串
             return out;  // 返回解析后的字符串
         }
 
-        if (in_range(ch, 0, 0x1f))
+        if (ch != '\\')
             return fail("在字符串中出现未转义的控制字符 " + esc(ch) + "", "");
 
-        // 常见情况：非转义字符
-        if (ch != '\\') {
-            encodeUTF8(last_escaped_codepoint, out);  // 将上一个转义的Unicode码点编码为UTF-8并添加到输出字符串
-            last_escaped_codepoint = -1;  // 重置上一个转义的Unicode码点
-            out += ch;  // 将当前字符添加到输出字符串
-            continue;
-        }
-
         // 处理转义字符
         if (i == str.size())
             return fail("在字符串中意外遇到输入结束", "");
@@ -203,7 +204,7 @@ RedisValue RedisValueParser::parseRedisValue(int depth) {
         return parseString(); // 解析字符串
 
     if (ch == '{') { // 如果是对象开始
-        std::map<std::string, RedisValue> data; // 创建一个键值对映射
+        RedisValue::object data; // 创建一个键值对映射
         ch = getNextToken();
         if (ch == '}')
             return data;
@@ -259,5 +260,31 @@ RedisValue RedisValueParser::parseRedisValue(int depth) {
         return data; // 返回解析后的数组
     }
 
+    if (ch == 'X') { // 如果是stream：X["lastId",["id","field","value",...],...]
+        RedisValue items = parseRedisValue(depth + 1);
+        if (failed)
+            return RedisValue();
+        RedisValue::array& data = items.arrayItems();
+        if (!items.isArray() || data.empty() || !data[0].isString())
+            return fail("stream格式错误");
+        Stream stream;
+        StreamID lastId;
+        if (!StreamID::parse(data[0].stringValue(), lastId))
+            return fail("stream的ID格式错误");
+        for (size_t k = 1; k < data.size(); k++) {
+            RedisValue::array& entry = data[k].arrayItems();
+            StreamID id;
+            if (!data[k].isArray() || entry.empty() || !StreamID::parse(entry[0].stringValue(), id))
+                return fail("stream的消息格式错误");
+            std::vector<std::string> fields;
+            for (size_t f = 1; f < entry.size(); f++)
+                fields.push_back(entry[f].stringValue());
+            if (!stream.append(id, fields))
+                return fail("stream的消息ID不是递增的");
+        }
+        stream.setLastID(lastId);
+        return stream;
+    }
+
     return fail("期望值，得到 " + esc(ch)); // 如果都不匹配，返回解析失败
 }
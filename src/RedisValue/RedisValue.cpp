@@ -21,6 +21,10 @@ RedisValue::RedisValue(const RedisValue::object& value) : redisValue(std::make_s
 
 RedisValue::RedisValue(RedisValue::object &&value) : redisValue(std::make_shared<RedisObject>(std::move(value))) {}
 
+RedisValue::RedisValue(const Stream& value) : redisValue(std::make_shared<RedisStream>(value)) {}
+
+RedisValue::RedisValue(Stream&& value) : redisValue(std::make_shared<RedisStream>(std::move(value))) {}
+
 // 成员函数
 RedisValue::Type RedisValue::type() const {
     return redisValue->type() ;
@@ -34,10 +38,14 @@ std::vector<RedisValue> & RedisValue::arrayItems() {
     return redisValue->arrayItems();
 }
 
-std::map<std::string, RedisValue> & RedisValue::objectItems()  {
+RedisValue::object & RedisValue::objectItems()  {
     return redisValue->objectItems();
 }
 
+Stream & RedisValue::streamItems() {
+    return redisValue->streamItems();
+}
+
 RedisValue & RedisValue::operator[] (size_t i)  {
     return (*redisValue)[i];
 }
@@ -54,10 +62,14 @@ std::vector<RedisValue> & RedisValueType::arrayItems() {
     return statics().emptyVector ;
 }
 
-std::map< std::string, RedisValue > & RedisValueType::objectItems() {
+RedisValue::object & RedisValueType::objectItems() {
     return statics().emptyMap ;
 }
 
+Stream & RedisValueType::streamItems() {
+    return statics().emptyStream ;
+}
+
 RedisValue& RedisValueType::operator[] (size_t) {
     return staticNull() ;
 }
@@ -164,7 +176,7 @@ bool RedisValue::hasShape(const shape & types, std::string & err)  {
     }
 
     // 获取 JSON 对象的所有成员项
-    std::map<std::basic_string<char>, RedisValue> obj_items = objectItems() ;
+    RedisValue::object obj_items = objectItems() ;
 
     // 遍历指定的形状
     for (const std::pair<std::basic_string<char>, RedisValue::Type> & item : types) {
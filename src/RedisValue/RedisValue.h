@@ -10,6 +10,7 @@
 #include <initializer_list>
 
 class RedisValueType ; // 声明RedisValueType类 、
+class Stream ;
 
 class RedisValue{
 private:
@@ -17,11 +18,11 @@ private:
 public:
     // Redis 中支持的数据类型
     enum Type{
-        NUL , NUMBER , BOOL , STRING , ARRAY , OBJECT
+        NUL , NUMBER , BOOL , STRING , ARRAY , OBJECT , STREAM
     };
     // 用typedef重命名 数组 和 对象 类型
     typedef std::vector< RedisValue > array ;
-    typedef std::map< std::string , RedisValue > object ;
+    typedef std::map< std::string , RedisValue , std::less<> > object ; //透明比较器，可以直接用std::string_view查找字段
 
     RedisValue() noexcept ;
     RedisValue( std::nullptr_t ) noexcept ;
@@ -32,6 +33,8 @@ public:
     RedisValue( object && values) ;
     RedisValue( const std::string& value) ;
     RedisValue( std::string&& value ) ;
+    RedisValue( const Stream& value ) ;
+    RedisValue( Stream&& value ) ;
 
     // 从具有 toJson 成员函数的类实例构造 RedisValue
     template<class T , class = decltype( &T::toJson ) >
@@ -59,11 +62,13 @@ public:
     bool isString() const { return type() == STRING ; }
     bool isArray() const { return type() == ARRAY ; }
     bool isObject() const { return type() == OBJECT ; }
+    bool isStream() const { return type() == STREAM ; }
 
     // 获取值的函数
     std::string& stringValue() ;
     array& arrayItems() ;
     object& objectItems() ;
+    Stream& streamItems() ;
 
     // 重载 [] 操作符，用于访问数组元素和对象成员
     RedisValue & operator[] (size_t i) ;
@@ -7,6 +7,7 @@
 #include"Parse.h"
 #include"RedisValue.h"
 #include"Dump.h"
+#include"Stream.h"
 
 class RedisValueType{
 protected:
@@ -18,6 +19,7 @@ protected:
     virtual std::string &stringValue() ;
     virtual RedisValue::array &arrayItems() ;
     virtual RedisValue::object &objectItems() ;
+    virtual Stream &streamItems() ;
     virtual RedisValue& operator[] (size_t i) ;
     virtual RedisValue& operator[](const std::string &key) ;
     virtual ~RedisValueType() = default ;
@@ -75,6 +77,13 @@ public:
     explicit RedisObject(RedisValue::object &&value)      : Value(std::move(value)) {}
 };
 
+class RedisStream final : public Value<RedisValue::STREAM,Stream>{
+    Stream & streamItems() override{ return value;}
+public:
+    explicit RedisStream(const Stream &value) : Value(value) {}
+    explicit RedisStream(Stream &&value)      : Value(std::move(value)) {}
+};
+
 class RedisValueNull final: public Value<RedisValue::NUL,NullStruct>{
 public:
     RedisValueNull() : Value({}) {}
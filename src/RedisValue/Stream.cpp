@@ -0,0 +1,202 @@
+#include "Stream.h"
+#include "Dump.h"
+#include <charconv>
+
+void Stream::putVarint(uint64_t value, std::string& out) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+static bool getVarint(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; pos < in.size() && shift < 64; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseUint64(std::string_view text, uint64_t& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+bool StreamID::parse(std::string_view text, StreamID& id, uint64_t defaultSeq) {
+    size_t dash = text.find('-');
+    if (!parseUint64(text.substr(0, dash), id.ms)) {
+        return false;
+    }
+    if (dash == std::string_view::npos) {
+        id.seq = defaultSeq;
+        return true;
+    }
+    return parseUint64(text.substr(dash + 1), id.seq);
+}
+
+StreamID Stream::nextID(uint64_t nowMs) const {
+    if (nowMs > lastId.ms) {
+        return StreamID(nowMs, 0);
+    }
+    if (lastId.seq == UINT64_MAX) {
+        return StreamID(lastId.ms + 1, 0);
+    }
+    return StreamID(lastId.ms, lastId.seq + 1);
+}
+
+bool Stream::decodeEntry(const Block& block, size_t& pos, StreamEntry& entry) {
+    uint64_t msDelta, seq, fieldCount;
+    if (!getVarint(block.data, pos, msDelta) || !getVarint(block.data, pos, seq)
+        || !getVarint(block.data, pos, fieldCount)) {
+        return false;
+    }
+    entry.id = StreamID(block.master.ms + msDelta, seq);
+    entry.fields.resize(fieldCount);
+    for (auto& field : entry.fields) {
+        uint64_t len;
+        if (!getVarint(block.data, pos, len) || pos + len > block.data.size()) {
+            return false;
+        }
+        field.assign(block.data, pos, len);
+        pos += len;
+    }
+    return true;
+}
+
+std::vector<StreamEntry> Stream::decodeBlock(const Block& block) {
+    std::vector<StreamEntry> entries(block.count);
+    size_t pos = 0;
+    for (auto& entry : entries) {
+        decodeEntry(block, pos, entry);
+    }
+    return entries;
+}
+
+// 返回新消息应写入的尾块，尾块已满时以id为主ID新建一个块
+Stream::Block& Stream::tailBlock(const StreamID& id) {
+    auto it = blocks.empty() ? blocks.end() : std::prev(blocks.end());
+    if (it == blocks.end() || it->second.count >= STREAM_BLOCK_MAX_ENTRIES
+        || it->second.data.size() >= STREAM_BLOCK_MAX_BYTES) {
+        Block block;
+        block.master = id;
+        it = blocks.emplace_hint(blocks.end(), id, std::move(block));
+    }
+    return it->second;
+}
+
+std::vector<StreamEntry> Stream::range(const StreamID& start, const StreamID& end, size_t count) const {
+    std::vector<StreamEntry> result;
+    if (blocks.empty() || end < start) {
+        return result;
+    }
+    // 找到最后一个主ID不大于start的块，start可能落在它内部
+    auto it = blocks.upper_bound(start);
+    if (it != blocks.begin()) {
+        --it;
+    }
+    StreamEntry entry;
+    for (; it != blocks.end() && it->first <= end; ++it) {
+        const Block& block = it->second;
+        if (block.last < start) {
+            continue;
+        }
+        size_t pos = 0;
+        for (uint32_t i = 0; i < block.count; i++) {
+            if (!decodeEntry(block, pos, entry)) {
+                break;
+            }
+            if (entry.id < start) {
+                continue;
+            }
+            if (entry.id > end) {
+                return result;
+            }
+            result.push_back(entry);
+            if (count != 0 && result.size() >= count) {
+                return result;
+            }
+        }
+    }
+    return result;
+}
+
+// 删除第一个块中的前dropCount条消息，剩余消息以新的主ID重新打包
+void Stream::rebuildFront(size_t dropCount) {
+    auto it = blocks.begin();
+    std::vector<StreamEntry> entries = decodeBlock(it->second);
+    blocks.erase(it);
+    Block block;
+    block.master = entries[dropCount].id;
+    for (size_t i = dropCount; i < entries.size(); i++) {
+        encodeEntry(block, entries[i].id, entries[i].fields.begin(), entries[i].fields.end());
+    }
+    blocks.emplace_hint(blocks.begin(), block.master, std::move(block));
+    length -= dropCount;
+}
+
+size_t Stream::trimMaxLen(size_t maxLen, bool approx) {
+    size_t removed = 0;
+    while (length > maxLen && !blocks.empty()) {
+        auto it = blocks.begin();
+        size_t excess = length - maxLen;
+        if (it->second.count <= excess) {
+            length -= it->second.count;
+            removed += it->second.count;
+            blocks.erase(it);
+            continue;
+        }
+        if (!approx) {
+            rebuildFront(excess);
+            removed += excess;
+        }
+        break;
+    }
+    return removed;
+}
+
+size_t Stream::trimMinID(const StreamID& minId, bool approx) {
+    size_t removed = 0;
+    while (!blocks.empty()) {
+        auto it = blocks.begin();
+        if (it->second.last < minId) {
+            length -= it->second.count;
+            removed += it->second.count;
+            blocks.erase(it);
+            continue;
+        }
+        if (!approx && it->first < minId) {
+            std::vector<StreamEntry> entries = decodeBlock(it->second);
+            size_t dropCount = 0;
+            while (entries[dropCount].id < minId) {
+                dropCount++;
+            }
+            rebuildFront(dropCount);
+            removed += dropCount;
+        }
+        break;
+    }
+    return removed;
+}
+
+void Stream::dump(std::string& out) const {
+    out += "X[";
+    ::dump(lastId.toString(), out);
+    for (auto& item : blocks) {
+        for (auto& entry : decodeBlock(item.second)) {
+            out += ", [";
+            ::dump(entry.id.toString(), out);
+            for (auto& field : entry.fields) {
+                out += ", ";
+                ::dump(field, out);
+            }
+            out += ']';
+        }
+    }
+    out += ']';
+}
@@ -0,0 +1,122 @@
+#ifndef STREAM_H
+#define STREAM_H
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define STREAM_BLOCK_MAX_ENTRIES 128   //每个块最多保存的消息数
+#define STREAM_BLOCK_MAX_BYTES 4096    //每个块编码后的最大字节数
+
+// 消息ID：毫秒时间戳-序号，严格单调递增
+struct StreamID{
+    uint64_t ms = 0;
+    uint64_t seq = 0;
+
+    StreamID() = default;
+    StreamID(uint64_t ms, uint64_t seq) : ms(ms), seq(seq) {}
+    bool operator == (const StreamID& rhs) const { return ms == rhs.ms && seq == rhs.seq; }
+    bool operator != (const StreamID& rhs) const { return !(*this == rhs); }
+    bool operator < (const StreamID& rhs) const { return ms < rhs.ms || (ms == rhs.ms && seq < rhs.seq); }
+    bool operator <= (const StreamID& rhs) const { return !(rhs < *this); }
+    bool operator > (const StreamID& rhs) const { return rhs < *this; }
+    std::string toString() const { return std::to_string(ms) + "-" + std::to_string(seq); }
+
+    static StreamID min() { return StreamID(0, 0); }
+    static StreamID max() { return StreamID(UINT64_MAX, UINT64_MAX); }
+    // 解析"ms-seq"或"ms"格式，只有ms时序号取defaultSeq
+    static bool parse(std::string_view text, StreamID& id, uint64_t defaultSeq = 0);
+};
+
+// 一条消息：ID以及按field,value,field,value...平铺的字段
+struct StreamEntry{
+    StreamID id;
+    std::vector<std::string> fields;
+};
+
+/*
+    Stream 只追加的消息日志
+    消息按ID顺序打包进块中，每个块以第一条消息的ID（主ID）为键保存在有序索引里，
+    块内每条消息只保存相对主ID的时间增量，字段用"变长长度+原始字节"紧凑编码。
+    追加只写最后一个块，范围读取先在索引中定位到起始块，再顺序扫描连续内存。
+*/
+class Stream{
+private:
+    struct Block{
+        StreamID master;       //块内第一条消息的ID
+        StreamID last;         //块内最后一条消息的ID
+        uint32_t count = 0;    //块内消息数
+        std::string data;      //打包后的消息
+        bool operator == (const Block& rhs) const { return master == rhs.master && data == rhs.data; }
+    };
+    std::map<StreamID, Block> blocks; //主ID -> 块
+    size_t length = 0;
+    StreamID lastId;
+
+    static void putVarint(uint64_t value, std::string& out);
+    // 消息编码：ms增量 | seq | 字段个数 | (长度 | 字节)...，字段可以是std::string或std::string_view
+    template <typename Iterator>
+    static void encodeEntry(Block& block, const StreamID& id, Iterator first, Iterator last);
+    Block& tailBlock(const StreamID& id);
+    static bool decodeEntry(const Block& block, size_t& pos, StreamEntry& entry);
+    static std::vector<StreamEntry> decodeBlock(const Block& block);
+    void rebuildFront(size_t dropCount);
+
+public:
+    size_t size() const { return length; }
+    StreamID lastID() const { return lastId; }
+
+    // 生成下一个自动ID，时钟回拨时沿用上一个ID的毫秒数并递增序号
+    StreamID nextID(uint64_t nowMs) const;
+
+    // 恢复数据时使用：消息被裁剪后lastID仍需保持单调
+    void setLastID(const StreamID& id) { if (lastId < id) lastId = id; }
+
+    // 追加一条消息，id必须大于lastID()
+    template <typename Iterator>
+    bool append(const StreamID& id, Iterator first, Iterator last);
+    bool append(const StreamID& id, const std::vector<std::string>& fields) { return append(id, fields.begin(), fields.end()); }
+
+    // 返回[start,end]范围内的消息，count为0表示不限制数量
+    std::vector<StreamEntry> range(const StreamID& start, const StreamID& end, size_t count = 0) const;
+
+    // 裁剪到最多maxLen条消息；approx为true时只删除整块，返回删除的消息数
+    size_t trimMaxLen(size_t maxLen, bool approx);
+
+    // 删除ID小于minId的消息；approx为true时只删除整块，返回删除的消息数
+    size_t trimMinID(const StreamID& minId, bool approx);
+
+    // 序列化：X["lastId",["id","field","value",...],...]
+    void dump(std::string& out) const;
+
+    bool operator == (const Stream& rhs) const { return length == rhs.length && lastId == rhs.lastId && blocks == rhs.blocks; }
+    bool operator < (const Stream& rhs) const { return lastId < rhs.lastId || (lastId == rhs.lastId && length < rhs.length); }
+};
+
+template <typename Iterator>
+void Stream::encodeEntry(Block& block, const StreamID& id, Iterator first, Iterator last) {
+    putVarint(id.ms - block.master.ms, block.data);
+    putVarint(id.seq, block.data);
+    putVarint(std::distance(first, last), block.data);
+    for (; first != last; ++first) {
+        putVarint(first->size(), block.data);
+        block.data.append(first->data(), first->size());
+    }
+    block.last = id;
+    block.count++;
+}
+
+template <typename Iterator>
+bool Stream::append(const StreamID& id, Iterator first, Iterator last) {
+    if (id <= lastId) {
+        return false;
+    }
+    encodeEntry(tailBlock(id), id, first, last);
+    lastId = id;
+    length++;
+    return true;
+}
+
+#endif
@@ -0,0 +1,420 @@
+#include "Replication.h"
+#include "RedisServer.h"
+#include "CommandArgs.h"
+#include "NodeLink.h"
+#include "Migration.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+// 40位十六进制的复制ID，每次启动或脱离主库时重新生成
+static std::string randomReplicationId() {
+    std::random_device device;
+    std::mt19937_64 generator(device());
+    const char hex[] = "0123456789abcdef";
+    std::string id(40, '0');
+    for (auto& ch : id) {
+        ch = hex[generator() & 0x0f];
+    }
+    return id;
+}
+
+static bool equalsIgnoreCase(std::string_view token, std::string_view word) {
+    return token.size() == word.size() && strncasecmp(token.data(), word.data(), word.size()) == 0;
+}
+
+Replication::Replication() : replicationId(randomReplicationId()) {}
+
+Replication* Replication::getInstance() {
+    static Replication replication;
+    return &replication;
+}
+
+void Replication::start(int clientPort) {
+    port = clientPort;
+    int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int on = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port + REPLICATION_PORT_OFFSET);
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, 16) != 0) {
+        std::cout << "复制端口" << port + REPLICATION_PORT_OFFSET << "监听失败，本实例不能作为主库" << std::endl;
+        if (listenFd >= 0) {
+            close(listenFd);
+        }
+        return;
+    }
+    std::thread(&Replication::acceptLoop, this, listenFd).detach();
+}
+
+void Replication::acceptLoop(int listenFd) {
+    while (true) {
+        sockaddr_in peer{};
+        socklen_t length = sizeof(peer);
+        int fd = accept4(listenFd, reinterpret_cast<sockaddr*>(&peer), &length, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        char ip[INET_ADDRSTRLEN] = "";
+        inet_ntop(AF_INET, &peer.sin_addr, ip, sizeof(ip));
+        std::thread(&Replication::serveReplica, this, fd, std::string(ip) + ":" + std::to_string(ntohs(peer.sin_port))).detach();
+    }
+}
+
+// 主库：处理一个副本连接，先完成全量或部分同步，然后持续发送复制流
+void Replication::serveReplica(int fd, std::string address) {
+    SocketReader reader(fd);
+    std::string line, command, id;
+    long long requested = -1;
+    if (!reader.readLine(line)) {
+        close(fd);
+        return;
+    }
+    if (line.compare(0, 8, "RESTORE ") == 0) {
+        //槽位迁移的源节点也连接复制端口，见Migration.h
+        return Migration::getInstance()->serveRestore(fd, reader, std::move(line));
+    }
+    std::istringstream(line) >> command >> id >> requested;
+    if (command != "PSYNC" || isReplica()) {
+        sendAll(fd, "-ERR not a primary\n");
+        close(fd);
+        return;
+    }
+    uint64_t offset = 0;
+    std::string currentId;
+    bool partial;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentId = replicationId;
+        partial = id == replicationId && backlogActive && requested >= 0 && backlog.contains(requested);
+        offset = requested;
+    }
+    if (partial) {
+        if (!sendAll(fd, "+CONTINUE " + currentId + "\n")) {
+            close(fd);
+            return;
+        }
+    } else {
+        //在命令锁内保存当前数据库并打开所有快照文件，同时记下复制流的偏移量：
+        //快照包含这个偏移量之前的所有写入，之后的写入由复制流补上
+        int files[DATABASE_FILE_NUMBER];
+        RedisServer::getInstance()->runExclusive([&] {
+            auto helper = CommandParser::getRedisHelper();
+            helper->flush();
+            for (int i = 0; i < DATABASE_FILE_NUMBER; i++) {
+                files[i] = open(helper->getFilePath(i).c_str(), O_RDONLY | O_CLOEXEC);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            backlogActive = true;
+            offset = backlog.endOffset();
+        });
+        bool sent = sendAll(fd, "+FULLRESYNC " + currentId + " " + std::to_string(offset) + "\n");
+        for (int i = 0; i < DATABASE_FILE_NUMBER; i++) {
+            struct stat st{};
+            if (files[i] < 0 || fstat(files[i], &st) != 0) {
+                st.st_size = 0;
+            }
+            sent = sent && sendAll(fd, "$" + std::to_string(i) + " " + std::to_string(st.st_size) + "\n") &&
+                   sendFile(fd, files[i], st.st_size);
+            if (files[i] >= 0) {
+                close(files[i]);
+            }
+        }
+        if (!sent) {
+            close(fd);
+            return;
+        }
+    }
+    size_t colon = address.rfind(':');
+    int linkId;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        linkId = nextReplicaId++;
+        replicas.push_back({linkId, address.substr(0, colon), address.substr(colon + 1), offset});
+    }
+    sendStream(fd, linkId, offset);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = replicas.begin(); it != replicas.end(); ++it) {
+            if (it->id == linkId) {
+                replicas.erase(it);
+                break;
+            }
+        }
+    }
+    close(fd);
+}
+
+// 主库：从offset开始把复制流发给副本，副本断开、落后太多或本实例变成副本时返回
+void Replication::sendStream(int fd, int linkId, uint64_t offset) {
+    std::string chunk;
+    while (true) {
+        chunk.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            //空闲时每秒检查一次连接是否还在，断开的副本不会一直留在ROLE里
+            if (!backlogChanged.wait_for(lock, std::chrono::seconds(1),
+                                         [&] { return backlog.endOffset() > offset || isReplica(); })) {
+                char probe;
+                if (recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT) == 0) {
+                    return;
+                }
+                continue;
+            }
+            if (isReplica() || !backlog.read(offset, REPLICATION_CHUNK_SIZE, chunk)) {
+                return; //积压缓冲区已经覆盖了副本需要的数据，副本重连后会做全量同步
+            }
+            for (auto& link : replicas) {
+                if (link.id == linkId) {
+                    link.offset = offset + chunk.size();
+                }
+            }
+        }
+        if (!sendAll(fd, chunk)) {
+            return;
+        }
+        offset += chunk.size();
+    }
+}
+
+void Replication::propagate(std::string_view db, const std::vector<std::string>& commands) {
+    if (commands.empty() || !isRecording()) {
+        return;
+    }
+    static thread_local std::string entry;
+    entry.clear();
+    entry.append(db.data(), db.size());
+    entry += ' ';
+    entry += std::to_string(commands.size());
+    entry += '\n';
+    for (const auto& command : commands) {
+        entry += std::to_string(command.size());
+        entry += '\n';
+        entry += command;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    backlog.append(entry);
+    backlogChanged.notify_all();
+}
+
+void Replication::replicaOf(ReplyBuilder& reply, std::string_view host, std::string_view portText) {
+    if (equalsIgnoreCase(host, "no") && equalsIgnoreCase(portText, "one")) {
+        //由REPLICAOF命令调用，已经持有命令锁；恢复为主库后写命令直接修改数据，先停用读视图
+        RedisServer::getInstance()->disableReadView();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (replica) {
+            replica = false;
+            generation++;
+            if (primaryFd >= 0) {
+                shutdown(primaryFd, SHUT_RDWR);
+            }
+            linkState = "none";
+            //数据已经和原来的主库分叉，用新的复制ID，原来的副本连过来时会做全量同步
+            replicationId = randomReplicationId();
+        }
+        return reply.status("OK");
+    }
+    int primary = 0;
+    if (!parseInteger(portText, primary) || primary <= 0 || primary > 65535) {
+        return reply.error("Invalid master port");
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (replica && primaryHost == host && primaryPort == primary) {
+        return reply.status("OK"); //已经是这个主库的副本
+    }
+    replica = true;
+    primaryHost = std::string(host);
+    primaryPort = primary;
+    generation++;
+    if (primaryFd >= 0) {
+        shutdown(primaryFd, SHUT_RDWR);
+    }
+    linkState = "connect";
+    primaryReplicationId = "?";
+    replicaOffset = -1;
+    backlogChanged.notify_all(); //本实例原来的副本断开
+    std::thread(&Replication::replicaLoop, this, generation).detach();
+    reply.status("OK");
+}
+
+bool Replication::linkAlive(uint64_t linkGeneration) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return replica && generation == linkGeneration;
+}
+
+void Replication::setLinkState(uint64_t linkGeneration, const std::string& state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (generation == linkGeneration) {
+        linkState = state;
+    }
+}
+
+// 副本：连接主库并同步，断线后每秒重连一次，直到REPLICAOF改变了主库
+void Replication::replicaLoop(uint64_t linkGeneration) {
+    while (linkAlive(linkGeneration)) {
+        std::string host;
+        int primary;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            host = primaryHost;
+            primary = primaryPort;
+        }
+        int fd = connectTo(host, primary + REPLICATION_PORT_OFFSET);
+        if (fd >= 0) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (generation != linkGeneration) {
+                    close(fd);
+                    return;
+                }
+                primaryFd = fd;
+                linkState = "sync";
+            }
+            syncWithPrimary(fd, linkGeneration);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (primaryFd == fd) {
+                    primaryFd = -1;
+                }
+            }
+            close(fd);
+            setLinkState(linkGeneration, "connect");
+        }
+        if (linkAlive(linkGeneration)) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+}
+
+// 副本：完成一次同步并应用复制流，连接断开时返回false
+bool Replication::syncWithPrimary(int fd, uint64_t linkGeneration) {
+    std::string id;
+    long long offset;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = primaryReplicationId;
+        offset = replicaOffset;
+    }
+    if (!sendAll(fd, "PSYNC " + id + " " + std::to_string(offset) + "\n")) {
+        return false;
+    }
+    SocketReader reader(fd);
+    std::string line, type;
+    if (!reader.readLine(line)) {
+        return false;
+    }
+    std::istringstream response(line);
+    response >> type >> id >> offset;
+    if (type == "+FULLRESYNC") {
+        //快照先写到.sync临时文件，全部收齐后在命令锁内替换并重新加载，同步中断时原来的数据不受影响
+        auto helper = CommandParser::getRedisHelper();
+        for (int i = 0; i < DATABASE_FILE_NUMBER; i++) {
+            int index = -1;
+            long long size = -1;
+            if (!reader.readLine(line) || sscanf(line.c_str(), "$%d %lld", &index, &size) != 2 || index != i || size < 0) {
+                return false;
+            }
+            std::string syncPath = helper->getFilePath(i) + ".sync";
+            int file = open(syncPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            bool copied = file >= 0 && reader.copyTo(file, size) && fsync(file) == 0;
+            if (file >= 0) {
+                close(file);
+            }
+            if (!copied) {
+                return false;
+            }
+        }
+        bool current = false;
+        RedisServer::getInstance()->runExclusive([&] {
+            if (!linkAlive(linkGeneration)) {
+                return;
+            }
+            RedisServer::getInstance()->disableReadView();
+            for (int i = 0; i < DATABASE_FILE_NUMBER; i++) {
+                std::string path = helper->getFilePath(i);
+                std::rename((path + ".sync").c_str(), path.c_str());
+            }
+            helper->reload();
+            RedisServer::getInstance()->signalFlushed();
+            RedisServer::getInstance()->enableReadView();
+            std::lock_guard<std::mutex> lock(mutex);
+            primaryReplicationId = id;
+            replicaOffset = offset;
+            current = true;
+        });
+        if (!current) {
+            return false;
+        }
+    } else if (type != "+CONTINUE") {
+        return false;
+    }
+    setLinkState(linkGeneration, "connected");
+
+    std::vector<std::string> commands;
+    std::string db;
+    size_t count;
+    while (true) {
+        uint64_t entryStart = reader.consumedBytes();
+        if (!reader.readLine(line)) {
+            return false;
+        }
+        std::istringstream header(line);
+        if (!(header >> db >> count)) {
+            return false;
+        }
+        commands.resize(count);
+        for (auto& command : commands) {
+            size_t length;
+            if (!reader.readLine(line) || !parseInteger(line, length) || !reader.readBytes(length, command)) {
+                return false;
+            }
+        }
+        if (!linkAlive(linkGeneration)) {
+            return false;
+        }
+        RedisServer::getInstance()->applyReplicated(db, commands);
+        std::lock_guard<std::mutex> lock(mutex);
+        replicaOffset += reader.consumedBytes() - entryStart;
+    }
+}
+
+void Replication::role(ReplyBuilder& reply) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (replica) {
+        reply.arrayHeader(5);
+        reply.bulk("slave");
+        reply.bulk(primaryHost);
+        reply.integer(primaryPort);
+        reply.bulk(linkState);
+        reply.integer(replicaOffset);
+        return;
+    }
+    reply.arrayHeader(3);
+    reply.bulk("master");
+    reply.integer(backlog.endOffset());
+    reply.arrayHeader(replicas.size());
+    for (const auto& link : replicas) {
+        reply.arrayHeader(3);
+        reply.bulk(link.ip);
+        reply.bulk(link.port);
+        reply.bulk(std::to_string(link.offset));
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ReplyBuilder.h"
+#include "ReplicationBacklog.h"
+
+#define REPLICATION_PORT_OFFSET 10000       //复制连接监听在客户端端口+10000上
+#define REPLICATION_BACKLOG_SIZE (16 << 20) //积压缓冲区16MB
+#define REPLICATION_CHUNK_SIZE (64 << 10)   //每次从积压缓冲区发送的最大字节数
+
+/*
+    Replication 主从复制
+    客户端命令走RPC，复制使用单独的TCP连接，监听端口为客户端端口+REPLICATION_PORT_OFFSET。
+    副本连上主库后发送：
+        PSYNC <复制ID> <偏移量>\n           第一次连接时为 PSYNC ? -1
+    主库回复以下两种之一：
+        +FULLRESYNC <复制ID> <偏移量>\n     全量同步：之后依次发送每个数据库的快照文件
+            $<数据库编号> <文件长度>\n<文件内容>  ...  共DATABASE_FILE_NUMBER个
+        +CONTINUE <复制ID>\n                 部分重同步：偏移量还在积压缓冲区中，直接继续发送
+    之后是持续的复制流，由主库执行成功的写命令组成，每个条目为：
+        <数据库编号> <命令条数>\n  然后每条命令为 <长度>\n<命令原文>
+    一个事务中的命令放在同一个条目里，副本在一次加锁内执行完，读请求不会看到执行了一半的事务。
+    复制流同时写入积压缓冲区（ReplicationBacklog），副本断线重连时用自己的偏移量做部分重同步。
+    副本只接受读命令，写命令返回READONLY错误。
+*/
+class Replication {
+private:
+    //已连接的副本，用于ROLE
+    struct ReplicaLink {
+        int id;
+        std::string ip;
+        std::string port;
+        uint64_t offset; //已发送到的偏移量
+    };
+
+    std::mutex mutex;
+    std::condition_variable backlogChanged;
+    ReplicationBacklog backlog{REPLICATION_BACKLOG_SIZE};
+    std::atomic<bool> backlogActive{false}; //第一个副本连接之前不记录复制流，单机运行时没有额外开销
+    std::string replicationId;
+    int port = 0;
+    std::vector<ReplicaLink> replicas;
+    int nextReplicaId = 0;
+
+    //作为副本时的状态
+    std::atomic<bool> replica{false};
+    std::string primaryHost;
+    int primaryPort = 0;
+    uint64_t generation = 0; //每次REPLICAOF递增，旧的同步线程发现后退出
+    int primaryFd = -1;
+    std::string linkState = "none";
+    std::string primaryReplicationId = "?";
+    long long replicaOffset = -1;
+
+    Replication();
+    void acceptLoop(int listenFd);
+    void serveReplica(int fd, std::string address);
+    void sendStream(int fd, int linkId, uint64_t offset);
+    void replicaLoop(uint64_t linkGeneration);
+    bool syncWithPrimary(int fd, uint64_t linkGeneration);
+    bool linkAlive(uint64_t linkGeneration);
+    void setLinkState(uint64_t linkGeneration, const std::string& state);
+
+public:
+    static Replication* getInstance();
+    // 开始监听副本连接，port为客户端端口
+    void start(int port);
+    bool isReplica() const { return replica.load(std::memory_order_relaxed); }
+    // 是否需要记录复制流，为false时服务器不必为propagate准备命令
+    bool isRecording() const { return backlogActive.load(std::memory_order_relaxed) && !isReplica(); }
+    // 主库把执行成功的写命令追加到复制流，db为执行时的数据库编号；由服务器在命令锁内调用，保证顺序与执行顺序一致
+    void propagate(std::string_view db, const std::vector<std::string>& commands);
+
+    // REPLICAOF host port：成为host:port的副本
+    // REPLICAOF NO ONE：停止复制，恢复为主库
+    void replicaOf(ReplyBuilder& reply, std::string_view host, std::string_view port);
+    // ROLE：主库返回 master 偏移量 副本列表，副本返回 slave 主库地址 端口 状态 偏移量
+    void role(ReplyBuilder& reply);
+};
+
+#endif
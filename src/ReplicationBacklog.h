@@ -0,0 +1,67 @@
+#ifndef REPLICATIONBACKLOG_H
+#define REPLICATIONBACKLOG_H
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    ReplicationBacklog 复制积压缓冲区
+    固定大小的环形缓冲区，保存复制流最近的capacity个字节。复制流中的每个字节有一个从0开始递增的偏移量，
+    缓冲区保存的是[startOffset, endOffset)这一段，新数据覆盖最旧的数据。
+    副本断线重连时带上自己已经收到的偏移量，只要这个偏移量还在缓冲区里，
+    主库从这里继续发送即可（部分重同步），不需要重新传输整个快照。
+    本身不加锁，由Replication的互斥锁保护。
+*/
+class ReplicationBacklog {
+private:
+    std::vector<char> ring;
+    uint64_t start = 0; //缓冲区中最旧字节的偏移量
+    uint64_t end = 0;   //下一个写入字节的偏移量
+
+public:
+    explicit ReplicationBacklog(size_t capacity) : ring(capacity) {}
+
+    uint64_t startOffset() const { return start; }
+    uint64_t endOffset() const { return end; }
+
+    // offset处及之后的数据是否都还在缓冲区中
+    bool contains(uint64_t offset) const {
+        return offset >= start && offset <= end;
+    }
+
+    void append(std::string_view data) {
+        //比整个缓冲区还大的数据只保留最后capacity个字节
+        if (data.size() > ring.size()) {
+            end += data.size() - ring.size();
+            data.remove_prefix(data.size() - ring.size());
+        }
+        while (!data.empty()) {
+            size_t pos = end % ring.size();
+            size_t count = std::min(data.size(), ring.size() - pos);
+            std::copy(data.data(), data.data() + count, ring.begin() + pos);
+            data.remove_prefix(count);
+            end += count;
+        }
+        start = std::max(start, end > ring.size() ? end - ring.size() : 0);
+    }
+
+    // 把从offset开始的最多maxBytes个字节追加到out，offset已被覆盖时返回false
+    bool read(uint64_t offset, size_t maxBytes, std::string& out) const {
+        if (!contains(offset)) {
+            return false;
+        }
+        size_t remaining = std::min<uint64_t>(end - offset, maxBytes);
+        while (remaining > 0) {
+            size_t pos = offset % ring.size();
+            size_t count = std::min(remaining, ring.size() - pos);
+            out.append(ring.data() + pos, count);
+            offset += count;
+            remaining -= count;
+        }
+        return true;
+    }
+};
+
+#endif
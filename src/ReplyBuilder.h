@@ -0,0 +1,98 @@
+#ifndef REPLYBUILDER_H
+#define REPLYBUILDER_H
+#include <charconv>
+#include <string>
+#include <string_view>
+
+/*
+    ReplyBuilder 按RESP协议把回复直接追加到连接的输出缓冲区
+    +状态  -错误  :整数  $长度\r\n字节\r\n  *元素个数\r\n...  空值为$-1 / *-1
+    命令只描述回复的类型和内容，格式化成给人看的文本由客户端（ReplyRenderer.h）负责。
+    数字直接写入缓冲区，字符串值按原始字节整体拷贝，不会产生中间std::string。
+*/
+class ReplyBuilder {
+private:
+    std::string& out;
+
+    void writeNumber(long long value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr - digits);
+    }
+
+    void writeLine(char type, std::string_view text) {
+        out += type;
+        out.append(text.data(), text.size());
+        out += "\r\n";
+    }
+
+public:
+    explicit ReplyBuilder(std::string& buffer) : out(buffer) {}
+
+    std::string& buffer() { return out; }
+
+    // +OK
+    void status(std::string_view text) {
+        writeLine('+', text);
+    }
+
+    // -ERR message，code为错误类型（ERR、WRONGTYPE、EXECABORT...）
+    void error(std::string_view message) {
+        error("ERR", message);
+    }
+    void error(std::string_view code, std::string_view message) {
+        out += '-';
+        out.append(code.data(), code.size());
+        out += ' ';
+        out.append(message.data(), message.size());
+        out += "\r\n";
+    }
+
+    // :123
+    void integer(long long value) {
+        out += ':';
+        writeNumber(value);
+        out += "\r\n";
+    }
+
+    // $3\r\nfoo\r\n，内容是二进制安全的
+    void bulk(std::string_view value) {
+        out += '$';
+        writeNumber(static_cast<long long>(value.size()));
+        out += "\r\n";
+        out.append(value.data(), value.size());
+        out += "\r\n";
+    }
+
+    // 不存在的值
+    void nil() {
+        out += "$-1\r\n";
+    }
+
+    // 不存在的数组（如没有数据可读的XREAD）
+    void nilArray() {
+        out += "*-1\r\n";
+    }
+
+    // 数组头，后面必须紧跟count个元素
+    void arrayHeader(size_t count) {
+        out += '*';
+        writeNumber(static_cast<long long>(count));
+        out += "\r\n";
+    }
+
+    // 元素个数事先不知道时（如按模式过滤的KEYS），先写元素，最后用endArray在开头补上数组头
+    size_t beginArray() {
+        return out.size();
+    }
+    void endArray(size_t position, size_t count) {
+        char header[32];
+        header[0] = '*';
+        auto result = std::to_chars(header + 1, header + sizeof(header) - 2, static_cast<long long>(count));
+        *result.ptr++ = '\r';
+        *result.ptr++ = '\n';
+        out.insert(position, header, result.ptr - header);
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef REPLYRENDERER_H
+#define REPLYRENDERER_H
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/*
+    ReplyRenderer 把服务器返回的RESP回复转换成redis-cli风格的文本，只在客户端使用
+    127.0.0.1:5555> mget a b
+    1) "1"
+    2) (nil)
+*/
+class ReplyRenderer {
+private:
+    // 字符串按redis-cli的方式加引号，不可打印的字节用\xhh表示
+    static void renderBulk(const std::string& resp, size_t pos, size_t len, std::string& out) {
+        out += '"';
+        for (size_t i = pos; i < pos + len && i < resp.size(); i++) {
+            unsigned char ch = resp[i];
+            switch (ch) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (ch < 0x20 || ch >= 0x7f) {
+                        char hex[5];
+                        snprintf(hex, sizeof(hex), "\\x%02x", ch);
+                        out += hex;
+                    } else {
+                        out += static_cast<char>(ch);
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    // 读取一行（不含\r\n），pos移动到下一行开头
+    static std::string readLine(const std::string& resp, size_t& pos) {
+        size_t end = resp.find("\r\n", pos);
+        if (end == std::string::npos) {
+            end = resp.size();
+        }
+        std::string line = resp.substr(pos, end - pos);
+        pos = end + 2;
+        return line;
+    }
+
+    // indent为数组元素换行后需要的缩进
+    static void renderValue(const std::string& resp, size_t& pos, size_t indent, std::string& out) {
+        if (pos >= resp.size()) {
+            return;
+        }
+        char type = resp[pos++];
+        std::string line = readLine(resp, pos);
+        switch (type) {
+            case '+':
+                out += line;
+                break;
+            case '-':
+                out += "(error) " + line;
+                break;
+            case ':':
+                out += "(integer) " + line;
+                break;
+            case '$': {
+                long long len = atoll(line.c_str());
+                if (len < 0) {
+                    out += "(nil)";
+                    break;
+                }
+                renderBulk(resp, pos, len, out);
+                pos += len + 2;
+                break;
+            }
+            case '*': {
+                long long count = atoll(line.c_str());
+                if (count < 0) {
+                    out += "(nil)";
+                    break;
+                }
+                if (count == 0) {
+                    out += "(empty list or set)";
+                    break;
+                }
+                for (long long i = 0; i < count; i++) {
+                    std::string prefix = std::to_string(i + 1) + ") ";
+                    if (i > 0) {
+                        out += '\n';
+                        out += std::string(indent, ' ');
+                    }
+                    out += prefix;
+                    renderValue(resp, pos, indent + prefix.size(), out);
+                }
+                break;
+            }
+            default:
+                out += type + line;
+        }
+    }
+
+public:
+    // 渲染一条完整回复；EXEC等回复中可能连续包含多条，逐条渲染
+    static std::string render(const std::string& resp) {
+        std::string out;
+        size_t pos = 0;
+        while (pos < resp.size()) {
+            if (!out.empty()) {
+                out += '\n';
+            }
+            renderValue(resp, pos, 0, out);
+        }
+        return out;
+    }
+};
+
+#endif
@@ -0,0 +1,1669 @@
+#include "ScriptVM.h"
+#include "Sha1.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// 编译和运行时的错误，只在本文件内抛出，compile和run负责转换成错误信息
+struct ScriptError {
+    std::string message;
+};
+
+// 内置函数，编译时按名字解析成编号
+enum Builtin {
+    BUILTIN_REDIS_CALL, BUILTIN_REDIS_PCALL, BUILTIN_REDIS_STATUS_REPLY, BUILTIN_REDIS_ERROR_REPLY, BUILTIN_REDIS_SHA1HEX,
+    BUILTIN_TONUMBER, BUILTIN_TOSTRING, BUILTIN_TYPE,
+    BUILTIN_STRING_LEN, BUILTIN_STRING_SUB, BUILTIN_STRING_UPPER, BUILTIN_STRING_LOWER, BUILTIN_STRING_REP,
+    BUILTIN_TABLE_INSERT, BUILTIN_TABLE_REMOVE, BUILTIN_TABLE_CONCAT,
+    BUILTIN_MATH_FLOOR, BUILTIN_MATH_CEIL, BUILTIN_MATH_ABS, BUILTIN_MATH_MAX, BUILTIN_MATH_MIN,
+    BUILTIN_COUNT
+};
+
+const char* const builtinNames[BUILTIN_COUNT] = {
+    "redis.call", "redis.pcall", "redis.status_reply", "redis.error_reply", "redis.sha1hex",
+    "tonumber", "tostring", "type",
+    "string.len", "string.sub", "string.upper", "string.lower", "string.rep",
+    "table.insert", "table.remove", "table.concat",
+    "math.floor", "math.ceil", "math.abs", "math.max", "math.min"
+};
+
+const char* const typeNames[] = {"nil", "boolean", "number", "string", "table"};
+
+const char* typeName(const ScriptValue& value) {
+    return typeNames[value.type()];
+}
+
+// 与Lua 5.1相同用%.14g格式化数字，整数不带小数点
+std::string formatNumber(double number) {
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%.14g", number);
+    return std::string(text, length);
+}
+
+// 字符串转数字，允许前后空白和0x开头的十六进制，与Lua的自动转换一致
+bool parseNumber(std::string_view text, double& number) {
+    std::string copy(text);
+    const char* begin = copy.c_str();
+    char* end = nullptr;
+    while (isspace(static_cast<unsigned char>(*begin))) {
+        begin++;
+    }
+    if (*begin == '\0') {
+        return false;
+    }
+    number = strtod(begin, &end);
+    if (end == begin) {
+        return false;
+    }
+    while (isspace(static_cast<unsigned char>(*end))) {
+        end++;
+    }
+    return *end == '\0';
+}
+
+bool toNumber(const ScriptValue& value, double& number) {
+    if (value.type() == ScriptValue::NUMBER) {
+        number = value.number();
+        return true;
+    }
+    return value.type() == ScriptValue::STRING && parseNumber(value.string(), number);
+}
+
+// 字符串和数字可以互相转换，其余类型返回false
+bool toText(const ScriptValue& value, std::string& text) {
+    if (value.type() == ScriptValue::STRING) {
+        text = value.string();
+        return true;
+    }
+    if (value.type() == ScriptValue::NUMBER) {
+        text = formatNumber(value.number());
+        return true;
+    }
+    return false;
+}
+
+// 整数值的数字返回true
+bool toIndex(double number, long long& index) {
+    if (!(number >= -9007199254740992.0 && number <= 9007199254740992.0) || std::floor(number) != number) {
+        return false;
+    }
+    index = static_cast<long long>(number);
+    return true;
+}
+
+std::shared_ptr<ScriptTable> newTable() {
+    return std::make_shared<ScriptTable>();
+}
+
+}
+
+bool ScriptValue::operator==(const ScriptValue& other) const {
+    if (type() != other.type()) {
+        return false;
+    }
+    switch (type()) {
+        case NIL:
+            return true;
+        case BOOLEAN:
+            return boolean() == other.boolean();
+        case NUMBER:
+            return number() == other.number();
+        case STRING:
+            return string() == other.string();
+        default:
+            return &table() == &other.table();
+    }
+}
+
+ScriptValue ScriptTable::get(const ScriptValue& key) const {
+    if (key.type() == ScriptValue::STRING) {
+        auto it = fields.find(key.string());
+        return it == fields.end() ? ScriptValue() : it->second;
+    }
+    if (key.type() != ScriptValue::NUMBER) {
+        return ScriptValue();
+    }
+    long long index;
+    if (toIndex(key.number(), index) && index >= 1 && static_cast<size_t>(index) <= array.size()) {
+        return array[index - 1];
+    }
+    auto it = numbers.find(key.number());
+    return it == numbers.end() ? ScriptValue() : it->second;
+}
+
+bool ScriptTable::set(const ScriptValue& key, ScriptValue value) {
+    if (key.type() == ScriptValue::STRING) {
+        if (value.isNil()) {
+            fields.erase(key.string());
+        } else {
+            fields[key.string()] = std::move(value);
+        }
+        return true;
+    }
+    if (key.type() != ScriptValue::NUMBER || std::isnan(key.number())) {
+        return false;
+    }
+    long long index;
+    if (toIndex(key.number(), index) && index >= 1 && static_cast<size_t>(index) <= array.size() + 1) {
+        if (static_cast<size_t>(index) <= array.size()) {
+            array[index - 1] = std::move(value);
+            //末尾的nil去掉，长度始终是最后一个非nil元素的位置
+            while (!array.empty() && array.back().isNil()) {
+                array.pop_back();
+            }
+            return true;
+        }
+        if (value.isNil()) {
+            return true;
+        }
+        array.push_back(std::move(value));
+        //数字键部分中紧接着的键移到数组部分
+        for (auto it = numbers.find(static_cast<double>(array.size() + 1)); it != numbers.end();
+             it = numbers.find(static_cast<double>(array.size() + 1))) {
+            array.push_back(std::move(it->second));
+            numbers.erase(it);
+        }
+        return true;
+    }
+    if (value.isNil()) {
+        numbers.erase(key.number());
+    } else {
+        numbers[key.number()] = std::move(value);
+    }
+    return true;
+}
+
+void ScriptTable::keys(std::vector<ScriptValue>& out) const {
+    for (size_t i = 0; i < array.size(); i++) {
+        if (!array[i].isNil()) {
+            out.emplace_back(static_cast<double>(i + 1));
+        }
+    }
+    for (auto& entry : numbers) {
+        out.emplace_back(entry.first);
+    }
+    for (auto& entry : fields) {
+        out.emplace_back(entry.first);
+    }
+}
+
+/*
+    词法分析
+    支持 -- 注释、--[[ ]] 块注释、'...' "..." 字符串（带转义）、[[...]] 长字符串、十进制和十六进制数字。
+*/
+namespace {
+
+struct Token {
+    enum Kind { END, NAME, NUMBER, STRING, KEYWORD, SYMBOL } kind = END;
+    std::string text; //名字、关键字、符号的文本或字符串的内容
+    double number = 0;
+    int line = 1;
+};
+
+class ScriptLexer {
+private:
+    std::string_view source;
+    size_t pos = 0;
+    int line = 1;
+
+    [[noreturn]] void fail(const std::string& message) {
+        throw ScriptError{"user_script:" + std::to_string(line) + ": " + message};
+    }
+
+    char peek(size_t offset = 0) const {
+        return pos + offset < source.size() ? source[pos + offset] : '\0';
+    }
+
+    // [[ 或 [==[ 开头时返回等号个数，否则返回-1
+    int longBracketLevel() const {
+        if (peek() != '[') {
+            return -1;
+        }
+        size_t offset = 1;
+        while (peek(offset) == '=') {
+            offset++;
+        }
+        return peek(offset) == '[' ? static_cast<int>(offset - 1) : -1;
+    }
+
+    std::string readLongString(int level) {
+        pos += level + 2;
+        //紧跟开头的换行不算内容
+        if (peek() == '\r') pos++;
+        if (peek() == '\n') pos++, line++;
+        std::string close = "]" + std::string(level, '=') + "]";
+        size_t end = source.find(close, pos);
+        if (end == std::string_view::npos) {
+            fail("unfinished long string");
+        }
+        std::string text(source.substr(pos, end - pos));
+        line += static_cast<int>(std::count(text.begin(), text.end(), '\n'));
+        pos = end + close.size();
+        return text;
+    }
+
+    void skipSpaceAndComments() {
+        while (pos < source.size()) {
+            char ch = source[pos];
+            if (ch == '\n') {
+                line++;
+                pos++;
+            } else if (isspace(static_cast<unsigned char>(ch))) {
+                pos++;
+            } else if (ch == '-' && peek(1) == '-') {
+                pos += 2;
+                int level = longBracketLevel();
+                if (level >= 0) {
+                    readLongString(level);
+                } else {
+                    while (pos < source.size() && source[pos] != '\n') {
+                        pos++;
+                    }
+                }
+            } else {
+                break;
+            }
+        }
+    }
+
+    std::string readQuoted(char quote) {
+        std::string text;
+        pos++;
+        while (true) {
+            if (pos >= source.size() || source[pos] == '\n') {
+                fail("unfinished string");
+            }
+            char ch = source[pos++];
+            if (ch == quote) {
+                return text;
+            }
+            if (ch != '\\') {
+                text += ch;
+                continue;
+            }
+            char escaped = peek();
+            pos++;
+            switch (escaped) {
+                case 'n': text += '\n'; break;
+                case 't': text += '\t'; break;
+                case 'r': text += '\r'; break;
+                case 'a': text += '\a'; break;
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'v': text += '\v'; break;
+                case '\\': text += '\\'; break;
+                case '"': text += '"'; break;
+                case '\'': text += '\''; break;
+                case '\n': text += '\n'; line++; break;
+                default:
+                    //\ddd 十进制字节
+                    if (isdigit(static_cast<unsigned char>(escaped))) {
+                        int value = escaped - '0';
+                        for (int i = 0; i < 2 && isdigit(static_cast<unsigned char>(peek())); i++) {
+                            value = value * 10 + (source[pos++] - '0');
+                        }
+                        if (value > 255) {
+                            fail("escape sequence too large");
+                        }
+                        text += static_cast<char>(value);
+                    } else {
+                        fail("invalid escape sequence");
+                    }
+            }
+        }
+    }
+
+public:
+    explicit ScriptLexer(std::string_view source) : source(source) {}
+
+    Token next() {
+        static const char* const keywords[] = {
+            "and", "break", "do", "else", "elseif", "end", "false", "for", "function", "if", "in",
+            "local", "nil", "not", "or", "repeat", "return", "then", "true", "until", "while"
+        };
+        skipSpaceAndComments();
+        Token token;
+        token.line = line;
+        if (pos >= source.size()) {
+            return token;
+        }
+        char ch = source[pos];
+        if (isalpha(static_cast<unsigned char>(ch)) || ch == '_') {
+            size_t start = pos;
+            while (isalnum(static_cast<unsigned char>(peek())) || peek() == '_') {
+                pos++;
+            }
+            token.text = std::string(source.substr(start, pos - start));
+            token.kind = Token::NAME;
+            for (auto keyword : keywords) {
+                if (token.text == keyword) {
+                    token.kind = Token::KEYWORD;
+                }
+            }
+            return token;
+        }
+        if (isdigit(static_cast<unsigned char>(ch)) || (ch == '.' && isdigit(static_cast<unsigned char>(peek(1))))) {
+            size_t start = pos;
+            while (isalnum(static_cast<unsigned char>(peek())) || peek() == '.' ||
+                   ((peek() == '+' || peek() == '-') && (source[pos - 1] == 'e' || source[pos - 1] == 'E'))) {
+                pos++;
+            }
+            token.text = std::string(source.substr(start, pos - start));
+            if (!parseNumber(token.text, token.number)) {
+                fail("malformed number near '" + token.text + "'");
+            }
+            token.kind = Token::NUMBER;
+            return token;
+        }
+        if (ch == '"' || ch == '\'') {
+            token.text = readQuoted(ch);
+            token.kind = Token::STRING;
+            return token;
+        }
+        int level = longBracketLevel();
+        if (level >= 0) {
+            token.text = readLongString(level);
+            token.kind = Token::STRING;
+            return token;
+        }
+        static const char* const symbols[] = {
+            "...", "==", "~=", "<=", ">=", "..",
+            "+", "-", "*", "/", "%", "^", "#", "<", ">", "=", "(", ")", "{", "}", "[", "]", ";", ":", ",", "."
+        };
+        for (auto symbol : symbols) {
+            size_t length = strlen(symbol);
+            if (source.substr(pos, length) == symbol) {
+                pos += length;
+                token.kind = Token::SYMBOL;
+                token.text = symbol;
+                return token;
+            }
+        }
+        fail(std::string("unexpected symbol near '") + ch + "'");
+    }
+};
+
+}
+
+/*
+    ScriptCompiler 递归下降，一遍生成字节码
+    表达式的结果有三种形态：已经在栈顶的值、局部变量槽位、栈顶的(表, 键)两项（t[k]），
+    赋值时按形态生成STORE或SETINDEX，读取时生成LOAD或GETINDEX。
+*/
+class ScriptCompiler {
+private:
+    struct Expr {
+        enum Kind { VALUE, LOCAL, INDEXED } kind = VALUE;
+        int slot = 0;
+        bool call = false; //最后一步是函数调用，可以作为语句
+    };
+
+    using Op = ScriptProgram::OpCode;
+
+    ScriptLexer lexer;
+    Token current;
+    Token lookahead;
+    bool hasLookahead = false;
+    int lastLine = 1;
+    int depth = 0;
+    ScriptProgram& program;
+    std::vector<std::string> locals;           //当前可见的局部变量，下标就是槽位
+    std::vector<std::vector<size_t>> breaks;   //每层循环中待回填的break跳转
+
+    [[noreturn]] void fail(const std::string& message, int line) {
+        throw ScriptError{"user_script:" + std::to_string(line) + ": " + message};
+    }
+
+    [[noreturn]] void failNear(const std::string& message) {
+        std::string near = current.kind == Token::END ? "<eof>" : current.text;
+        fail(message + " near '" + near + "'", current.line);
+    }
+
+    void advance() {
+        lastLine = current.line;
+        if (hasLookahead) {
+            current = std::move(lookahead);
+            hasLookahead = false;
+        } else {
+            current = lexer.next();
+        }
+    }
+
+    const Token& peekNext() {
+        if (!hasLookahead) {
+            lookahead = lexer.next();
+            hasLookahead = true;
+        }
+        return lookahead;
+    }
+
+    bool check(const char* text) const {
+        return (current.kind == Token::SYMBOL || current.kind == Token::KEYWORD) && current.text == text;
+    }
+
+    bool accept(const char* text) {
+        if (check(text)) {
+            advance();
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const char* text) {
+        if (!accept(text)) {
+            failNear(std::string("'") + text + "' expected");
+        }
+    }
+
+    std::string expectName() {
+        if (current.kind != Token::NAME) {
+            failNear("<name> expected");
+        }
+        std::string name = current.text;
+        advance();
+        return name;
+    }
+
+    size_t emit(Op op, int32_t a = 0, int32_t b = 0, int32_t c = 0) {
+        program.code.push_back({op, a, b, c});
+        program.lines.push_back(lastLine);
+        return program.code.size() - 1;
+    }
+
+    void patch(size_t at, size_t target) {
+        Op op = program.code[at].op;
+        //FORTEST和ITERNEXT的跳转目标在b中
+        if (op == ScriptProgram::OP_FORTEST || op == ScriptProgram::OP_ITERNEXT) {
+            program.code[at].b = static_cast<int32_t>(target);
+        } else {
+            program.code[at].a = static_cast<int32_t>(target);
+        }
+    }
+
+    size_t here() const {
+        return program.code.size();
+    }
+
+    void emitConstant(ScriptValue value) {
+        //同一个常量只保存一份
+        for (size_t i = 0; i < program.constants.size(); i++) {
+            if (program.constants[i] == value) {
+                emit(ScriptProgram::OP_CONST, static_cast<int32_t>(i));
+                return;
+            }
+        }
+        program.constants.push_back(std::move(value));
+        emit(ScriptProgram::OP_CONST, static_cast<int32_t>(program.constants.size() - 1));
+    }
+
+    int declareLocal(std::string name) {
+        locals.push_back(std::move(name));
+        program.slotCount = std::max(program.slotCount, static_cast<int>(locals.size()));
+        return static_cast<int>(locals.size() - 1);
+    }
+
+    int findLocal(const std::string& name) const {
+        for (size_t i = locals.size(); i > 0; i--) {
+            if (locals[i - 1] == name) {
+                return static_cast<int>(i - 1);
+            }
+        }
+        return -1;
+    }
+
+    void enterNesting() {
+        if (++depth > SCRIPT_NESTING_LIMIT) {
+            failNear("chunk has too many syntax levels");
+        }
+    }
+
+    bool blockFollows() const {
+        return current.kind == Token::END || check("end") || check("else") || check("elseif") || check("until");
+    }
+
+    // 把表达式的结果放到栈顶
+    void toValue(Expr& expr) {
+        if (expr.kind == Expr::LOCAL) {
+            emit(ScriptProgram::OP_LOAD, expr.slot);
+        } else if (expr.kind == Expr::INDEXED) {
+            emit(ScriptProgram::OP_GETINDEX);
+        }
+        expr.kind = Expr::VALUE;
+    }
+
+    void expression() {
+        subExpression(0);
+    }
+
+    // 参数列表，返回参数个数
+    int arguments() {
+        int line = current.line;
+        expect("(");
+        int count = 0;
+        if (!check(")")) {
+            do {
+                expression();
+                count++;
+            } while (accept(","));
+        }
+        if (!check(")")) {
+            fail("')' expected (to close '(' at line " + std::to_string(line) + ")", current.line);
+        }
+        advance();
+        return count;
+    }
+
+    // 全局名字只能是内置函数，库函数按"库.函数"解析
+    void builtinCall(const std::string& name, int line) {
+        std::string full = name;
+        if (name == "redis" || name == "string" || name == "table" || name == "math") {
+            if (!check(".")) {
+                fail("library '" + name + "' can only be used to call its functions", line);
+            }
+            advance();
+            full += "." + expectName();
+        }
+        int id = -1;
+        for (int i = 0; i < BUILTIN_COUNT; i++) {
+            if (full == builtinNames[i]) {
+                id = i;
+            }
+        }
+        if (id < 0) {
+            fail("Script attempted to access nonexistent global variable '" + full + "'", line);
+        }
+        if (!check("(")) {
+            fail("function '" + full + "' can only be called", line);
+        }
+        int count = arguments();
+        emit(ScriptProgram::OP_CALL, id, count);
+    }
+
+    void primaryExpression(Expr& expr) {
+        if (current.kind == Token::NAME) {
+            int line = current.line;
+            std::string name = current.text;
+            advance();
+            int slot = findLocal(name);
+            if (slot >= 0) {
+                expr.kind = Expr::LOCAL;
+                expr.slot = slot;
+                return;
+            }
+            builtinCall(name, line);
+            expr.kind = Expr::VALUE;
+            expr.call = true;
+            return;
+        }
+        if (accept("(")) {
+            expression();
+            expect(")");
+            expr.kind = Expr::VALUE;
+            return;
+        }
+        failNear("unexpected symbol");
+    }
+
+    // 名字或括号表达式后面跟着任意个 .name [exp]
+    void suffixedExpression(Expr& expr) {
+        primaryExpression(expr);
+        while (true) {
+            if (check(".")) {
+                advance();
+                toValue(expr);
+                emitConstant(expectName());
+                expr.kind = Expr::INDEXED;
+            } else if (check("[")) {
+                advance();
+                toValue(expr);
+                expression();
+                expect("]");
+                expr.kind = Expr::INDEXED;
+            } else if (check("(") || check(":") || current.kind == Token::STRING || check("{")) {
+                failNear("only built-in functions can be called");
+            } else {
+                return;
+            }
+            expr.call = false;
+        }
+    }
+
+    // {1, 2, x = 3, [k] = v}
+    void tableConstructor() {
+        int line = current.line;
+        expect("{");
+        emit(ScriptProgram::OP_NEWTABLE);
+        double index = 1;
+        while (!check("}")) {
+            if (check("[")) {
+                advance();
+                expression();
+                expect("]");
+                expect("=");
+                expression();
+            } else if (current.kind == Token::NAME && peekNext().kind == Token::SYMBOL && peekNext().text == "=") {
+                emitConstant(expectName());
+                expect("=");
+                expression();
+            } else {
+                emitConstant(index++);
+                expression();
+            }
+            emit(ScriptProgram::OP_TABLESET);
+            if (!accept(",") && !accept(";")) {
+                break;
+            }
+        }
+        if (!check("}")) {
+            fail("'}' expected (to close '{' at line " + std::to_string(line) + ")", current.line);
+        }
+        advance();
+    }
+
+    void simpleExpression() {
+        switch (current.kind) {
+            case Token::NUMBER:
+                emitConstant(current.number);
+                advance();
+                return;
+            case Token::STRING:
+                emitConstant(current.text);
+                advance();
+                return;
+            default:
+                break;
+        }
+        if (accept("nil")) {
+            emit(ScriptProgram::OP_NIL);
+        } else if (accept("true")) {
+            emit(ScriptProgram::OP_TRUE);
+        } else if (accept("false")) {
+            emit(ScriptProgram::OP_FALSE);
+        } else if (check("{")) {
+            tableConstructor();
+        } else if (check("function")) {
+            failNear("function definitions are not supported");
+        } else if (check("...")) {
+            failNear("'...' is not supported");
+        } else {
+            Expr expr;
+            suffixedExpression(expr);
+            toValue(expr);
+        }
+    }
+
+    // 二元运算符的左右优先级，与Lua 5.1相同；不是二元运算符时返回false
+    bool binaryOperator(Op& op, int& left, int& right) const {
+        static const struct {
+            const char* text;
+            Op op;
+            int left;
+            int right;
+        } operators[] = {
+            {"+", ScriptProgram::OP_ADD, 6, 6}, {"-", ScriptProgram::OP_SUB, 6, 6},
+            {"*", ScriptProgram::OP_MUL, 7, 7}, {"/", ScriptProgram::OP_DIV, 7, 7}, {"%", ScriptProgram::OP_MOD, 7, 7},
+            {"^", ScriptProgram::OP_POW, 10, 9}, {"..", ScriptProgram::OP_CONCAT, 5, 4},
+            {"==", ScriptProgram::OP_EQ, 3, 3}, {"~=", ScriptProgram::OP_NE, 3, 3},
+            {"<", ScriptProgram::OP_LT, 3, 3}, {"<=", ScriptProgram::OP_LE, 3, 3},
+            {">", ScriptProgram::OP_GT, 3, 3}, {">=", ScriptProgram::OP_GE, 3, 3},
+            {"and", ScriptProgram::OP_AND, 2, 2}, {"or", ScriptProgram::OP_OR, 1, 1}
+        };
+        for (auto& entry : operators) {
+            if (check(entry.text)) {
+                op = entry.op;
+                left = entry.left;
+                right = entry.right;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void subExpression(int limit) {
+        enterNesting();
+        const int unaryPriority = 8;
+        if (check("not") || check("-") || check("#")) {
+            Op op = check("not") ? ScriptProgram::OP_NOT : check("-") ? ScriptProgram::OP_NEG : ScriptProgram::OP_LEN;
+            advance();
+            subExpression(unaryPriority);
+            emit(op);
+        } else {
+            simpleExpression();
+        }
+        Op op;
+        int left, right;
+        while (binaryOperator(op, left, right) && left > limit) {
+            advance();
+            if (op == ScriptProgram::OP_AND || op == ScriptProgram::OP_OR) {
+                //短路：左值决定结果时保留左值并跳过右边，否则弹出左值再计算右边
+                size_t jump = emit(op);
+                subExpression(right);
+                patch(jump, here());
+            } else {
+                subExpression(right);
+                emit(op);
+            }
+        }
+        depth--;
+    }
+
+    void block() {
+        size_t scope = locals.size();
+        statements();
+        locals.resize(scope);
+    }
+
+    void statements() {
+        enterNesting();
+        while (!blockFollows()) {
+            if (check("return")) {
+                returnStatement();
+                break;
+            }
+            statement();
+        }
+        depth--;
+    }
+
+    void returnStatement() {
+        advance();
+        if (blockFollows() || check(";")) {
+            emit(ScriptProgram::OP_NIL);
+        } else {
+            expression();
+            if (check(",")) {
+                failNear("returning multiple values is not supported");
+            }
+        }
+        emit(ScriptProgram::OP_RETURN);
+        accept(";");
+        if (!blockFollows()) {
+            failNear("'end' expected");
+        }
+    }
+
+    void statement() {
+        if (accept(";")) {
+            return;
+        }
+        int line = current.line;
+        if (accept("if")) {
+            ifStatement(line);
+        } else if (accept("while")) {
+            whileStatement(line);
+        } else if (accept("do")) {
+            block();
+            expectClose("end", "do", line);
+        } else if (accept("for")) {
+            forStatement(line);
+        } else if (accept("repeat")) {
+            repeatStatement(line);
+        } else if (accept("local")) {
+            localStatement();
+        } else if (accept("break")) {
+            if (breaks.empty()) {
+                fail("no loop to break", line);
+            }
+            breaks.back().push_back(emit(ScriptProgram::OP_JUMP));
+        } else if (check("function")) {
+            failNear("function definitions are not supported");
+        } else {
+            expressionStatement();
+        }
+    }
+
+    void expectClose(const char* what, const char* opener, int line) {
+        if (check(what)) {
+            advance();
+            return;
+        }
+        if (line == current.line) {
+            failNear(std::string("'") + what + "' expected");
+        }
+        failNear(std::string("'") + what + "' expected (to close '" + opener + "' at line " + std::to_string(line) + ")");
+    }
+
+    void ifStatement(int line) {
+        std::vector<size_t> exits;
+        expression();
+        expect("then");
+        size_t skip = emit(ScriptProgram::OP_JUMP_IF_FALSE);
+        block();
+        while (check("elseif") || check("else")) {
+            exits.push_back(emit(ScriptProgram::OP_JUMP));
+            patch(skip, here());
+            if (accept("elseif")) {
+                expression();
+                expect("then");
+                skip = emit(ScriptProgram::OP_JUMP_IF_FALSE);
+                block();
+            } else {
+                advance();
+                block();
+                skip = SIZE_MAX;
+                break;
+            }
+        }
+        if (skip != SIZE_MAX) {
+            patch(skip, here());
+        }
+        expectClose("end", "if", line);
+        for (size_t jump : exits) {
+            patch(jump, here());
+        }
+    }
+
+    void enterLoop() {
+        breaks.emplace_back();
+    }
+
+    void leaveLoop() {
+        for (size_t jump : breaks.back()) {
+            patch(jump, here());
+        }
+        breaks.pop_back();
+    }
+
+    void whileStatement(int line) {
+        size_t start = here();
+        expression();
+        expect("do");
+        size_t exit = emit(ScriptProgram::OP_JUMP_IF_FALSE);
+        enterLoop();
+        block();
+        expectClose("end", "while", line);
+        emit(ScriptProgram::OP_JUMP, static_cast<int32_t>(start));
+        patch(exit, here());
+        leaveLoop();
+    }
+
+    void repeatStatement(int line) {
+        size_t start = here();
+        //until的条件可以使用循环体中的局部变量
+        size_t scope = locals.size();
+        enterLoop();
+        statements();
+        expectClose("until", "repeat", line);
+        expression();
+        emit(ScriptProgram::OP_JUMP_IF_FALSE, static_cast<int32_t>(start));
+        locals.resize(scope);
+        leaveLoop();
+    }
+
+    void forStatement(int line) {
+        size_t scope = locals.size();
+        std::string name = expectName();
+        if (accept("=")) {
+            //for i = start, limit[, step]：三个隐藏槽位保存计数器、终值、步长，第四个是循环变量
+            expression();
+            expect(",");
+            expression();
+            if (accept(",")) {
+                expression();
+            } else {
+                emitConstant(1.0);
+            }
+            int base = declareLocal("(for index)");
+            declareLocal("(for limit)");
+            declareLocal("(for step)");
+            emit(ScriptProgram::OP_STORE, base + 2);
+            emit(ScriptProgram::OP_STORE, base + 1);
+            emit(ScriptProgram::OP_STORE, base);
+            declareLocal(name);
+            expect("do");
+            size_t loop = emit(ScriptProgram::OP_FORTEST, base);
+            enterLoop();
+            block();
+            expectClose("end", "for", line);
+            emit(ScriptProgram::OP_FORSTEP, base, static_cast<int32_t>(loop));
+            patch(loop, here());
+            leaveLoop();
+        } else {
+            //for k, v in pairs(t)/ipairs(t)：隐藏槽位保存表、键列表、位置，后两个是循环变量
+            std::string valueName = accept(",") ? expectName() : "(for value)";
+            expect("in");
+            if (current.kind != Token::NAME || (current.text != "pairs" && current.text != "ipairs")) {
+                failNear("only pairs() and ipairs() can be iterated");
+            }
+            int mode = current.text == "pairs" ? 1 : 0;
+            advance();
+            if (arguments() != 1) {
+                fail(std::string("bad argument #1 to '") + (mode ? "pairs" : "ipairs") + "' (table expected)", line);
+            }
+            int base = declareLocal("(for table)");
+            declareLocal("(for keys)");
+            declareLocal("(for position)");
+            emit(ScriptProgram::OP_ITERPREP, base, mode);
+            declareLocal(name);
+            declareLocal(valueName);
+            expect("do");
+            size_t loop = emit(ScriptProgram::OP_ITERNEXT, base, 0, mode);
+            enterLoop();
+            block();
+            expectClose("end", "for", line);
+            emit(ScriptProgram::OP_JUMP, static_cast<int32_t>(loop));
+            patch(loop, here());
+            leaveLoop();
+        }
+        locals.resize(scope);
+    }
+
+    void localStatement() {
+        if (check("function")) {
+            failNear("function definitions are not supported");
+        }
+        std::vector<std::string> names;
+        do {
+            names.push_back(expectName());
+        } while (accept(","));
+        //初始值在声明之前计算，local x = x 读到的是外层的x
+        int count = 0;
+        if (accept("=")) {
+            do {
+                expression();
+                count++;
+            } while (accept(","));
+        }
+        for (; count > static_cast<int>(names.size()); count--) {
+            emit(ScriptProgram::OP_POP);
+        }
+        for (; count < static_cast<int>(names.size()); count++) {
+            emit(ScriptProgram::OP_NIL);
+        }
+        int base = static_cast<int>(locals.size());
+        for (auto& name : names) {
+            declareLocal(name);
+        }
+        for (int i = static_cast<int>(names.size()) - 1; i >= 0; i--) {
+            emit(ScriptProgram::OP_STORE, base + i);
+        }
+    }
+
+    void expressionStatement() {
+        Expr target;
+        suffixedExpression(target);
+        if (check(",")) {
+            failNear("multiple assignment is only supported in local declarations");
+        }
+        if (!accept("=")) {
+            if (!target.call) {
+                failNear("syntax error");
+            }
+            emit(ScriptProgram::OP_POP);
+            return;
+        }
+        if (target.kind == Expr::VALUE) {
+            fail("cannot assign to this expression", lastLine);
+        }
+        expression();
+        if (target.kind == Expr::LOCAL) {
+            emit(ScriptProgram::OP_STORE, target.slot);
+        } else {
+            emit(ScriptProgram::OP_SETINDEX);
+        }
+    }
+
+public:
+    ScriptCompiler(std::string_view source, ScriptProgram& program) : lexer(source), program(program) {
+        locals = {"KEYS", "ARGV"};
+    }
+
+    void compile() {
+        advance();
+        statements();
+        if (current.kind != Token::END) {
+            failNear("'<eof>' expected");
+        }
+        emit(ScriptProgram::OP_NIL);
+        emit(ScriptProgram::OP_RETURN);
+    }
+};
+
+std::shared_ptr<const ScriptProgram> ScriptProgram::compile(std::string_view source, std::string& error) {
+    auto program = std::make_shared<ScriptProgram>();
+    try {
+        ScriptCompiler(source, *program).compile();
+    } catch (ScriptError& e) {
+        error = "Error compiling script (new function): " + e.message;
+        return nullptr;
+    }
+    return program;
+}
+
+/*
+    运行时
+*/
+namespace {
+
+// redis.call的RESP回复转换成脚本中的值：整数->数字，字符串->字符串，nil->false，数组->表，
+// 状态->{ok=...}，错误->{err=...}
+bool decodeReply(const char*& pos, const char* end, ScriptValue& value, int depth) {
+    const char* lineEnd = static_cast<const char*>(memchr(pos, '\r', end - pos));
+    if (depth > SCRIPT_NESTING_LIMIT || lineEnd == nullptr || lineEnd + 1 >= end) {
+        return false;
+    }
+    char type = *pos;
+    std::string_view text(pos + 1, lineEnd - pos - 1);
+    pos = lineEnd + 2;
+    long long count = 0;
+    switch (type) {
+        case '+':
+        case '-': {
+            auto table = newTable();
+            table->fields[type == '+' ? "ok" : "err"] = std::string(text);
+            value = table;
+            return true;
+        }
+        case ':':
+            if (!parseInteger(text, count)) {
+                return false;
+            }
+            value = static_cast<double>(count);
+            return true;
+        case '$':
+            if (!parseInteger(text, count)) {
+                return false;
+            }
+            if (count < 0) {
+                value = false;
+                return true;
+            }
+            if (count + 2 > end - pos) {
+                return false;
+            }
+            value = std::string(pos, count);
+            pos += count + 2;
+            return true;
+        case '*': {
+            if (!parseInteger(text, count)) {
+                return false;
+            }
+            if (count < 0) {
+                value = false;
+                return true;
+            }
+            auto table = newTable();
+            table->array.resize(count);
+            for (auto& item : table->array) {
+                if (!decodeReply(pos, end, item, depth + 1)) {
+                    return false;
+                }
+            }
+            //数组中的nil在Lua中是false，不会截断
+            value = table;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// 脚本的返回值按Redis的规则写成回复
+void encodeReply(const ScriptValue& value, ReplyBuilder& reply, int depth) {
+    switch (value.type()) {
+        case ScriptValue::NIL:
+            return reply.nil();
+        case ScriptValue::BOOLEAN:
+            return value.boolean() ? reply.integer(1) : reply.nil();
+        case ScriptValue::NUMBER: {
+            double number = value.number();
+            //Lua的数字转成整数时截断小数部分
+            if (!std::isfinite(number) || std::fabs(number) >= 9.2e18) {
+                return reply.integer(number > 0 ? INT64_MAX : number < 0 ? INT64_MIN : 0);
+            }
+            return reply.integer(static_cast<long long>(number));
+        }
+        case ScriptValue::STRING:
+            return reply.bulk(value.string());
+        default:
+            break;
+    }
+    const ScriptTable& table = value.table();
+    auto err = table.fields.find("err");
+    if (err != table.fields.end() && err->second.type() == ScriptValue::STRING) {
+        //"CODE message"形式的错误保留错误类型
+        const std::string& message = err->second.string();
+        size_t space = message.find(' ');
+        if (space != std::string::npos && space > 0 &&
+            std::all_of(message.begin(), message.begin() + space, [](char ch) { return isupper(static_cast<unsigned char>(ch)); })) {
+            return reply.error(std::string_view(message).substr(0, space), std::string_view(message).substr(space + 1));
+        }
+        return reply.error(message);
+    }
+    auto ok = table.fields.find("ok");
+    if (ok != table.fields.end() && ok->second.type() == ScriptValue::STRING) {
+        return reply.status(ok->second.string());
+    }
+    //数组部分到第一个nil为止，嵌套过深（如表包含自身）的元素返回nil
+    size_t count = 0;
+    while (count < table.array.size() && !table.array[count].isNil()) {
+        count++;
+    }
+    reply.arrayHeader(count);
+    for (size_t i = 0; i < count; i++) {
+        if (depth >= SCRIPT_NESTING_LIMIT) {
+            reply.nil();
+        } else {
+            encodeReply(table.array[i], reply, depth + 1);
+        }
+    }
+}
+
+class ScriptMachine {
+private:
+    const ScriptProgram::CommandCaller& caller;
+    std::vector<std::string> callArgs;
+    std::vector<std::string_view> callViews;
+    std::string callReply;
+
+    [[noreturn]] static void fail(const std::string& message) {
+        throw ScriptError{message};
+    }
+
+    static double checkNumber(const ScriptValue* args, int argc, int index, const char* name) {
+        double number;
+        if (index >= argc || !toNumber(args[index], number)) {
+            fail(std::string("bad argument #") + std::to_string(index + 1) + " to '" + name + "' (number expected, got " +
+                 (index < argc ? typeName(args[index]) : "no value") + ")");
+        }
+        return number;
+    }
+
+    static long long checkInteger(const ScriptValue* args, int argc, int index, const char* name) {
+        double number = checkNumber(args, argc, index, name);
+        return static_cast<long long>(std::max(-9.0e18, std::min(9.0e18, std::floor(number))));
+    }
+
+    static std::string checkString(const ScriptValue* args, int argc, int index, const char* name) {
+        std::string text;
+        if (index >= argc || !toText(args[index], text)) {
+            fail(std::string("bad argument #") + std::to_string(index + 1) + " to '" + name + "' (string expected, got " +
+                 (index < argc ? typeName(args[index]) : "no value") + ")");
+        }
+        return text;
+    }
+
+    static ScriptTable& checkTable(const ScriptValue* args, int argc, int index, const char* name) {
+        if (index >= argc || args[index].type() != ScriptValue::TABLE) {
+            fail(std::string("bad argument #") + std::to_string(index + 1) + " to '" + name + "' (table expected, got " +
+                 (index < argc ? typeName(args[index]) : "no value") + ")");
+        }
+        return args[index].table();
+    }
+
+    ScriptValue redisCall(const ScriptValue* args, int argc, bool protect) {
+        if (argc == 0) {
+            fail("Please specify at least one argument for this redis lib call");
+        }
+        callArgs.resize(argc);
+        for (int i = 0; i < argc; i++) {
+            if (!toText(args[i], callArgs[i])) {
+                fail("Lua redis lib command arguments must be strings or integers");
+            }
+        }
+        callViews.assign(callArgs.begin(), callArgs.end());
+        callReply.clear();
+        ReplyBuilder reply(callReply);
+        caller(ArgSpan(callViews), reply);
+        ScriptValue result;
+        const char* pos = callReply.data();
+        if (!decodeReply(pos, callReply.data() + callReply.size(), result, 0)) {
+            fail("Unexpected reply from the command");
+        }
+        if (!protect && callReply[0] == '-') {
+            fail(result.table().fields["err"].string());
+        }
+        return result;
+    }
+
+    static ScriptValue replyTable(const char* field, const ScriptValue* args, int argc, const char* name) {
+        auto table = newTable();
+        table->fields[field] = checkString(args, argc, 0, name);
+        return table;
+    }
+
+    static ScriptValue substring(const std::string& text, long long start, long long end) {
+        long long length = static_cast<long long>(text.size());
+        //负数从末尾开始计数，下标从1开始，包含两端
+        if (start < 0) start = std::max(length + start + 1, 1LL);
+        if (start == 0) start = 1;
+        if (end < 0) end = length + end + 1;
+        if (end > length) end = length;
+        if (start > end) {
+            return std::string();
+        }
+        return text.substr(start - 1, end - start + 1);
+    }
+
+public:
+    explicit ScriptMachine(const ScriptProgram::CommandCaller& caller) : caller(caller) {}
+
+    ScriptValue call(int id, const ScriptValue* args, int argc) {
+        const char* name = builtinNames[id];
+        switch (id) {
+            case BUILTIN_REDIS_CALL:
+                return redisCall(args, argc, false);
+            case BUILTIN_REDIS_PCALL:
+                return redisCall(args, argc, true);
+            case BUILTIN_REDIS_STATUS_REPLY:
+                return replyTable("ok", args, argc, name);
+            case BUILTIN_REDIS_ERROR_REPLY:
+                return replyTable("err", args, argc, name);
+            case BUILTIN_REDIS_SHA1HEX:
+                return Sha1::hex(checkString(args, argc, 0, name));
+            case BUILTIN_TONUMBER: {
+                double number;
+                if (argc == 0) {
+                    fail("bad argument #1 to 'tonumber' (value expected)");
+                }
+                return toNumber(args[0], number) ? ScriptValue(number) : ScriptValue();
+            }
+            case BUILTIN_TOSTRING: {
+                if (argc == 0) {
+                    fail("bad argument #1 to 'tostring' (value expected)");
+                }
+                std::string text;
+                switch (args[0].type()) {
+                    case ScriptValue::NIL:
+                        return "nil";
+                    case ScriptValue::BOOLEAN:
+                        return args[0].boolean() ? "true" : "false";
+                    case ScriptValue::TABLE: {
+                        char address[32];
+                        snprintf(address, sizeof(address), "table: %p", static_cast<void*>(&args[0].table()));
+                        return address;
+                    }
+                    default:
+                        toText(args[0], text);
+                        return text;
+                }
+            }
+            case BUILTIN_TYPE:
+                if (argc == 0) {
+                    fail("bad argument #1 to 'type' (value expected)");
+                }
+                return typeName(args[0]);
+            case BUILTIN_STRING_LEN:
+                return static_cast<double>(checkString(args, argc, 0, name).size());
+            case BUILTIN_STRING_SUB: {
+                std::string text = checkString(args, argc, 0, name);
+                long long start = checkInteger(args, argc, 1, name);
+                long long end = argc > 2 && !args[2].isNil() ? checkInteger(args, argc, 2, name) : -1;
+                return substring(text, start, end);
+            }
+            case BUILTIN_STRING_UPPER:
+            case BUILTIN_STRING_LOWER: {
+                std::string text = checkString(args, argc, 0, name);
+                for (auto& ch : text) {
+                    ch = static_cast<char>(id == BUILTIN_STRING_UPPER ? toupper(static_cast<unsigned char>(ch))
+                                                                      : tolower(static_cast<unsigned char>(ch)));
+                }
+                return text;
+            }
+            case BUILTIN_STRING_REP: {
+                std::string text = checkString(args, argc, 0, name);
+                long long times = checkInteger(args, argc, 1, name);
+                if (times > 0 && text.size() * static_cast<unsigned long long>(times) > SCRIPT_STRING_LIMIT) {
+                    fail("resulting string too large");
+                }
+                std::string result;
+                for (long long i = 0; i < times; i++) {
+                    result += text;
+                }
+                return result;
+            }
+            case BUILTIN_TABLE_INSERT: {
+                ScriptTable& table = checkTable(args, argc, 0, name);
+                if (argc == 2) {
+                    table.set(static_cast<double>(table.length() + 1), args[1]);
+                    return ScriptValue();
+                }
+                if (argc != 3) {
+                    fail("wrong number of arguments to 'insert'");
+                }
+                long long position = checkInteger(args, argc, 1, name);
+                if (position < 1 || static_cast<size_t>(position) > table.length() + 1) {
+                    fail("bad argument #2 to 'insert' (position out of bounds)");
+                }
+                if (args[2].isNil()) {
+                    return ScriptValue();
+                }
+                table.array.insert(table.array.begin() + (position - 1), args[2]);
+                return ScriptValue();
+            }
+            case BUILTIN_TABLE_REMOVE: {
+                ScriptTable& table = checkTable(args, argc, 0, name);
+                long long size = static_cast<long long>(table.length());
+                long long position = argc > 1 ? checkInteger(args, argc, 1, name) : size;
+                if (size == 0 || position < 1 || position > size) {
+                    return ScriptValue();
+                }
+                ScriptValue removed = table.array[position - 1];
+                table.array.erase(table.array.begin() + (position - 1));
+                while (!table.array.empty() && table.array.back().isNil()) {
+                    table.array.pop_back();
+                }
+                return removed;
+            }
+            case BUILTIN_TABLE_CONCAT: {
+                ScriptTable& table = checkTable(args, argc, 0, name);
+                std::string separator = argc > 1 ? checkString(args, argc, 1, name) : "";
+                std::string result, text;
+                for (size_t i = 0; i < table.length(); i++) {
+                    if (!toText(table.array[i], text)) {
+                        fail("invalid value (at index " + std::to_string(i + 1) + ") in table for 'concat'");
+                    }
+                    result += i > 0 ? separator : "";
+                    result += text;
+                }
+                return result;
+            }
+            case BUILTIN_MATH_FLOOR:
+                return std::floor(checkNumber(args, argc, 0, name));
+            case BUILTIN_MATH_CEIL:
+                return std::ceil(checkNumber(args, argc, 0, name));
+            case BUILTIN_MATH_ABS:
+                return std::fabs(checkNumber(args, argc, 0, name));
+            case BUILTIN_MATH_MAX:
+            case BUILTIN_MATH_MIN: {
+                double result = checkNumber(args, argc, 0, name);
+                for (int i = 1; i < argc; i++) {
+                    double number = checkNumber(args, argc, i, name);
+                    result = id == BUILTIN_MATH_MAX ? std::max(result, number) : std::min(result, number);
+                }
+                return result;
+            }
+            default:
+                fail("unknown function");
+        }
+    }
+};
+
+ScriptValue argumentTable(ArgSpan args) {
+    auto table = newTable();
+    table->array.reserve(args.size());
+    for (auto& arg : args) {
+        table->array.emplace_back(std::string(arg));
+    }
+    return table;
+}
+
+[[noreturn]] void arithmeticError(const ScriptValue& left, const ScriptValue& right) {
+    double number;
+    const ScriptValue& bad = toNumber(left, number) ? right : left;
+    throw ScriptError{std::string("attempt to perform arithmetic on a ") + typeName(bad) + " value"};
+}
+
+}
+
+void ScriptProgram::run(ArgSpan keys, ArgSpan args, const CommandCaller& caller, std::string_view name,
+                        ReplyBuilder& reply) const {
+    std::vector<ScriptValue> slots(slotCount);
+    slots[0] = argumentTable(keys);
+    slots[1] = argumentTable(args);
+    std::vector<ScriptValue> stack;
+    stack.reserve(32);
+    ScriptMachine machine(caller);
+    size_t pc = 0;
+    uint64_t steps = 0;
+    auto pop = [&stack]() {
+        ScriptValue value = std::move(stack.back());
+        stack.pop_back();
+        return value;
+    };
+    try {
+        while (true) {
+            if (++steps > SCRIPT_INSTRUCTION_LIMIT) {
+                throw ScriptError{"Script exceeded the instruction limit and was aborted"};
+            }
+            const Instruction& ins = code[pc++];
+            switch (ins.op) {
+                case OP_NIL:
+                    stack.emplace_back();
+                    break;
+                case OP_TRUE:
+                    stack.emplace_back(true);
+                    break;
+                case OP_FALSE:
+                    stack.emplace_back(false);
+                    break;
+                case OP_CONST:
+                    stack.push_back(constants[ins.a]);
+                    break;
+                case OP_LOAD:
+                    stack.push_back(slots[ins.a]);
+                    break;
+                case OP_STORE:
+                    slots[ins.a] = pop();
+                    break;
+                case OP_POP:
+                    stack.pop_back();
+                    break;
+                case OP_NEWTABLE:
+                    stack.emplace_back(newTable());
+                    break;
+                case OP_TABLESET: {
+                    ScriptValue value = pop();
+                    ScriptValue key = pop();
+                    if (!stack.back().table().set(key, std::move(value))) {
+                        throw ScriptError{key.isNil() ? "table index is nil" : "table index is invalid"};
+                    }
+                    break;
+                }
+                case OP_GETINDEX: {
+                    ScriptValue key = pop();
+                    ScriptValue table = pop();
+                    if (table.type() != ScriptValue::TABLE) {
+                        throw ScriptError{std::string("attempt to index a ") + typeName(table) + " value"};
+                    }
+                    stack.push_back(table.table().get(key));
+                    break;
+                }
+                case OP_SETINDEX: {
+                    ScriptValue value = pop();
+                    ScriptValue key = pop();
+                    ScriptValue table = pop();
+                    if (table.type() != ScriptValue::TABLE) {
+                        throw ScriptError{std::string("attempt to index a ") + typeName(table) + " value"};
+                    }
+                    if (!table.table().set(key, std::move(value))) {
+                        throw ScriptError{key.isNil() ? "table index is nil" : "table index is invalid"};
+                    }
+                    break;
+                }
+                case OP_ADD:
+                case OP_SUB:
+                case OP_MUL:
+                case OP_DIV:
+                case OP_MOD:
+                case OP_POW: {
+                    ScriptValue right = pop();
+                    ScriptValue& left = stack.back();
+                    double a, b;
+                    if (!toNumber(left, a) || !toNumber(right, b)) {
+                        arithmeticError(left, right);
+                    }
+                    double result = ins.op == OP_ADD ? a + b
+                                  : ins.op == OP_SUB ? a - b
+                                  : ins.op == OP_MUL ? a * b
+                                  : ins.op == OP_DIV ? a / b
+                                  : ins.op == OP_MOD ? a - std::floor(a / b) * b
+                                  : std::pow(a, b);
+                    left = result;
+                    break;
+                }
+                case OP_CONCAT: {
+                    ScriptValue right = pop();
+                    ScriptValue& left = stack.back();
+                    std::string a, b;
+                    if (!toText(left, a) || !toText(right, b)) {
+                        const ScriptValue& bad = toText(left, a) ? right : left;
+                        throw ScriptError{std::string("attempt to concatenate a ") + typeName(bad) + " value"};
+                    }
+                    left = a + b;
+                    break;
+                }
+                case OP_EQ:
+                case OP_NE: {
+                    ScriptValue right = pop();
+                    ScriptValue& left = stack.back();
+                    bool equal = left == right;
+                    left = ins.op == OP_EQ ? equal : !equal;
+                    break;
+                }
+                case OP_LT:
+                case OP_LE:
+                case OP_GT:
+                case OP_GE: {
+                    ScriptValue right = pop();
+                    ScriptValue& left = stack.back();
+                    int order;
+                    if (left.type() == ScriptValue::NUMBER && right.type() == ScriptValue::NUMBER) {
+                        order = left.number() < right.number() ? -1 : left.number() > right.number() ? 1 : 0;
+                        //NaN与任何数比较都为假
+                        if (std::isnan(left.number()) || std::isnan(right.number())) {
+                            left = false;
+                            break;
+                        }
+                    } else if (left.type() == ScriptValue::STRING && right.type() == ScriptValue::STRING) {
+                        order = left.string().compare(right.string());
+                    } else {
+                        throw ScriptError{std::string("attempt to compare ") + typeName(left) + " with " + typeName(right)};
+                    }
+                    left = ins.op == OP_LT ? order < 0 : ins.op == OP_LE ? order <= 0 : ins.op == OP_GT ? order > 0 : order >= 0;
+                    break;
+                }
+                case OP_NOT:
+                    stack.back() = !stack.back().truthy();
+                    break;
+                case OP_NEG: {
+                    double number;
+                    if (!toNumber(stack.back(), number)) {
+                        arithmeticError(stack.back(), stack.back());
+                    }
+                    stack.back() = -number;
+                    break;
+                }
+                case OP_LEN: {
+                    ScriptValue& value = stack.back();
+                    if (value.type() == ScriptValue::STRING) {
+                        value = static_cast<double>(value.string().size());
+                    } else if (value.type() == ScriptValue::TABLE) {
+                        value = static_cast<double>(value.table().length());
+                    } else {
+                        throw ScriptError{std::string("attempt to get length of a ") + typeName(value) + " value"};
+                    }
+                    break;
+                }
+                case OP_JUMP:
+                    pc = ins.a;
+                    break;
+                case OP_JUMP_IF_FALSE:
+                    if (!pop().truthy()) {
+                        pc = ins.a;
+                    }
+                    break;
+                case OP_AND:
+                    if (!stack.back().truthy()) {
+                        pc = ins.a;
+                    } else {
+                        stack.pop_back();
+                    }
+                    break;
+                case OP_OR:
+                    if (stack.back().truthy()) {
+                        pc = ins.a;
+                    } else {
+                        stack.pop_back();
+                    }
+                    break;
+                case OP_FORTEST: {
+                    double index, limit, step;
+                    if (!toNumber(slots[ins.a], index)) {
+                        throw ScriptError{"'for' initial value must be a number"};
+                    }
+                    if (!toNumber(slots[ins.a + 1], limit)) {
+                        throw ScriptError{"'for' limit must be a number"};
+                    }
+                    if (!toNumber(slots[ins.a + 2], step)) {
+                        throw ScriptError{"'for' step must be a number"};
+                    }
+                    if (step > 0 ? index <= limit : index >= limit) {
+                        slots[ins.a + 3] = index;
+                    } else {
+                        pc = ins.b;
+                    }
+                    break;
+                }
+                case OP_FORSTEP:
+                    //FORTEST已经检查过类型，计数器一定是数字
+                    slots[ins.a] = slots[ins.a].number() + slots[ins.a + 2].number();
+                    pc = ins.b;
+                    break;
+                case OP_ITERPREP: {
+                    ScriptValue table = pop();
+                    if (table.type() != ScriptValue::TABLE) {
+                        throw ScriptError{std::string("bad argument #1 to '") + (ins.b ? "pairs" : "ipairs") +
+                                          "' (table expected, got " + typeName(table) + ")"};
+                    }
+                    //pairs先取下所有键，循环中修改表不影响遍历
+                    if (ins.b) {
+                        auto keys = newTable();
+                        table.table().keys(keys->array);
+                        slots[ins.a + 1] = keys;
+                    }
+                    slots[ins.a] = std::move(table);
+                    slots[ins.a + 2] = 0.0;
+                    break;
+                }
+                case OP_ITERNEXT: {
+                    ScriptTable& table = slots[ins.a].table();
+                    double position = slots[ins.a + 2].number();
+                    bool found = false;
+                    if (ins.c) {
+                        const auto& keys = slots[ins.a + 1].table().array;
+                        while (!found && position < keys.size()) {
+                            const ScriptValue& key = keys[static_cast<size_t>(position++)];
+                            ScriptValue value = table.get(key);
+                            if (!value.isNil()) {
+                                slots[ins.a + 3] = key;
+                                slots[ins.a + 4] = std::move(value);
+                                found = true;
+                            }
+                        }
+                    } else {
+                        ScriptValue value = table.get(++position);
+                        if (!value.isNil()) {
+                            slots[ins.a + 3] = position;
+                            slots[ins.a + 4] = std::move(value);
+                            found = true;
+                        }
+                    }
+                    slots[ins.a + 2] = position;
+                    if (!found) {
+                        pc = ins.b;
+                    }
+                    break;
+                }
+                case OP_CALL: {
+                    size_t first = stack.size() - ins.b;
+                    ScriptValue result = machine.call(ins.a, stack.data() + first, ins.b);
+                    stack.resize(first);
+                    stack.push_back(std::move(result));
+                    break;
+                }
+                case OP_RETURN:
+                    return encodeReply(stack.back(), reply, 0);
+            }
+        }
+    } catch (ScriptError& e) {
+        reply.error("Error running script (call to " + std::string(name) + "): @user_script:" +
+                    std::to_string(lines[pc - 1]) + ": " + e.message);
+    }
+}
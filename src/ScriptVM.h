@@ -0,0 +1,115 @@
+#ifndef SCRIPTVM_H
+#define SCRIPTVM_H
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include "CommandArgs.h"
+#include "ReplyBuilder.h"
+
+#define SCRIPT_INSTRUCTION_LIMIT 100000000 //一次执行最多运行的指令数，死循环的脚本不会一直占着命令锁
+#define SCRIPT_NESTING_LIMIT 200           //表达式和语句块的最大嵌套层数，防止编译时递归过深
+#define SCRIPT_STRING_LIMIT (512ULL << 20)  //string.rep生成的字符串的最大字节数，与Redis字符串值的上限相同
+
+struct ScriptTable;
+
+// 脚本中的值：nil、布尔、数字（与Lua 5.1相同都是双精度）、字符串、表（按引用共享）
+class ScriptValue {
+public:
+    enum Type { NIL, BOOLEAN, NUMBER, STRING, TABLE };
+
+private:
+    std::variant<std::monostate, bool, double, std::string, std::shared_ptr<ScriptTable>> data;
+
+public:
+    ScriptValue() = default;
+    ScriptValue(bool value) : data(value) {}
+    ScriptValue(double value) : data(value) {}
+    ScriptValue(std::string value) : data(std::move(value)) {}
+    ScriptValue(const char* value) : data(std::string(value)) {} //否则字符串字面量会转换成bool
+    ScriptValue(std::shared_ptr<ScriptTable> table) : data(std::move(table)) {}
+
+    Type type() const { return static_cast<Type>(data.index()); }
+    bool isNil() const { return type() == NIL; }
+    // 只有nil和false为假
+    bool truthy() const { return type() != NIL && !(type() == BOOLEAN && !std::get<bool>(data)); }
+    bool boolean() const { return std::get<bool>(data); }
+    double number() const { return std::get<double>(data); }
+    const std::string& string() const { return std::get<std::string>(data); }
+    ScriptTable& table() const { return *std::get<std::shared_ptr<ScriptTable>>(data); }
+    bool operator==(const ScriptValue& other) const;
+};
+
+/*
+    脚本中的表
+    1..n的连续整数键放在数组部分，其余数字键和字符串键放在两个有序表中，
+    redis.call返回的数组和{a, b, c}这样的构造都只用到数组部分。
+*/
+struct ScriptTable {
+    std::vector<ScriptValue> array;
+    std::map<double, ScriptValue> numbers;
+    std::map<std::string, ScriptValue, std::less<>> fields;
+
+    ScriptValue get(const ScriptValue& key) const;
+    // 键为nil、NaN、布尔或表时返回false
+    bool set(const ScriptValue& key, ScriptValue value);
+    size_t length() const { return array.size(); }
+    // 按数组部分、数字键、字符串键的顺序列出所有键（pairs）
+    void keys(std::vector<ScriptValue>& out) const;
+};
+
+/*
+    ScriptProgram 编译好的脚本
+    语言是Lua 5.1的一个子集，足够写"读-判断-写"这类原子操作：
+        local、赋值、if/elseif/else、while、repeat/until、数字for、for k, v in pairs/ipairs(t)、break、return、do/end
+        算术 + - * / % ^、比较、and/or/not、连接 ..、长度 #、表构造 {1, 2, x = 3}、t[k]、t.k
+        KEYS、ARGV以及内置函数：
+            redis.call/pcall/status_reply/error_reply/sha1hex
+            tonumber/tostring/type
+            string.len/sub/upper/lower/rep  table.insert/remove/concat  math.floor/ceil/abs/max/min
+    不支持自定义函数、闭包和元表，不能创建全局变量（与Redis相同，全局变量会在不同脚本之间泄露状态）。
+    变量在编译时解析成槽位编号，运行时不按名字查找；指令在一个值栈上执行。
+    编译结果不可变，可以被多次执行（EVALSHA直接复用缓存的程序）。
+*/
+class ScriptProgram {
+public:
+    enum OpCode : uint8_t {
+        OP_NIL, OP_TRUE, OP_FALSE, OP_CONST, OP_LOAD, OP_STORE, OP_POP,
+        OP_NEWTABLE, OP_TABLESET, OP_GETINDEX, OP_SETINDEX,
+        OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW, OP_CONCAT,
+        OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE, OP_NOT, OP_NEG, OP_LEN,
+        OP_JUMP, OP_JUMP_IF_FALSE, OP_AND, OP_OR,
+        OP_FORTEST, OP_FORSTEP, OP_ITERPREP, OP_ITERNEXT,
+        OP_CALL, OP_RETURN
+    };
+
+    struct Instruction {
+        OpCode op;
+        int32_t a = 0;
+        int32_t b = 0;
+        int32_t c = 0;
+    };
+
+    // 执行redis.call中的一条命令，回复按RESP写入reply
+    using CommandCaller = std::function<void(ArgSpan args, ReplyBuilder& reply)>;
+
+    // 编译脚本，失败时返回nullptr，error为带行号的错误信息
+    static std::shared_ptr<const ScriptProgram> compile(std::string_view source, std::string& error);
+
+    // 执行脚本，返回值按Redis的规则转换成回复：数字->整数，字符串->字符串，表->数组，
+    // {ok=...}->状态，{err=...}->错误，true->1，false/nil->nil；运行时错误返回错误，name用于错误信息
+    void run(ArgSpan keys, ArgSpan args, const CommandCaller& caller, std::string_view name, ReplyBuilder& reply) const;
+
+private:
+    friend class ScriptCompiler;
+    std::vector<Instruction> code;
+    std::vector<int> lines; //每条指令对应的源码行号，用于错误信息
+    std::vector<ScriptValue> constants;
+    int slotCount = 2; //局部变量槽位数，0和1是KEYS和ARGV
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "Scripting.h"
+#include "RedisServer.h"
+#include "Sha1.h"
+#include <cctype>
+
+Scripting::Scripting() = default;
+
+Scripting* Scripting::getInstance() {
+    static Scripting scripting;
+    return &scripting;
+}
+
+std::shared_ptr<const ScriptProgram> Scripting::load(std::string_view source, const std::string& sha, ReplyBuilder& reply) {
+    auto it = scripts.find(sha);
+    if (it != scripts.end()) {
+        return it->second;
+    }
+    std::string error;
+    auto program = ScriptProgram::compile(source, error);
+    if (program == nullptr) {
+        reply.error(error);
+        return nullptr;
+    }
+    scripts.emplace(sha, program);
+    return program;
+}
+
+void Scripting::run(const ScriptProgram& program, const std::string& sha, ArgSpan keys, ArgSpan args, ReplyBuilder& reply) {
+    RedisServer* server = RedisServer::getInstance();
+    std::vector<std::string> effects;
+    program.run(keys, args, [&](ArgSpan command, ReplyBuilder& result) {
+        server->callFromScript(command, result, effects);
+    }, "f_" + sha, reply);
+    //脚本中途出错时已经执行的写命令不会回滚，同样要写入复制流
+    server->propagateEffects(effects);
+}
+
+// 语法：eval script numkeys [key ...] [arg ...]
+// 127.0.0.1:6379> eval "local v = redis.call('get', KEYS[1]) if v == ARGV[1] then return redis.call('del', KEYS[1]) end return 0" 1 lock:1 token
+// (integer) 1
+void Scripting::eval(ReplyBuilder& reply, std::string_view source, ArgSpan keys, ArgSpan args) {
+    std::string sha = Sha1::hex(source);
+    auto program = load(source, sha, reply);
+    if (program != nullptr) {
+        run(*program, sha, keys, args, reply);
+    }
+}
+
+// 语法：evalsha sha1 numkeys [key ...] [arg ...]
+void Scripting::evalSha(ReplyBuilder& reply, std::string_view sha, ArgSpan keys, ArgSpan args) {
+    std::string lower(sha);
+    for (auto& ch : lower) {
+        ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    }
+    auto it = scripts.find(lower);
+    if (it == scripts.end()) {
+        return reply.error("NOSCRIPT", "No matching script. Please use EVAL.");
+    }
+    //执行期间SCRIPT FLUSH不会发生（命令锁），但持有一份引用更稳妥
+    auto program = it->second;
+    run(*program, lower, keys, args, reply);
+}
+
+// 语法：script load script
+// 127.0.0.1:6379> script load "return redis.call('incr', KEYS[1])"
+// "2bab3b661081db58bd2341920e0ba7cf5dc77b25"
+void Scripting::scriptLoad(ReplyBuilder& reply, std::string_view source) {
+    std::string sha = Sha1::hex(source);
+    if (load(source, sha, reply) != nullptr) {
+        reply.bulk(sha);
+    }
+}
+
+void Scripting::scriptExists(ReplyBuilder& reply, ArgSpan shas) {
+    reply.arrayHeader(shas.size());
+    std::string lower;
+    for (auto& sha : shas) {
+        lower.assign(sha.data(), sha.size());
+        for (auto& ch : lower) {
+            ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        }
+        reply.integer(scripts.count(lower));
+    }
+}
+
+void Scripting::scriptFlush(ReplyBuilder& reply) {
+    scripts.clear();
+    reply.status("OK");
+}
@@ -0,0 +1,43 @@
+#ifndef SCRIPTING_H
+#define SCRIPTING_H
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "CommandArgs.h"
+#include "ReplyBuilder.h"
+#include "ScriptVM.h"
+
+/*
+    Scripting 服务器端脚本（EVAL、EVALSHA、SCRIPT）
+    脚本编译成字节码（ScriptVM.h）后按SHA1缓存，EVALSHA和重复的EVAL不再编译。
+    脚本在命令锁内执行，期间没有其它命令，redis.call直接调用命令的解析器，整个脚本是原子的。
+    复制流中写入的不是脚本本身，而是脚本中执行成功的写命令（与Redis 7的effects replication相同），
+    一次执行的所有写命令作为一个复制流条目，副本上同样原子地应用，不依赖副本缓存了哪些脚本。
+    缓存只在命令锁内访问。
+*/
+class Scripting {
+private:
+    std::unordered_map<std::string, std::shared_ptr<const ScriptProgram>> scripts; //SHA1 -> 编译结果
+
+    Scripting();
+    // 编译并缓存脚本，编译失败时把错误写入reply并返回nullptr
+    std::shared_ptr<const ScriptProgram> load(std::string_view source, const std::string& sha, ReplyBuilder& reply);
+    void run(const ScriptProgram& program, const std::string& sha, ArgSpan keys, ArgSpan args, ReplyBuilder& reply);
+
+public:
+    static Scripting* getInstance();
+
+    // EVAL script numkeys [key ...] [arg ...]
+    void eval(ReplyBuilder& reply, std::string_view source, ArgSpan keys, ArgSpan args);
+    // EVALSHA sha1 numkeys [key ...] [arg ...]，脚本不在缓存中时返回NOSCRIPT
+    void evalSha(ReplyBuilder& reply, std::string_view sha, ArgSpan keys, ArgSpan args);
+    // SCRIPT LOAD script：只编译缓存，返回SHA1
+    void scriptLoad(ReplyBuilder& reply, std::string_view source);
+    // SCRIPT EXISTS sha1 [sha1 ...]：每个脚本是否在缓存中
+    void scriptExists(ReplyBuilder& reply, ArgSpan shas);
+    // SCRIPT FLUSH：清空缓存
+    void scriptFlush(ReplyBuilder& reply);
+};
+
+#endif
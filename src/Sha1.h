@@ -0,0 +1,89 @@
+#ifndef SHA1_H
+#define SHA1_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/*
+    SHA1，用于计算脚本的摘要（EVALSHA、SCRIPT LOAD）
+    与Redis相同，返回40位小写十六进制，同一个脚本在两边的摘要一致。
+*/
+class Sha1 {
+private:
+    static uint32_t rotate(uint32_t value, int bits) {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    static void transform(uint32_t state[5], const uint8_t block[64]) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16 |
+                   static_cast<uint32_t>(block[i * 4 + 2]) << 8 | block[i * 4 + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t temp = rotate(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotate(b, 30);
+            b = a;
+            a = temp;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+
+public:
+    static std::string hex(std::string_view data) {
+        uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        size_t full = data.size() / 64 * 64;
+        for (size_t pos = 0; pos < full; pos += 64) {
+            transform(state, reinterpret_cast<const uint8_t*>(data.data() + pos));
+        }
+        //最后不足一块的数据补上0x80、若干个0和64位的比特长度，可能占一块或两块
+        uint8_t tail[128] = {};
+        size_t rest = data.size() % 64;
+        memcpy(tail, data.data() + full, rest);
+        tail[rest] = 0x80;
+        size_t tailSize = rest < 56 ? 64 : 128;
+        uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+        for (int i = 0; i < 8; i++) {
+            tail[tailSize - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+        for (size_t pos = 0; pos < tailSize; pos += 64) {
+            transform(state, tail + pos);
+        }
+        static const char digits[] = "0123456789abcdef";
+        std::string result(40, '0');
+        for (int i = 0; i < 20; i++) {
+            uint8_t byte = static_cast<uint8_t>(state[i / 4] >> (24 - (i % 4) * 8));
+            result[i * 2] = digits[byte >> 4];
+            result[i * 2 + 1] = digits[byte & 0x0f];
+        }
+        return result;
+    }
+};
+
+#endif
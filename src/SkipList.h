@@ -6,11 +6,13 @@
 #include <memory>
 #include <string>
 #include <cstring>
+#include <cstdio>
 #include <mutex>
 #include <fstream>
 #include <random>
 #include "global.h"
 #include "RedisValue/RedisValue.h"
+#include "Snapshot.h"
 #define MAX_SKIP_LIST_LEVEL 32
 #define PROBABILITY_FACTOR 0.25
 #define DELIMITER ":"
@@ -23,6 +25,7 @@ public:
     Key key ;
     Value value ;
     std::vector< std::shared_ptr< SkipListNode< Key , Value > > > forward ;
+    std::weak_ptr< SkipListNode< Key , Value > > backward ; //第0层的前驱节点，前驱是头节点时为空，用于反向遍历
     SkipListNode( Key key , Value value , int maxLevel = MAX_SKIP_LIST_LEVEL ):
     key( key ) , value( value ) , forward( maxLevel , nullptr ){}
 };
@@ -36,6 +39,7 @@ private:
     std::shared_ptr< SkipListNode< Key , Value > > head ;
     int elementNumber = 0 ;
     std::mutex mutex ;
+    bool locking = true ;
     std::ofstream writeFile ;
     std::ifstream readFile ;
     std::mt19937 generator{ std::random_device{}() } ;
@@ -44,15 +48,41 @@ private:
     int randomLevel() ;
     bool parseString( const std::string& line , std::string& key , std::string& value ) ;
     bool isVaildString( const std::string& line ) ;
+    // 当前线程正在batch中的跳表：batch持有mutex，同一线程的各个接口不再加锁，其它线程仍然等待mutex
+    static thread_local SkipList* batchOwner ;
+    void lock(){ if( locking && batchOwner != this ) mutex.lock() ; }
+    void unlock(){ if( locking && batchOwner != this ) mutex.unlock() ; }
+    // 查找前驱时只用裸指针遍历，不复制shared_ptr，多个线程同时查找时不会争用节点的引用计数
+    template< typename K >
+    SkipListNode< Key , Value >* findPredecessor( const K& key , bool inclusive ) ;
 
 public:
     SkipList() ;
     ~SkipList() ;
     bool addItem( const Key& key , const Value& value ) ;
     bool modifyItem( const Key& key , const Value& value ) ;
-    bool deleteItem( const Key& key ) ;
-    std::shared_ptr< SkipListNode< Key , Value > > searchItem( const Key& key ) ;
+    // 查找类接口的参数可以是任何能与Key比较的类型（如std::string_view），查找时不需要构造Key
+    template< typename K >
+    bool deleteItem( const K& key ) ;
+    template< typename K >
+    std::shared_ptr< SkipListNode< Key , Value > > searchItem( const K& key ) ;
+    // 返回第一个键大于等于key的节点，不存在时返回nullptr
+    template< typename K >
+    std::shared_ptr< SkipListNode< Key , Value > > lowerBound( const K& key ) ;
+    // 返回第一个键大于key的节点，不存在时返回nullptr
+    template< typename K >
+    std::shared_ptr< SkipListNode< Key , Value > > upperBound( const K& key ) ;
+    // 返回最后一个键小于key（inclusive为true时小于等于key）的节点，不存在时返回nullptr
+    template< typename K >
+    std::shared_ptr< SkipListNode< Key , Value > > findLast( const K& key , bool inclusive ) ;
+    // 返回最后一个节点，跳表为空时返回nullptr
+    std::shared_ptr< SkipListNode< Key , Value > > getTail() ;
     int getCurrentLevel(){ return currentLevel ; }
+    // 关闭互斥锁，由调用方保证不会同时有写者（如副本读视图中的两份数据，见LeftRight.h），此时多个读者可以并发查找
+    void setLocking( bool enabled ){ locking = enabled ; }
+    // 只加一次锁连续执行func中的多个操作（如一个事务），期间本线程调用的各个接口不再单独加锁，可以嵌套
+    template< typename Func >
+    void batch( Func func ) ;
     std::shared_ptr< SkipListNode< Key , Value > > getHead(){ return head ; }
     int size() ;
     void printList() ;
@@ -62,6 +92,22 @@ public:
 
 };
 
+template< typename Key , typename Value >
+thread_local SkipList< Key , Value >* SkipList< Key , Value >::batchOwner = nullptr ;
+
+template< typename Key , typename Value >
+template< typename Func >
+void SkipList< Key , Value >::batch( Func func ){
+    lock() ;
+    struct Restore {
+        SkipList& list ;
+        SkipList* previous ;
+        ~Restore(){ batchOwner = previous ; list.unlock() ; } //嵌套的batch恢复后仍是本跳表，不解锁
+    } restore{ *this , batchOwner } ;
+    batchOwner = this ;
+    func() ;
+}
+
 template<typename Key,typename Value>
 SkipList<Key,Value>::SkipList()
         :currentLevel(0),distribution(0, 1){
@@ -116,15 +162,15 @@ bool SkipList< Key , Value >::isVaildString(const std::string &line) {
 
 template<typename Key,typename Value>
 int SkipList<Key,Value>::size(){
-    mutex.lock();
+    lock();
     int ret=this->elementNumber;
-    mutex.unlock();
+    unlock();
     return ret;
 }
 
 template< typename Key , typename Value >
 bool SkipList< Key , Value >::addItem(const Key &key, const Value &value) {
-    mutex.lock() ;
+    lock() ;
     auto currentNode = this->head ;
     std::vector< std::shared_ptr< SkipListNode< Key , Value > > > update( MAX_SKIP_LIST_LEVEL , head ) ;
     for( int i = currentLevel - 1 ; i >= 0 ; i -- ){
@@ -140,14 +186,21 @@ bool SkipList< Key , Value >::addItem(const Key &key, const Value &value) {
         newNode->forward[ i ] = update[ i ]->forward[ i ] ;
         update[ i ]->forward[ i ] = newNode ;
     }
+    if( update[ 0 ] != head ){
+        newNode->backward = update[ 0 ] ;
+    }
+    if( newNode->forward[ 0 ] ){
+        newNode->forward[ 0 ]->backward = newNode ;
+    }
     elementNumber ++ ;
-    mutex.unlock() ;
+    unlock() ;
     return true ;
 }
 
 template<typename Key,typename Value>
-bool SkipList<Key,Value>::deleteItem(const Key& key){
-    mutex.lock();
+template<typename K>
+bool SkipList<Key,Value>::deleteItem(const K& key){
+    lock();
     std::shared_ptr<SkipListNode<Key,Value>> currentNode=this->head;
     std::vector<std::shared_ptr<SkipListNode<Key,Value>>>update(MAX_SKIP_LIST_LEVEL,head);
     for(int i=currentLevel-1;i>=0;i--){
@@ -158,7 +211,7 @@ bool SkipList<Key,Value>::deleteItem(const Key& key){
     }
     currentNode=currentNode->forward[0];
     if(!currentNode||currentNode->key!=key){
-        mutex.unlock();
+        unlock();
         return false;
     }
     for(int i=0;i<currentLevel;i++){
@@ -167,53 +220,113 @@ bool SkipList<Key,Value>::deleteItem(const Key& key){
         }
         update[i]->forward[i]=currentNode->forward[i];
     }
+    if(currentNode->forward[0]){
+        currentNode->forward[0]->backward=currentNode->backward;
+    }
     currentNode.reset();
     while(currentLevel>1&&head->forward[currentLevel-1]==nullptr){
         currentLevel--;
     }
     elementNumber--;
-    mutex.unlock();
+    unlock();
     return true;
 }
 
+// 返回最后一个键小于key（inclusive为true时小于等于key）的节点，可能是头节点
+template< typename Key , typename Value >
+template< typename K >
+SkipListNode< Key , Value >* SkipList< Key , Value >::findPredecessor(const K &key, bool inclusive) {
+    SkipListNode< Key , Value >* currentNode = this->head.get() ;
+    for( int i = currentLevel - 1 ; i >= 0 ; i -- ){
+        SkipListNode< Key , Value >* next = currentNode->forward[ i ].get() ;
+        while( next != nullptr && ( next->key < key || ( inclusive && !( key < next->key ) ) ) ){
+            currentNode = next ;
+            next = currentNode->forward[ i ].get() ;
+        }
+    }
+    return currentNode ;
+}
+
+template< typename Key , typename Value >
+template< typename K >
+std::shared_ptr< SkipListNode< Key , Value > > SkipList< Key , Value >::searchItem(const K &key) {
+    lock() ;
+    std::shared_ptr< SkipListNode< Key , Value > > result ;
+    const auto& next = findPredecessor( key , false )->forward[ 0 ] ;
+    if( next && next->key == key ){
+        result = next ;
+    }
+    unlock() ;
+    return result ;
+}
+
+template< typename Key , typename Value >
+template< typename K >
+std::shared_ptr< SkipListNode< Key , Value > > SkipList< Key , Value >::lowerBound(const K &key) {
+    lock() ;
+    std::shared_ptr< SkipListNode< Key , Value > > result = findPredecessor( key , false )->forward[ 0 ] ;
+    unlock() ;
+    return result ;
+}
+
 template< typename Key , typename Value >
-std::shared_ptr< SkipListNode< Key , Value > > SkipList< Key , Value >::searchItem(const Key &key) {
-    mutex.lock() ;
-    std::shared_ptr< SkipListNode< Key , Value > > currentNode = this->head ;
-    if( !currentNode ){
-        mutex.unlock() ;
-        return nullptr ;
+template< typename K >
+std::shared_ptr< SkipListNode< Key , Value > > SkipList< Key , Value >::upperBound(const K &key) {
+    lock() ;
+    std::shared_ptr< SkipListNode< Key , Value > > result = findPredecessor( key , true )->forward[ 0 ] ;
+    unlock() ;
+    return result ;
+}
+
+template< typename Key , typename Value >
+template< typename K >
+std::shared_ptr< SkipListNode< Key , Value > > SkipList< Key , Value >::findLast(const K &key, bool inclusive) {
+    lock() ;
+    SkipListNode< Key , Value >* node = findPredecessor( key , inclusive ) ;
+    //节点只被前驱的forward持有，从前驱节点取出shared_ptr
+    std::shared_ptr< SkipListNode< Key , Value > > result ;
+    if( node != head.get() ){
+        auto previous = node->backward.lock() ;
+        result = previous ? previous->forward[ 0 ] : head->forward[ 0 ] ;
     }
+    unlock() ;
+    return result ;
+}
+
+template< typename Key , typename Value >
+std::shared_ptr< SkipListNode< Key , Value > > SkipList< Key , Value >::getTail() {
+    lock() ;
+    SkipListNode< Key , Value >* currentNode = this->head.get() ;
     for( int i = currentLevel - 1 ; i >= 0 ; i -- ){
-        while( currentNode->forward[ i ] != nullptr && currentNode->forward[ i ]->key < key ){
-            currentNode = currentNode->forward[ i ] ;
+        while( currentNode->forward[ i ] != nullptr ){
+            currentNode = currentNode->forward[ i ].get() ;
         }
     }
-    currentNode = currentNode->forward[ 0 ] ;
-    if( currentNode && currentNode->key == key ){
-        mutex.unlock() ;
-        return currentNode ;
+    std::shared_ptr< SkipListNode< Key , Value > > result ;
+    if( currentNode != head.get() ){
+        auto previous = currentNode->backward.lock() ;
+        result = previous ? previous->forward[ 0 ] : head->forward[ 0 ] ;
     }
-    mutex.unlock() ;
-    return nullptr ;
+    unlock() ;
+    return result ;
 }
 
 template< typename Key , typename Value >
 bool SkipList< Key , Value >::modifyItem(const Key &key, const Value &value) {
     std::shared_ptr< SkipListNode< Key , Value > > targetNode = this->searchItem( key ) ;
-    mutex.lock() ;
+    lock() ;
     if( targetNode == nullptr ){
-        mutex.unlock() ;
+        unlock() ;
         return false ;
     }
     targetNode->value = value ;
-    mutex.unlock() ;
+    unlock() ;
     return true ;
 }
 
 template< typename Key , typename Value >
 void SkipList< Key , Value >::printList() {
-    mutex.lock() ;
+    lock() ;
     for( int i = currentLevel ; i >= 0 ; i-- ){
         auto node = this->head->forward[ i ] ;
         std::cout << "Level = " << i + 1 << " : " ;
@@ -223,33 +336,59 @@ void SkipList< Key , Value >::printList() {
         }
         std::cout << '\n' ;
     }
-    mutex.unlock() ;
+    unlock() ;
 }
 
 template< typename  Key , typename Value >
 void SkipList< Key , Value >::dumpFile(std::string save_path) {
-    mutex.lock() ;
-    writeFile.open( save_path ) ;
+    lock() ;
+    SnapshotWriter writer( save_path ) ;
+    std::string records ;
     auto node = this->head->forward[ 0 ] ;
     while( node != nullptr ){
-        writeFile<<node->key<<DELIMITER<< node->value.dump() << '\n' ;\
+        SnapshotFormat::appendRecord( records , node->key , node->value ) ;
+        if( records.size() >= SNAPSHOT_BATCH_SIZE ){
+            writer.appendBlock( records ) ;
+            records.clear() ;
+        }
         node = node->forward[ 0 ] ;
     }
-    writeFile.flush() ;
-    writeFile.close() ;
-    mutex.unlock() ;
+    writer.appendBlock( records ) ;
+    writer.close() ;
+    unlock() ;
 }
 template< typename  Key , typename Value >
 void SkipList< Key , Value >::loadFile(std::string load_path) {
-    readFile.open( load_path ) ;
+    readFile.open( load_path , std::ios::binary ) ;
     if( !readFile.is_open() ){
-        mutex.unlock() ; return ;
+        return ;
     }
     std::string line , key , value , err ;
-    while( std::getline( readFile , line ) ){
-        if(parseString( line , key , value ) ){
-            addItem( key , RedisValue::parse( value , err ) ) ;
+    // 根据文件头区分分块快照、v1文本快照和没有文件头的"键:值"旧格式（见Snapshot.h）
+    std::getline( readFile , line ) ;
+    if( line == SNAPSHOT_HEADER ){
+        bool complete = SnapshotFormat::readRecords( readFile , [ this ]( const std::string& itemKey , const RedisValue& itemValue ){
+            addItem( itemKey , itemValue ) ;
+        } ) ;
+        if( !complete ){
+            // 损坏的文件改名保留，避免下次保存时被只有部分数据的快照覆盖
+            std::rename( load_path.c_str() , ( load_path + ".corrupt" ).c_str() ) ;
+            std::cout << "快照文件：" << load_path << "校验失败或不完整，只加载了校验通过的部分，原文件已保存为"
+                      << load_path << ".corrupt" << std::endl ;
+        }
+    } else if( line == SNAPSHOT_TEXT_HEADER ){
+        RedisValue item ;
+        while( std::getline( readFile , line ) ){
+            if( SnapshotFormat::parseRecord( line , key , item , err ) ){
+                addItem( key , item ) ;
+            }
         }
+    } else if( !line.empty() ){
+        do{
+            if( parseString( line , key , value ) ){
+                addItem( key , RedisValue::parse( value , err ) ) ;
+            }
+        }while( std::getline( readFile , line ) ) ;
     }
     readFile.close() ;
 }
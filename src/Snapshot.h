@@ -0,0 +1,295 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+#include "RedisValue/RedisValue.h"
+#include "RedisValue/Parse.h"
+#include "RedisValue/Dump.h"
+#include "LZCodec.h"
+#include "Crc32c.h"
+
+/*
+    快照文件格式
+    第一行为SNAPSHOT_HEADER，之后是若干个数据块，每块的块头为四个小端uint32：
+        原始长度 存储长度 数据的CRC32C 块头前12字节的CRC32C，后面跟存储的数据
+    存储长度小于原始长度时数据经过LZCodec压缩，相等时为原样保存（压缩后没有变小的块不压缩）。
+    原始长度为0的块是结束标记，没有结束标记或任何一个校验和不符的快照都视为损坏。
+    先校验块头，长度可信之后才按长度分配内存、读取数据。
+    块内是若干条完整的记录，每条一行：键按JSON字符串转义后写出，空格，值的dump()文本。
+    "user:1" {"name":"tom"}
+    键经过转义，因此可以包含':'、换行等任意字节。记录按SNAPSHOT_BATCH_SIZE攒成一块，
+    超过这个大小的单条记录（大的值）单独成块，单独压缩。
+    加载时兼容没有块结构的v1文本快照，以及没有文件头的"键:值"旧格式。
+*/
+#define SNAPSHOT_HEADER "#MyTinyRedis snapshot v3"
+#define SNAPSHOT_TEXT_HEADER "#MyTinyRedis snapshot v1"
+#define SNAPSHOT_BATCH_SIZE (64 << 10) //序列化好的记录攒到64KB成为一个数据块
+
+struct SnapshotBlockHeader {
+    uint32_t rawSize;
+    uint32_t storedSize;
+    uint32_t dataChecksum;
+    uint32_t headerChecksum;
+
+    // 计算前三个字段的校验和
+    uint32_t computeHeaderChecksum() const {
+        return Crc32c::value(reinterpret_cast<const char*>(this), offsetof(SnapshotBlockHeader, headerChecksum));
+    }
+};
+
+// CMake选项SNAPSHOT_COMPRESSION控制保存时是否压缩，加载时两种块都能读
+#ifdef SNAPSHOT_COMPRESSION
+#define SNAPSHOT_COMPRESSION_DEFAULT true
+#else
+#define SNAPSHOT_COMPRESSION_DEFAULT false
+#endif
+
+class SnapshotFormat {
+public:
+    // 把一条记录追加到out，out可以在多条记录之间复用，不为每个键分配临时字符串
+    static void appendRecord(std::string& out, const std::string& key, const RedisValue& value) {
+        ::dump(key, out);
+        out += ' ';
+        value.dump(out);
+        out += '\n';
+    }
+
+    // 解析一条记录（不含换行），格式错误时返回false
+    static bool parseRecord(const std::string& line, std::string& key, RedisValue& value, std::string& err) {
+        RedisValueParser parser{line, 0, err, false};
+        if (parser.getNextToken() != '"') {
+            return false;
+        }
+        key = parser.parseString();
+        value = parser.parseRedisValue(0);
+        parser.consumeGarbage();
+        return !parser.failed && parser.i == line.size();
+    }
+
+    enum BlockStatus {
+        BLOCK_OK,
+        BLOCK_END,     //读到结束标记
+        BLOCK_CORRUPT  //校验和不符、数据不完整或无法解压
+    };
+
+    // 读取下一个数据块，校验后解压到block，stored为复用的读缓冲区
+    static BlockStatus readBlock(std::istream& in, std::string& block, std::string& stored) {
+        SnapshotBlockHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            header.computeHeaderChecksum() != header.headerChecksum || header.storedSize > header.rawSize) {
+            return BLOCK_CORRUPT;
+        }
+        if (header.rawSize == 0) {
+            return BLOCK_END;
+        }
+        stored.resize(header.storedSize);
+        if (!in.read(&stored[0], header.storedSize) ||
+            Crc32c::value(stored.data(), header.storedSize) != header.dataChecksum) {
+            return BLOCK_CORRUPT;
+        }
+        if (header.storedSize == header.rawSize) {
+            block.swap(stored);
+            return BLOCK_OK;
+        }
+        block.resize(header.rawSize);
+        return LZCodec::decompress(stored.data(), header.storedSize, &block[0], header.rawSize) ? BLOCK_OK : BLOCK_CORRUPT;
+    }
+
+    // 依次读取所有数据块，对每条记录调用onRecord(key,value)
+    // 遇到损坏的块时停止，之前校验通过的块已经加载；返回是否完整读到结束标记
+    template<typename Func>
+    static bool readRecords(std::istream& in, Func onRecord) {
+        std::string block, stored, line, key, err;
+        RedisValue value;
+        BlockStatus status;
+        while ((status = readBlock(in, block, stored)) == BLOCK_OK) {
+            size_t pos = 0;
+            while (pos < block.size()) {
+                size_t end = block.find('\n', pos);
+                if (end == std::string::npos) {
+                    end = block.size();
+                }
+                line.assign(block, pos, end - pos);
+                if (parseRecord(line, key, value, err)) {
+                    onRecord(key, value);
+                }
+                pos = end + 1;
+            }
+        }
+        return status == BLOCK_END;
+    }
+};
+
+/*
+    SnapshotWriter 把快照按大块顺序写入文件
+    记录先拷贝到一块对齐的大缓冲区，写满后用一次write整块写出，保存20GB的数据也只需要几千次系统调用。
+    定义SNAPSHOT_DIRECT_IO（CMake选项SNAPSHOT_DIRECT_IO）时用O_DIRECT打开文件，快照不经过页缓存，
+    不会把热数据挤出页缓存。O_DIRECT要求缓冲区地址、写入长度和文件偏移都按块对齐，
+    所以缓冲区按4KB对齐、整块写出，最后不足一块的尾部去掉O_DIRECT标志后再写；
+    文件系统不支持O_DIRECT时退回普通写入。
+    快照先写到同目录下的"路径.tmp"，close()时写入结束标记、fsync，再rename覆盖原文件并fsync目录，
+    保存过程中崩溃只会留下不完整的临时文件，原来的快照不受影响。没有调用close()就析构的写入视为放弃，删除临时文件。
+*/
+class SnapshotWriter {
+public:
+    static constexpr size_t ALIGNMENT = 4096;
+    static constexpr size_t BUFFER_SIZE = 8 << 20; //8MB，必须是ALIGNMENT的整数倍
+
+private:
+    int fd = -1;
+    std::string path;
+    std::string tempPath;
+    char* buffer = nullptr;
+    size_t used = 0;
+    bool failed = false;
+    bool compress;
+    std::string compressed; //压缩输出，块之间复用
+
+    bool writeAll(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    void appendBlockHeader(uint32_t rawSize, std::string_view payload) {
+        SnapshotBlockHeader header;
+        header.rawSize = rawSize;
+        header.storedSize = static_cast<uint32_t>(payload.size());
+        header.dataChecksum = Crc32c::value(payload.data(), payload.size());
+        header.headerChecksum = header.computeHeaderChecksum();
+        append(std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)));
+    }
+
+    // rename之后fsync所在目录，保证新的目录项也已落盘
+    void syncDirectory() {
+        size_t slash = path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+        int dirFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirFd >= 0) {
+            ::fsync(dirFd);
+            ::close(dirFd);
+        }
+    }
+
+    void flushBuffer() {
+        if (!failed && used > 0 && !writeAll(buffer, used)) {
+            failed = true;
+        }
+        used = 0;
+    }
+
+public:
+    // 打开文件后先写入文件头
+    explicit SnapshotWriter(const std::string& path, bool compress = SNAPSHOT_COMPRESSION_DEFAULT)
+        : path(path), tempPath(path + ".tmp"), compress(compress) {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef SNAPSHOT_DIRECT_IO
+        fd = ::open(tempPath.c_str(), flags | O_DIRECT, 0644);
+        if (fd < 0 && errno == EINVAL) {
+            fd = ::open(tempPath.c_str(), flags, 0644);
+        }
+#else
+        fd = ::open(tempPath.c_str(), flags, 0644);
+#endif
+        if (fd >= 0 && posix_memalign(reinterpret_cast<void**>(&buffer), ALIGNMENT, BUFFER_SIZE) != 0) {
+            buffer = nullptr;
+            ::close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) {
+            append(SNAPSHOT_HEADER "\n");
+        }
+    }
+    ~SnapshotWriter() {
+        if (fd >= 0) {
+            ::close(fd);
+            ::unlink(tempPath.c_str());
+        }
+        free(buffer);
+    }
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+
+    void append(std::string_view data) {
+        while (!data.empty()) {
+            size_t count = std::min(data.size(), BUFFER_SIZE - used);
+            memcpy(buffer + used, data.data(), count);
+            used += count;
+            data.remove_prefix(count);
+            if (used == BUFFER_SIZE) {
+                flushBuffer();
+            }
+        }
+    }
+
+    // 把一批完整的记录写成一个数据块，按需压缩
+    void appendBlock(std::string_view records) {
+        if (records.empty()) {
+            return;
+        }
+        if (records.size() > UINT32_MAX) {
+            failed = true; //块长度用uint32保存，单条记录不能超过4GB
+            return;
+        }
+        std::string_view payload = records;
+        if (compress) {
+            compressed.clear();
+            LZCodec::compress(records.data(), records.size(), compressed);
+            if (compressed.size() < records.size()) {
+                payload = compressed;
+            }
+        }
+        appendBlockHeader(static_cast<uint32_t>(records.size()), payload);
+        append(payload);
+    }
+
+    // 写入结束标记和剩余数据，落盘后替换原来的快照，返回整个快照是否保存成功
+    bool close() {
+        if (fd < 0) {
+            return false;
+        }
+        appendBlockHeader(0, std::string_view());
+        if (used > 0) {
+            int flags = fcntl(fd, F_GETFL);
+            if (flags >= 0 && (flags & O_DIRECT)) {
+                fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+            }
+            flushBuffer();
+        }
+        if (!failed && ::fsync(fd) != 0) {
+            failed = true;
+        }
+        if (::close(fd) != 0) {
+            failed = true;
+        }
+        fd = -1;
+        if (failed || ::rename(tempPath.c_str(), path.c_str()) != 0) {
+            ::unlink(tempPath.c_str());
+            return false;
+        }
+        syncDirectory();
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef VALUECODEC_H
+#define VALUECODEC_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "RedisValue/RedisValue.h"
+
+#define VALUE_CODEC_MAX_DEPTH 64 //解码时允许的最大嵌套层数，防止恶意数据耗尽栈空间
+
+/*
+    ValueCodec 值的紧凑二进制编码，用于槽位迁移和DUMP/RESTORE
+    每个值以一个类型字节开头，长度和个数都用变长整数（每字节7位，高位表示后面还有）：
+        字符串   0 | 长度 | 原始字节
+        列表     1 | 元素个数 | 元素...
+        哈希表   2 | 字段个数 | (字段长度 | 字段 | 值)...
+        其它     3 | 长度 | dump()的文本（消息流、数字等，解码时用RedisValue::parse）
+    与快照的JSON文本相比，字符串不需要转义和解析，短字段只多一两个字节的长度。
+    迁移的一条记录是：键长度 | 键 | 值。
+*/
+class ValueCodec {
+private:
+    enum Tag : uint8_t {
+        TAG_STRING = 0,
+        TAG_LIST = 1,
+        TAG_HASH = 2,
+        TAG_TEXT = 3
+    };
+
+    static void putVarint(uint64_t value, std::string& out) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static bool getVarint(const char*& pos, const char* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*pos++);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void putBytes(std::string_view bytes, std::string& out) {
+        putVarint(bytes.size(), out);
+        out.append(bytes.data(), bytes.size());
+    }
+
+    static bool getBytes(const char*& pos, const char* end, std::string& bytes) {
+        uint64_t size;
+        if (!getVarint(pos, end, size) || size > static_cast<uint64_t>(end - pos)) {
+            return false;
+        }
+        bytes.assign(pos, size);
+        pos += size;
+        return true;
+    }
+
+    static bool decode(const char*& pos, const char* end, RedisValue& value, int depth) {
+        if (pos >= end || depth > VALUE_CODEC_MAX_DEPTH) {
+            return false;
+        }
+        uint8_t tag = static_cast<uint8_t>(*pos++);
+        uint64_t count;
+        std::string bytes;
+        switch (tag) {
+            case TAG_STRING:
+                if (!getBytes(pos, end, bytes)) {
+                    return false;
+                }
+                value = RedisValue(std::move(bytes));
+                return true;
+            case TAG_LIST: {
+                //每个元素至少一个字节，个数不可能超过剩余字节数
+                if (!getVarint(pos, end, count) || count > static_cast<uint64_t>(end - pos)) {
+                    return false;
+                }
+                RedisValue::array items(count);
+                for (auto& item : items) {
+                    if (!decode(pos, end, item, depth + 1)) {
+                        return false;
+                    }
+                }
+                value = RedisValue(std::move(items));
+                return true;
+            }
+            case TAG_HASH: {
+                if (!getVarint(pos, end, count) || count > static_cast<uint64_t>(end - pos)) {
+                    return false;
+                }
+                RedisValue::object fields;
+                RedisValue field;
+                for (uint64_t i = 0; i < count; i++) {
+                    if (!getBytes(pos, end, bytes) || !decode(pos, end, field, depth + 1)) {
+                        return false;
+                    }
+                    fields.emplace(std::move(bytes), std::move(field));
+                }
+                value = RedisValue(std::move(fields));
+                return true;
+            }
+            case TAG_TEXT: {
+                std::string err;
+                if (!getBytes(pos, end, bytes)) {
+                    return false;
+                }
+                value = RedisValue::parse(bytes, err);
+                return err.empty();
+            }
+            default:
+                return false;
+        }
+    }
+
+public:
+    static void encode(RedisValue& value, std::string& out) {
+        switch (value.type()) {
+            case RedisValue::STRING:
+                out += static_cast<char>(TAG_STRING);
+                putBytes(value.stringValue(), out);
+                break;
+            case RedisValue::ARRAY:
+                out += static_cast<char>(TAG_LIST);
+                putVarint(value.arrayItems().size(), out);
+                for (auto& item : value.arrayItems()) {
+                    encode(item, out);
+                }
+                break;
+            case RedisValue::OBJECT:
+                out += static_cast<char>(TAG_HASH);
+                putVarint(value.objectItems().size(), out);
+                for (auto& field : value.objectItems()) {
+                    putBytes(field.first, out);
+                    encode(field.second, out);
+                }
+                break;
+            default:
+                out += static_cast<char>(TAG_TEXT);
+                putBytes(value.dump(), out);
+                break;
+        }
+    }
+
+    // 解码data中的一个完整的值，有多余字节或格式错误时返回false
+    static bool decode(std::string_view data, RedisValue& value) {
+        const char* pos = data.data();
+        return decode(pos, data.data() + data.size(), value, 0) && pos == data.data() + data.size();
+    }
+
+    static void appendRecord(std::string& out, std::string_view key, RedisValue& value) {
+        putBytes(key, out);
+        encode(value, out);
+    }
+
+    // 从pos读取一条记录并前移pos，格式错误时返回false
+    static bool readRecord(const char*& pos, const char* end, std::string& key, RedisValue& value) {
+        return getBytes(pos, end, key) && decode(pos, end, value, 0);
+    }
+
+    // 编码结果是任意字节，在按空白分隔参数的文本协议中（DUMP/RESTORE、复制流）用十六进制表示
+    static std::string toHex(std::string_view bytes) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(bytes.size() * 2);
+        for (unsigned char ch : bytes) {
+            hex += digits[ch >> 4];
+            hex += digits[ch & 0x0f];
+        }
+        return hex;
+    }
+
+    static bool fromHex(std::string_view hex, std::string& bytes) {
+        auto digit = [](char ch) {
+            if (ch >= '0' && ch <= '9') return ch - '0';
+            if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+            if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+            return -1;
+        };
+        bytes.clear();
+        if (hex.size() % 2 != 0) {
+            return false;
+        }
+        bytes.reserve(hex.size() / 2);
+        for (size_t i = 0; i < hex.size(); i += 2) {
+            int hi = digit(hex[i]);
+            int lo = digit(hex[i + 1]);
+            if (hi < 0 || lo < 0) {
+                return false;
+            }
+            bytes += static_cast<char>((hi << 4) | lo);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -1,27 +1,172 @@
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
+#include <strings.h>
 #include "buttonrpc.hpp"
+#include "ReplyRenderer.h"
 
 using namespace std;
-int main() {
-    string hostName = "127.0.0.1";
-    int port = 5555;
 
-    buttonrpc client;
-    client.as_client(hostName, port);
-    client.set_timeout(2000);
+#define MAX_REDIRECTIONS 5 //一条命令最多跟随的集群重定向次数
+#define LISTEN_INTERVAL_MS 50 //订阅后两次LISTEN的间隔，要远小于服务器删除不再LISTEN的订阅者的时间
+
+// 输入的第一个词，即命令名
+static string commandName(const string& message) {
+    size_t start = message.find_first_not_of(" \t");
+    if (start == string::npos) {
+        return "";
+    }
+    size_t end = message.find_first_of(" \t", start);
+    return message.substr(start, end == string::npos ? string::npos : end - start);
+}
+
+// 输入的第一个词是quit或exit时退出客户端
+static bool isQuitCommand(const string& message) {
+    string command = commandName(message);
+    return strcasecmp(command.c_str(), "quit") == 0 || strcasecmp(command.c_str(), "exit") == 0;
+}
+
+// SUBSCRIBE/PSUBSCRIBE的回复是数组，第一个元素是订阅者编号：*N\r\n:<编号>\r\n...
+static bool parseSubscriberId(const string& message, const string& reply, string& id) {
+    string command = commandName(message);
+    if (strcasecmp(command.c_str(), "subscribe") != 0 && strcasecmp(command.c_str(), "psubscribe") != 0) {
+        return false;
+    }
+    size_t line = reply.find("\r\n");
+    if (reply.empty() || reply[0] != '*' || line == string::npos || reply.compare(line + 2, 1, ":") != 0) {
+        return false;
+    }
+    size_t end = reply.find("\r\n", line + 3);
+    if (end == string::npos) {
+        return false;
+    }
+    id = reply.substr(line + 3, end - line - 3);
+    return true;
+}
+
+// 与redis-cli相同，订阅成功后不再读取输入，一直用LISTEN轮询消息并输出，订阅者被删除时回到提示符
+static void receiveMessages(buttonrpc& client, const string& id) {
+    while (true) {
+        string res = client.call<string>("redis_command", "listen " + id).val();
+        if (res.compare(0, 4, "*0\r\n") == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(LISTEN_INTERVAL_MS));
+            continue;
+        }
+        std::cout << ReplyRenderer::render(res) << std::endl;
+        if (res.empty() || res[0] == '-') {
+            return;
+        }
+    }
+}
+
+// 服务器按编号区分WATCH的客户端：记下WATCH返回的编号，不带参数的EXEC、DISCARD、UNWATCH自动带上这些编号，之后清空
+static string withWatchIds(const string& message, vector<string>& watchIds) {
+    string command = commandName(message);
+    bool release = strcasecmp(command.c_str(), "exec") == 0 || strcasecmp(command.c_str(), "discard") == 0 ||
+                   strcasecmp(command.c_str(), "unwatch") == 0;
+    if (!release) {
+        return message;
+    }
+    string result = message;
+    if (message.find_first_not_of(" \t", message.find(command) + command.size()) == string::npos) {
+        for (auto& id : watchIds) {
+            result += " " + id;
+        }
+    }
+    watchIds.clear();
+    return result;
+}
+
+static void rememberWatchId(const string& message, const string& reply, vector<string>& watchIds) {
+    string command = commandName(message);
+    if (strcasecmp(command.c_str(), "watch") == 0 && reply.compare(0, 1, ":") == 0) {
+        watchIds.push_back(reply.substr(1, reply.find("\r\n") - 1));
+    }
+}
+
+// 集群重定向 -MOVED <槽位> <host>:<port> 或 -ASK <槽位> <host>:<port>，解析出目标地址
+static bool parseRedirection(const string& reply, bool& ask, string& host, int& port) {
+    if (reply.compare(0, 7, "-MOVED ") == 0) {
+        ask = false;
+    } else if (reply.compare(0, 5, "-ASK ") == 0) {
+        ask = true;
+    } else {
+        return false;
+    }
+    size_t space = reply.find(' ', ask ? 5 : 7);
+    size_t colon = reply.rfind(':');
+    if (space == string::npos || colon == string::npos || colon < space) {
+        return false;
+    }
+    host = reply.substr(space + 1, colon - space - 1);
+    port = atoi(reply.c_str() + colon + 1);
+    return port > 0;
+}
+
+// 阻塞命令（BLPOP等）在一次请求中没有等到结果时服务器回复-BLOCKED <编号>，立即用BPOLL <编号>继续等待，
+// 服务器在每个BPOLL请求中等待，直到得到结果或超时
+static string waitBlocked(buttonrpc& client, string res) {
+    while (res.compare(0, 9, "-BLOCKED ") == 0) {
+        size_t end = res.find("\r\n");
+        string id = res.substr(9, end == string::npos ? string::npos : end - 9);
+        res = client.call<string>("redis_command", "bpoll " + id).val();
+    }
+    return res;
+}
+
+static unique_ptr<buttonrpc> connectTo(const string& hostName, int port) {
+    auto client = make_unique<buttonrpc>();
+    client->as_client(hostName, port);
+    client->set_timeout(2000); //要大于服务器上阻塞命令一次请求的等待时间BLOCKED_HOLD_MS
+    return client;
+}
+
+// 用法：./client [端口] [主机]
+// 连接集群中的任一节点即可：收到MOVED时改连槽位所在的节点，收到ASK时只把这一条命令发往目标节点
+int main(int argc, char* argv[]) {
+    string hostName = argc > 2 ? argv[2] : "127.0.0.1";
+    int port = argc > 1 ? atoi(argv[1]) : 5555;
+
+    unique_ptr<buttonrpc> client = connectTo(hostName, port);
 
     string message;
+    vector<string> watchIds; //WATCH返回的还没有EXEC、DISCARD或UNWATCH的编号
     while(true){
         //发送数据
         std::cout << hostName << ":" << port << "> ";
         std::getline(std::cin, message);
-        string res = client.call<string>("redis_command", message).val();
-        //添加结束字符 
-        if(res.find("stop") != std::string::npos){
+        message = withWatchIds(message, watchIds);
+        string res = client->call<string>("redis_command", message).val();
+        bool ask;
+        string targetHost;
+        int targetPort;
+        for (int i = 0; i < MAX_REDIRECTIONS && parseRedirection(res, ask, targetHost, targetPort); i++) {
+            if (ask) {
+                auto target = connectTo(targetHost, targetPort);
+                target->call<string>("redis_command", string("asking"));
+                res = waitBlocked(*target, target->call<string>("redis_command", message).val()); //等待者登记在目标节点上
+            } else {
+                hostName = targetHost;
+                port = targetPort;
+                client = connectTo(hostName, port);
+                res = client->call<string>("redis_command", message).val();
+            }
+        }
+        res = waitBlocked(*client, res);
+        rememberWatchId(message, res, watchIds);
+        if(isQuitCommand(message)){
             break;
         }
-        std::cout << res << std::endl;
+        //服务器返回RESP格式的回复，转换成可读的文本再输出
+        std::cout << ReplyRenderer::render(res) << std::endl;
+        string subscriber;
+        if (parseSubscriberId(message, res, subscriber)) {
+            std::cout << "Reading messages... (press Ctrl-C to quit)" << std::endl;
+            receiveMessages(*client, subscriber);
+        }
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -9,6 +9,14 @@
 enum SET_MODEL{ 
     NONE,NX,XX
 };
+//stream裁剪的模式
+enum STREAM_TRIM_MODEL{
+    TRIM_NONE,TRIM_MAXLEN,TRIM_MINID
+};
+//bitop命令的运算类型
+enum BITOP_TYPE{
+    BITOP_AND,BITOP_OR,BITOP_XOR,BITOP_NOT
+};
 //命令枚举
 enum Command{ 
     SET,
@@ -35,45 +43,60 @@ enum Command{
     LPOP,
     RPOP,
     LRANGE,
+    BLPOP,
+    BRPOP,
+    BLMOVE,
+    BPOLL,
     HSET,
     HGET,
     HDEL,
     HKEYS,
     HVALS,
+    SETBIT,
+    GETBIT,
+    BITCOUNT,
+    BITPOS,
+    BITOP,
+    PFADD,
+    PFCOUNT,
+    PFMERGE,
+    XADD,
+    XRANGE,
+    XREAD,
+    XLEN,
+    XTRIM,
+    SCAN,
+    HSCAN,
+    KRANGE,
+    KREVRANGE,
+    KCOUNT,
+    DUMP,
+    RESTORE,
+    COMMAND,
+    REPLICAOF,
+    ROLE,
+    CLUSTER,
+    ASKING,
+    MIGRATE,
+    MIGRATERANGE,
+    MIGRATESLOT,
+    EVAL,
+    EVALSHA,
+    SCRIPT,
+    PUBLISH,
+    SUBSCRIBE,
+    PSUBSCRIBE,
+    UNSUBSCRIBE,
+    PUNSUBSCRIBE,
+    LISTEN,
+    WATCH,
+    UNWATCH,
+    MULTI,
+    EXEC,
+    DISCARD,
+    QUIT,
     INVALID_COMMAND
 };
-//命令映射
-static std::unordered_map<std::string,enum Command>commandMaps={ 
-    {"set",SET},
-    {"setnx",SETNX},
-    {"setex",SETEX},
-    {"get",GET},
-    {"select",SELECT},
-    {"dbsize",DBSIZE},
-    {"exists",EXISTS},
-    {"del",DEL},
-    {"rename",RENAME},
-    {"incr",INCR},
-    {"incrby",INCRBY},
-    {"incrbyfloat",INCRBYFLOAT},
-    {"decr",DECR},
-    {"decrby",DECRBY},
-    {"mset",MSET},
-    {"mget",MGET},
-    {"strlen",STRLEN},
-    {"append",APPEND},
-    {"keys",KEYS},
-    {"lpush",LPUSH},
-    {"rpush",RPUSH},
-    {"lpop",LPOP},
-    {"rpop",RPOP},
-    {"lrange",LRANGE},
-    {"hset",HSET},
-    {"hget",HGET},
-    {"hdel",HDEL},
-    {"hkeys",HKEYS},
-    {"hvals",HVALS}
-};
 
 static std::vector<std::string> split(const std::string &s, char delimiter=' ') {
     std::vector<std::string> tokens;
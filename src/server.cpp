@@ -1,15 +1,133 @@
 #include "RedisServer.h"
-#include "buttonrpc.hpp"
+#include "Serializer.hpp"
+#include <strings.h>
+#include <zmq.h>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main() {
-   buttonrpc server;  
-    server.as_server(5555);
-    //server.bind("redis_command", redis_command);
-    RedisServer::getInstance()->start();
-    server.bind("redis_command", &RedisServer::handleClient, RedisServer::getInstance());
-   // std::cout << "run rpc server on: " << 5555 << std::endl;
-    server.run();
+#define WORKER_ENDPOINT "inproc://redis_workers" //工作线程连接的进程内地址
+#define RPC_ERR_NOT_BOUND 1 //与buttonrpc的错误码相同：调用的函数没有注册
 
+/*
+    请求分发
+    客户端用buttonrpc调用redis_command，请求是序列化的函数名和参数，回复是错误码、错误信息和返回值。
+    buttonrpc的服务端只有一个线程，一问一答，阻塞命令在请求中等待时其它客户端都要等它，
+    所以这里按同样的格式收发消息，自己分发请求：前端的ROUTER套接字接收客户端的请求，
+    交给RPC_WORKER_THREADS个工作线程中空闲的一个，工作线程调用RedisServer::handleClient后把回复发回去。
+    工作线程空闲时向后端发一条空消息，请求只分给发过这条消息的线程，不会排在正在等待的阻塞命令后面；
+    没有空闲线程时请求留在前端的队列中。
+*/
 
-    RedisServer::getInstance()->start();
-}
\ No newline at end of file
+// 接收一条多帧消息，出错时返回空
+static std::vector<std::string> receiveFrames(void* socket) {
+    std::vector<std::string> frames;
+    int more = 0;
+    do {
+        zmq_msg_t message;
+        zmq_msg_init(&message);
+        if (zmq_msg_recv(&message, socket, 0) < 0) {
+            zmq_msg_close(&message);
+            frames.clear();
+            return frames;
+        }
+        frames.emplace_back(static_cast<char*>(zmq_msg_data(&message)), zmq_msg_size(&message));
+        more = zmq_msg_more(&message);
+        zmq_msg_close(&message);
+    } while (more);
+    return frames;
+}
+
+// 从第first帧开始发送
+static void sendFrames(void* socket, const std::vector<std::string>& frames, size_t first = 0) {
+    for (size_t i = first; i < frames.size(); i++) {
+        zmq_send(socket, frames[i].data(), frames[i].size(), i + 1 < frames.size() ? ZMQ_SNDMORE : 0);
+    }
+}
+
+// 执行一个buttonrpc请求，返回序列化的回复
+static std::string handleRequest(const std::string& request) {
+    Serializer out;
+    std::string name;
+    std::string command;
+    if (request.size() >= sizeof(uint16_t)) {
+        Serializer in(StreamBuffer(request.data(), request.size()));
+        in >> name;
+        in >> command;
+    }
+    if (name != "redis_command") {
+        out << static_cast<uint16_t>(RPC_ERR_NOT_BOUND) << std::string("function not bind: " + name);
+    } else {
+        out << static_cast<uint16_t>(0) << std::string() << RedisServer::getInstance()->handleClient(command);
+    }
+    return std::string(out.data(), out.size());
+}
+
+static void runWorker(void* context) {
+    void* socket = zmq_socket(context, ZMQ_REQ);
+    zmq_connect(socket, WORKER_ENDPOINT);
+    zmq_send(socket, "", 0, 0); //空闲
+    while (true) {
+        std::vector<std::string> frames = receiveFrames(socket); //[客户端地址][空帧][请求]
+        if (frames.empty()) {
+            continue;
+        }
+        if (frames.size() != 3) {
+            zmq_send(socket, "", 0, 0);
+            continue;
+        }
+        frames[2] = handleRequest(frames[2]);
+        sendFrames(socket, frames);
+    }
+}
+
+// 用法：./server [端口] [数据目录] [cluster [对外地址]]
+// 在本机同时运行主库和副本时，两个实例使用不同的端口和数据目录，复制连接使用端口+REPLICATION_PORT_OFFSET
+// 带cluster参数时以集群模式运行，对外地址是其它节点和客户端访问本节点的地址，默认127.0.0.1
+int main(int argc, char* argv[]) {
+    int port = argc > 1 ? atoi(argv[1]) : 5555;
+    std::string dataFolder = argc > 2 ? argv[2] : DEFAULT_DB_FOLDER;
+    CommandParser::setRedisHelper(std::make_shared<RedisHelper>(dataFolder));
+    if (argc > 3 && strcasecmp(argv[3], "cluster") == 0) {
+        Cluster::getInstance()->enable(argc > 4 ? argv[4] : "127.0.0.1", port, dataFolder);
+    }
+    RedisServer::getInstance()->start(port);
+    void* context = zmq_ctx_new();
+    void* frontend = zmq_socket(context, ZMQ_ROUTER);
+    std::string endpoint = "tcp://*:" + std::to_string(port);
+    zmq_bind(frontend, endpoint.c_str());
+    void* backend = zmq_socket(context, ZMQ_ROUTER);
+    zmq_bind(backend, WORKER_ENDPOINT); //进程内地址要先绑定再连接
+    for (int i = 0; i < RPC_WORKER_THREADS; i++) {
+        std::thread(runWorker, context).detach();
+    }
+    std::deque<std::string> idle; //空闲的工作线程的地址
+    while (true) {
+        zmq_pollitem_t items[] = {{backend, 0, ZMQ_POLLIN, 0}, {frontend, 0, ZMQ_POLLIN, 0}};
+        //没有空闲的工作线程时不接收新请求
+        if (zmq_poll(items, idle.empty() ? 1 : 2, -1) < 0) {
+            continue;
+        }
+        if (items[0].revents & ZMQ_POLLIN) {
+            //[工作线程][空帧][空消息]表示空闲，[工作线程][空帧][客户端地址][空帧][回复]是处理完的请求
+            std::vector<std::string> frames = receiveFrames(backend);
+            if (frames.empty()) {
+                continue;
+            }
+            idle.push_back(frames[0]);
+            if (frames.size() == 5) {
+                sendFrames(frontend, frames, 2);
+            }
+        }
+        if (!idle.empty() && (items[1].revents & ZMQ_POLLIN)) {
+            std::vector<std::string> frames = receiveFrames(frontend); //[客户端地址][空帧][请求]
+            if (frames.size() != 3) {
+                continue;
+            }
+            frames.insert(frames.begin(), {idle.front(), std::string()});
+            idle.pop_front();
+            sendFrames(backend, frames);
+        }
+    }
+}